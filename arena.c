@@ -0,0 +1,196 @@
+///
+///	@file arena.c		@brief arena allocator of one conversion
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup arena Arena
+///
+///	The tables and buffers of a conversion are taken from an arena and
+///	released together at its end.  Allocation only moves a pointer in a
+///	large block.  A reset keeps the memory as one block, large enough
+///	for all allocations since the last reset, the next conversion of
+///	the same size needs no malloc().
+///
+/// @{
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+#define ARENA_ALIGN 16			///< alignment of allocations
+
+    /// round up to alignment
+#define ArenaAlign(n) (((n) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+    /// data of arena block
+#define ArenaData(block) \
+    ((unsigned char *)(block) + ArenaAlign(sizeof(ArenaBlock)))
+
+///
+///	Initialize empty arena.
+///
+///	@param arena	arena allocator
+///
+void ArenaInit(Arena * arena)
+{
+    memset(arena, 0, sizeof(*arena));
+}
+
+///
+///	Allocate new block.
+///
+///	@param arena	arena allocator
+///	@param size	bytes of data
+///
+static ArenaBlock *ArenaNewBlock(Arena * arena, size_t size)
+{
+    ArenaBlock *block;
+
+    if (!(block = malloc(ArenaAlign(sizeof(ArenaBlock)) + size))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    block->Next = NULL;
+    block->Size = size;
+    block->Used = 0;
+    arena->Size += size;
+    return block;
+}
+
+///
+///	Allocate memory from arena.
+///
+///	@param arena	arena allocator
+///	@param n	number of bytes
+///
+///	@returns memory aligned to 16 bytes, valid until the next reset.
+///
+void *ArenaAlloc(Arena * arena, size_t n)
+{
+    ArenaBlock *block;
+    void *p;
+
+    n = ArenaAlign(n);
+    if (!(block = arena->Current)) {	// start again with first block
+	if ((block = arena->First)) {
+	    block->Used = 0;
+	}
+    }
+    // use spare blocks after the current one, append a new block
+    while (block && block->Used + n > block->Size) {
+	if (!block->Next) {
+	    block->Next =
+		ArenaNewBlock(arena,
+		n > ARENA_BLOCK_SIZE ? n : ARENA_BLOCK_SIZE);
+	}
+	block = block->Next;
+	block->Used = 0;
+    }
+    if (!block) {
+	block = arena->First =
+	    ArenaNewBlock(arena, n > ARENA_BLOCK_SIZE ? n : ARENA_BLOCK_SIZE);
+    }
+    arena->Current = block;
+    p = ArenaData(block) + block->Used;
+    block->Used += n;
+    arena->Used += n;
+    if (arena->Used > arena->Peak) {
+	arena->Peak = arena->Used;
+    }
+    return p;
+}
+
+///
+///	Grow allocation.  The last allocation grows in place, others are
+///	copied, the old memory is kept until the next reset.
+///
+///	@param arena	arena allocator
+///	@param p	memory of ArenaAlloc() or NULL
+///	@param old	old number of bytes
+///	@param n	new number of bytes
+///
+///	@returns memory with the old content.
+///
+void *ArenaGrow(Arena * arena, void *p, size_t old, size_t n)
+{
+    ArenaBlock *block;
+    void *q;
+
+    old = ArenaAlign(old);
+    if (p && (block = arena->Current)
+	&& (unsigned char *)p + old == ArenaData(block) + block->Used
+	&& block->Used - old + ArenaAlign(n) <= block->Size) {
+	block->Used += ArenaAlign(n) - old;
+	arena->Used += ArenaAlign(n) - old;
+	if (arena->Used > arena->Peak) {
+	    arena->Peak = arena->Used;
+	}
+	return p;
+    }
+    q = ArenaAlloc(arena, n);
+    if (p) {
+	memcpy(q, p, old < n ? old : n);
+    }
+    return q;
+}
+
+///
+///	Release all allocations.  Several blocks are replaced by one block
+///	of their total size.
+///
+///	@param arena	arena allocator
+///
+void ArenaReset(Arena * arena)
+{
+    size_t size;
+
+    if (arena->First && arena->First->Next) {
+	size = arena->Size;
+	ArenaFree(arena);
+	arena->First = ArenaNewBlock(arena, size);
+    }
+    arena->Current = NULL;
+    arena->Used = 0;
+}
+
+///
+///	Free all blocks of arena.  The peak use is kept.
+///
+///	@param arena	arena allocator
+///
+void ArenaFree(Arena * arena)
+{
+    ArenaBlock *block;
+
+    while ((block = arena->First)) {
+	arena->First = block->Next;
+	free(block);
+    }
+    arena->Current = NULL;
+    arena->Used = 0;
+    arena->Size = 0;
+}
+
+/// @}
@@ -0,0 +1,98 @@
+///
+///	@file arena.h		@brief arena allocator of one conversion
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>			// size_t
+
+#define ARENA_BLOCK_SIZE (64 * 1024)	///< bytes of a normal arena block
+
+///
+///	Arena block, allocations are taken from its end.
+///
+typedef struct _arena_block_ {
+    struct _arena_block_ *Next;		///< next block or NULL
+    size_t Size;			///< bytes of data
+    size_t Used;			///< bytes allocated of data
+    // data follows, aligned to ARENA_ALIGN
+} ArenaBlock;
+
+///
+///	Arena allocator.
+///
+///	Memory isn't freed one by one, but all at once with ArenaReset().
+///	The arena isn't thread safe, each thread needs its own.
+///
+typedef struct _arena_ {
+    ArenaBlock *First;			///< first block or NULL
+    ArenaBlock *Current;		///< block of the next allocation
+    size_t Used;			///< bytes allocated
+    size_t Peak;			///< most bytes allocated at once
+    size_t Size;			///< bytes of all blocks
+} Arena;
+
+///
+///	Position in arena, to release all later allocations.
+///
+typedef struct _arena_mark_ {
+    ArenaBlock *Block;			///< current block
+    size_t BlockUsed;			///< bytes used of current block
+    size_t Used;			///< bytes allocated
+} ArenaMark;
+
+extern void ArenaInit(Arena *);
+extern void *ArenaAlloc(Arena *, size_t);
+extern void *ArenaGrow(Arena *, void *, size_t, size_t);
+extern void ArenaReset(Arena *);
+extern void ArenaFree(Arena *);
+
+///
+///	Get current position of arena.
+///
+///	@param arena	arena allocator
+///	@param[out] mark	current position
+///
+static inline void ArenaGetMark(const Arena * arena, ArenaMark * mark)
+{
+    mark->Block = arena->Current;
+    mark->BlockUsed = arena->Current ? arena->Current->Used : 0;
+    mark->Used = arena->Used;
+}
+
+///
+///	Release all allocations made after the mark, in reverse order of
+///	the marks.
+///
+///	@param arena	arena allocator
+///	@param mark	position of ArenaGetMark()
+///
+static inline void ArenaRelease(Arena * arena, const ArenaMark * mark)
+{
+    arena->Current = mark->Block;
+    if (mark->Block) {
+	mark->Block->Used = mark->BlockUsed;
+    }
+    arena->Used = mark->Used;
+}
+
+#endif // _ARENA_H
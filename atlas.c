@@ -0,0 +1,321 @@
+///
+///	@file atlas.c		@brief texture atlas packer
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup atlas Atlas packer
+///
+///	Packs the character boxes of a font into texture pages, for GPU
+///	text rendering with one texture.  The pages are square with a power
+///	of two size.  Each page keeps its skyline, the top edge of the
+///	packed rectangles as segments from left to right.  The rectangles
+///	are placed highest first, each at the skyline position where its
+///	bottom is highest (bottom-left), on the first page it fits.  Fonts
+///	which fit into one page get the smallest page size.
+///
+/// @{
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atlas.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Skyline segment, top edge of packed rectangles.
+///
+typedef struct _atlas_segment_ {
+    int X;				///< left position
+    int Y;				///< top of packed rectangles
+    int Width;				///< segment width
+} AtlasSegment;
+
+///
+///	Skyline of one page.
+///
+typedef struct _atlas_skyline_ {
+    AtlasSegment *Segments;		///< segments from left to right
+    int Count;				///< number of segments
+} AtlasSkyline;
+
+///
+///	Sort key of rectangle, packing order.
+///
+typedef struct _atlas_key_ {
+    int Height;				///< rectangle height
+    int Width;				///< rectangle width
+    int Index;				///< index of rectangle
+} AtlasKey;
+
+///
+///	Compare rectangles, highest and widest first.
+///
+///	@param a	first sort key
+///	@param b	second sort key
+///
+static int AtlasCompare(const void *a, const void *b)
+{
+    const AtlasKey *ka;
+    const AtlasKey *kb;
+
+    ka = a;
+    kb = b;
+    if (ka->Height != kb->Height) {
+	return kb->Height - ka->Height;
+    }
+    if (ka->Width != kb->Width) {
+	return kb->Width - ka->Width;
+    }
+    return ka->Index - kb->Index;	// stable, same atlas every run
+}
+
+///
+///	Top position of rectangle at skyline segment.
+///
+///	@param sky	skyline of page
+///	@param i	segment of left edge
+///	@param width	rectangle width
+///	@param height	rectangle height
+///	@param size	page size
+///
+///	@returns top position, -1 if the rectangle doesn't fit.
+///
+static int AtlasFit(const AtlasSkyline * sky, int i, int width, int height,
+    int size)
+{
+    int left;
+    int y;
+
+    if (sky->Segments[i].X + width > size) {
+	return -1;
+    }
+    y = 0;
+    for (left = width; left > 0; left -= sky->Segments[i++].Width) {
+	if (sky->Segments[i].Y > y) {
+	    y = sky->Segments[i].Y;
+	}
+	if (y + height > size) {
+	    return -1;
+	}
+    }
+    return y;
+}
+
+///
+///	Add rectangle to skyline.  The segments below it are cut, segments
+///	of same height are merged.
+///
+///	@param sky	skyline of page
+///	@param i	segment of left edge
+///	@param width	rectangle width
+///	@param bottom	bottom of rectangle, the new skyline
+///
+static void AtlasAdd(AtlasSkyline * sky, int i, int width, int bottom)
+{
+    AtlasSegment *s;
+    int right;
+    int j;
+
+    s = sky->Segments;
+    memmove(s + i + 1, s + i, (sky->Count - i) * sizeof(*s));
+    sky->Count++;
+    s[i].Y = bottom;
+    s[i].Width = width;
+    right = s[i].X + width;
+    // cut the segments below
+    for (j = i + 1; j < sky->Count && s[j].X < right;) {
+	if (s[j].X + s[j].Width <= right) {
+	    memmove(s + j, s + j + 1, (sky->Count - j - 1) * sizeof(*s));
+	    sky->Count--;
+	    continue;
+	}
+	s[j].Width -= right - s[j].X;
+	s[j].X = right;
+	break;
+    }
+    // merge with neighbours of same height
+    if (i + 1 < sky->Count && s[i + 1].Y == s[i].Y) {
+	s[i].Width += s[i + 1].Width;
+	memmove(s + i + 1, s + i + 2, (sky->Count - i - 2) * sizeof(*s));
+	sky->Count--;
+    }
+    if (i > 0 && s[i - 1].Y == s[i].Y) {
+	s[i - 1].Width += s[i].Width;
+	memmove(s + i, s + i + 1, (sky->Count - i - 1) * sizeof(*s));
+	sky->Count--;
+    }
+}
+
+///
+///	Pack rectangles into pages of one size.
+///
+///	The padding is kept between the rectangles, but not at the page
+///	edges: the rectangles are packed padding larger into a page padding
+///	larger.
+///
+///	@param rects	rectangles to pack
+///	@param keys	rectangles in packing order
+///	@param n	number of rectangles to pack
+///	@param size	page size
+///	@param padding	empty pixels between rectangles
+///	@param max_pages	give up when more pages are needed
+///
+///	@returns number of pages, -1 if more than max_pages are needed.
+///
+static int AtlasTry(AtlasRect * rects, const AtlasKey * keys, int n,
+    int size, int padding, int max_pages)
+{
+    AtlasSkyline *skylines;
+    AtlasRect *rect;
+    int pages;
+    int best;
+    int best_y;
+    int page;
+    int area;
+    int w;
+    int h;
+    int i;
+    int j;
+    int y;
+
+    area = size + padding;
+    if (!(skylines = calloc(max_pages, sizeof(*skylines)))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    pages = 0;
+    for (i = 0; i < n; ++i) {
+	rect = &rects[keys[i].Index];
+	w = rect->Width + padding;
+	h = rect->Height + padding;
+	best = -1;
+	best_y = 0;
+	for (page = 0; page < pages; ++page) {
+	    for (j = 0; j < skylines[page].Count; ++j) {
+		y = AtlasFit(&skylines[page], j, w, h, area);
+		if (y >= 0 && (best < 0 || y + h < best_y + h)) {
+		    best = j;
+		    best_y = y;
+		}
+	    }
+	    if (best >= 0) {
+		break;
+	    }
+	}
+	if (best < 0) {			// new page
+	    if (pages == max_pages || w > area || h > area) {
+		pages = -1;
+		break;
+	    }
+	    if (!(skylines[page].Segments =
+		    malloc((area + 1) * sizeof(AtlasSegment)))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(-1);
+	    }
+	    skylines[page].Segments[0].X = 0;
+	    skylines[page].Segments[0].Y = 0;
+	    skylines[page].Segments[0].Width = area;
+	    skylines[page].Count = 1;
+	    pages++;
+	    best = 0;
+	    best_y = 0;
+	}
+	rect->X = skylines[page].Segments[best].X;
+	rect->Y = best_y;
+	rect->Page = page;
+	AtlasAdd(&skylines[page], best, w, best_y + h);
+    }
+    for (page = 0; page < max_pages; ++page) {
+	free(skylines[page].Segments);
+    }
+    free(skylines);
+    return pages;
+}
+
+///
+///	Pack rectangles into square power of two pages.
+///
+///	Empty rectangles get page -1.  When all rectangles fit into one
+///	page, the page has the smallest size they fit in, otherwise all
+///	pages have the size max_size.
+///
+///	@param rects	rectangles, their position and page are set
+///	@param n	number of rectangles
+///	@param max_size	largest page size, power of two
+///	@param padding	empty pixels between rectangles
+///	@param[out] size	size of pages
+///
+///	@returns number of pages, -1 if a rectangle is larger than a page.
+///
+int AtlasPack(AtlasRect * rects, int n, int max_size, int padding,
+    int *size)
+{
+    AtlasKey *keys;
+    long area;
+    int count;
+    int pages;
+    int i;
+
+    if (!(keys = malloc((n ? n : 1) * sizeof(*keys)))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    count = 0;
+    area = 0;
+    for (i = 0; i < n; ++i) {
+	rects[i].X = 0;
+	rects[i].Y = 0;
+	rects[i].Page = -1;
+	if (rects[i].Width <= 0 || rects[i].Height <= 0) {
+	    continue;
+	}
+	keys[count].Height = rects[i].Height;
+	keys[count].Width = rects[i].Width;
+	keys[count].Index = i;
+	area += (long)(rects[i].Width + padding) * (rects[i].Height + padding);
+	count++;
+    }
+    *size = ATLAS_MIN_SIZE;
+    if (!count) {
+	free(keys);
+	return 0;
+    }
+    qsort(keys, count, sizeof(*keys), AtlasCompare);
+
+    // smallest page, which can hold the area, up to the largest
+    pages = 0;
+    for (*size = ATLAS_MIN_SIZE; *size < max_size; *size *= 2) {
+	if ((long)(*size + padding) * (*size + padding) >= area
+	    && (pages = AtlasTry(rects, keys, count, *size, padding, 1)) > 0) {
+	    break;
+	}
+    }
+    if (*size >= max_size) {
+	*size = max_size;
+	pages = AtlasTry(rects, keys, count, max_size, padding, count);
+    }
+    free(keys);
+    return pages;
+}
+
+/// @}
@@ -0,0 +1,42 @@
+///
+///	@file atlas.h		@brief texture atlas packer
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ATLAS_H
+#define _ATLAS_H
+
+#define ATLAS_MIN_SIZE 16		///< smallest atlas page size
+
+///
+///	Rectangle packed into an atlas page.
+///
+typedef struct _atlas_rect_ {
+    int Width;				///< rectangle width
+    int Height;				///< rectangle height
+    int X;				///< left position in page
+    int Y;				///< top position in page
+    int Page;				///< page of rectangle, -1 empty
+} AtlasRect;
+
+    /// pack rectangles into square power of two pages
+extern int AtlasPack(AtlasRect *, int, int, int, int *);
+
+#endif // _ATLAS_H
@@ -75,19 +75,147 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <string.h>
+#include <strings.h>
 #include <limits.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <errno.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
 
 #include <assert.h>
 
+#include "libbdf2c.h"
 #include "ppmhdr.h"
+#include "hexdec.h"
+#include "output.h"
+#include "arena.h"
+#include "zread.h"
+#include "atlas.h"
 
 #define VERSION "4"			///< version of this application
 
 //////////////////////////////////////////////////////////////////////////////
 
-int Outline;				///< true generate outlined font
+///
+///	Check if encoding is converted.
+///
+#define InSubset(options, encoding) \
+    (!(options)->Subset || ((unsigned)(encoding) < \
+	(unsigned)(options)->SubsetSize && (options)->Subset[(encoding) >> 3] \
+	& (0x80 >> ((encoding) & 7))))
+
+///
+///	Check if encoding is drawn into preview.
+///
+#define InPreview(options, encoding) \
+    ((encoding) >= (options)->PreviewFirst \
+	&& (encoding) <= (options)->PreviewLast)
+
+#define COMPACT_PER_LINE 16		///< values per line in compact mode
+
+///
+///	Character bounding box (BBX).
+///
+typedef struct _bdf_bbx_ {
+    int Width;				///< bitmap width
+    int Height;				///< bitmap height
+    int X;				///< left offset from origin
+    int Y;				///< bottom offset from baseline
+} BdfBbx;
+
+///
+///	Character metrics of the font file, for --metrics.
+///
+typedef struct _bdf_metrics_ {
+    int Advance;			///< DWIDTH advance
+    BdfBbx Ink;				///< BBX of the character pixels
+} BdfMetrics;
+
+///
+///	Line metrics and table sizes of font, for --metrics, --kerning and
+///	--atlas.
+///
+typedef struct _bdf_line_ {
+    int Ascent;				///< pixels above baseline
+    int Descent;			///< pixels below baseline
+    int Baseline;			///< baseline row from top of bitmap
+    int KerningPairs;			///< number of written kerning pairs
+    int AtlasSize;			///< size of atlas pages, 0 no atlas
+    int AtlasPages;			///< number of atlas pages
+} BdfLine;
+
+///
+///	Character box of --atlas, besides its atlas rectangle.
+///
+typedef struct _bdf_atlas_box_ {
+    int Left;				///< left offset in character cell
+    int Top;				///< top offset in character cell
+    size_t Pixels;			///< offset of 8 bit box pixels
+} BdfAtlasBox;
+
+///
+///	Sections of --font-image, BITMAP_FONT_SECTION_WIDTHS ... of font.h.
+///
+enum BdfSection {
+    SectionWidths,			///< width of each character
+    SectionIndex,			///< encoding of each character
+    SectionBitmap,			///< bitmaps of all characters
+    SectionPageIndex,			///< page of encoding high byte
+    SectionPages,			///< character index of page entry
+    SectionOffsets,			///< bitmap offset of each character
+    SectionBbx,				///< bounding box of characters
+    SectionMetrics,			///< metrics of each character
+    SectionKerning,			///< kerning pairs
+    SectionAtlas,			///< atlas box of each character
+    SectionMax				///< number of sections
+};
+
+///
+///	Header of --font-image, struct bitmap_font_image of font.h.
+///
+typedef struct _bdf_image_header_ {
+    char Magic[8];			///< "bdf2cimg"
+    uint16_t Version;			///< BITMAP_FONT_IMAGE_VERSION
+    uint16_t ByteOrder;			///< 0x0102 in byte order of file
+    uint16_t Chars;			///< number of characters in font
+    uint16_t AtlasSize;			///< size of atlas pages
+    uint16_t AtlasPages;		///< number of atlas pages
+    uint8_t LongSize;			///< bytes of unsigned long offsets
+    uint8_t Width;			///< max. character width
+    uint8_t Height;			///< character height
+    uint8_t Compressed;			///< bitmaps are packed
+    uint8_t Layout;			///< bitmap layout LAYOUT_ROWS ...
+    uint8_t Bpp;			///< bits per pixel, 0 is 1
+    uint8_t Ascent;			///< pixels above baseline
+    uint8_t Descent;			///< pixels below baseline
+    uint8_t Baseline;			///< baseline row from top of bitmap
+    uint8_t Reserved[5];		///< 0
+    uint32_t KerningPairs;		///< number of kerning pairs
+    uint32_t Size;			///< bytes of file
+    struct {
+	uint32_t Offset;		///< file offset, multiple of 8
+	uint32_t Size;			///< bytes of section, 0 none
+    } Sections[SectionMax];		///< by section number
+} BdfImageHeader;
+
+///
+///	Divide rounding down, also for negative numbers.
+///
+///	@param a	dividend
+///	@param n	positive divisor
+///
+static inline int FloorDiv(int a, int n)
+{
+    return (a - (a < 0 ? n - 1 : 0)) / n;
+}
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -102,6 +230,37 @@ void CreateFontHeaderFile(FILE * out)
 
     fprintf(out,
 	"// (c) 2009, 2010 Lutz Sammer, License: AGPLv3\n\n"
+	"\t/// character bounding box of proportional fonts\n"
+	"struct bitmap_bbx {\n"
+	"\tunsigned char Width;\t\t///< bitmap width\n"
+	"\tunsigned char Height;\t\t///< bitmap height\n"
+	"\tsigned char X;\t\t\t///< left offset from origin\n"
+	"\tsigned char Y;\t\t\t///< bottom offset from baseline\n"
+	"};\n\n"
+	"\t/// character metrics of the font file for text layout\n"
+	"struct bitmap_metrics {\n"
+	"\tunsigned char Advance;\t\t///< origin to origin of next character\n"
+	"\tsigned char X;\t\t\t///< left bearing, origin to ink\n"
+	"\tsigned char Y;\t\t\t///< ink bottom offset from baseline\n"
+	"\tunsigned char Width;\t\t///< ink width\n"
+	"\tunsigned char Height;\t\t///< ink height\n"
+	"};\n\n"
+	"\t/// character box in the texture atlas\n"
+	"struct bitmap_atlas_glyph {\n"
+	"\tunsigned short X;\t\t///< left position in atlas page\n"
+	"\tunsigned short Y;\t\t///< top position in atlas page\n"
+	"\tunsigned char Width;\t\t///< box width, 0 no pixels\n"
+	"\tunsigned char Height;\t\t///< box height\n"
+	"\tunsigned char Left;\t\t///< box left offset in character cell\n"
+	"\tunsigned char Top;\t\t///< box top offset in character cell\n"
+	"\tunsigned char Page;\t\t///< atlas page of box\n"
+	"};\n\n"
+	"\t/// kerning of character pair\n"
+	"struct bitmap_kerning {\n"
+	"\tunsigned short First;\t\t///< encoding of left character\n"
+	"\tunsigned short Second;\t\t///< encoding of right character\n"
+	"\tsigned char Adjust;\t\t///< advance change in pixels\n"
+	"};\n\n"
 	"\t/// bitmap font structure\n" "struct bitmap_font {\n"
 	"\tunsigned char Width;\t\t///< max. character width\n"
 	"\tunsigned char Height;\t\t///< character height\n"
@@ -109,7 +268,285 @@ void CreateFontHeaderFile(FILE * out)
 	"\tconst unsigned char *Widths;\t///< width of each character\n"
 	"\tconst unsigned short *Index;\t///< encoding to character index\n"
 	"\tconst unsigned char *Bitmap;\t///< bitmap of all characters\n"
-	"};\n\n");
+	"\tconst unsigned short *PageIndex;\t///< page of encoding high byte\n"
+	"\tconst unsigned short *Pages;\t///< character index of page entry\n"
+	"\tconst unsigned long *Offsets;\t///< bitmap offset of each character\n"
+	"\tconst struct bitmap_bbx *BBX;\t///< bounding box of each character\n"
+	"\tunsigned char Compressed;\t///< bitmaps are row-xor rle packed\n"
+	"\tunsigned char Layout;\t\t///< bitmap layout BITMAP_FONT_ROWS ...\n"
+	"\tunsigned char Bpp;\t\t///< bits per pixel, 0 is 1\n"
+	"\tconst struct bitmap_metrics *Metrics;\t///< metrics of each character\n"
+	"\tconst struct bitmap_kerning *Kerning;\t///< pairs sorted by encodings\n"
+	"\tunsigned KerningPairs;\t\t///< number of kerning pairs\n"
+	"\tunsigned char Ascent;\t\t///< pixels above baseline\n"
+	"\tunsigned char Descent;\t\t///< pixels below baseline\n"
+	"\tunsigned char Baseline;\t\t///< baseline row from top of bitmap\n"
+	"\tconst struct bitmap_atlas_glyph *Atlas;\t///< atlas box of each character\n"
+	"\tunsigned short AtlasSize;\t///< width and height of atlas pages\n"
+	"\tunsigned short AtlasPages;\t///< number of atlas pages\n"
+	"};\n\n"
+	"#define BITMAP_FONT_ROWS 0\t\t///< rows, left pixel in bit 7\n"
+	"#define BITMAP_FONT_ROWS_LSB 1\t\t///< rows, left pixel in bit 0\n"
+	"#define BITMAP_FONT_PAGES 2\t\t///< columns of 8 pixels, top in bit 0\n\n"
+	"\t/// font split into one font of each encoding block\n"
+	"struct bitmap_font_shards {\n"
+	"\tunsigned Size;\t\t\t///< encodings of each shard\n"
+	"\tunsigned Count;\t\t\t///< number of shards\n"
+	"\tconst struct bitmap_font *const *Fonts;\t///< shard fonts or NULL\n"
+	"};\n\n"
+	"\t/// section of font image file\n"
+	"struct bitmap_font_section {\n"
+	"\tunsigned Offset;\t\t///< file offset, multiple of 8\n"
+	"\tunsigned Size;\t\t\t///< bytes of section, 0 none\n"
+	"};\n\n"
+	"\t/// header of font image file, the sections follow\n"
+	"struct bitmap_font_image {\n"
+	"\tchar Magic[8];\t\t\t///< \"bdf2cimg\"\n"
+	"\tunsigned short Version;\t\t///< BITMAP_FONT_IMAGE_VERSION\n"
+	"\tunsigned short ByteOrder;\t///< 0x0102 in byte order of file\n"
+	"\tunsigned short Chars;\t\t///< number of characters in font\n"
+	"\tunsigned short AtlasSize;\t///< width and height of atlas pages\n"
+	"\tunsigned short AtlasPages;\t///< number of atlas pages\n"
+	"\tunsigned char LongSize;\t\t///< bytes of unsigned long offsets\n"
+	"\tunsigned char Width;\t\t///< max. character width\n"
+	"\tunsigned char Height;\t\t///< character height\n"
+	"\tunsigned char Compressed;\t///< bitmaps are row-xor rle packed\n"
+	"\tunsigned char Layout;\t\t///< bitmap layout BITMAP_FONT_ROWS ...\n"
+	"\tunsigned char Bpp;\t\t///< bits per pixel, 0 is 1\n"
+	"\tunsigned char Ascent;\t\t///< pixels above baseline\n"
+	"\tunsigned char Descent;\t\t///< pixels below baseline\n"
+	"\tunsigned char Baseline;\t\t///< baseline row from top of bitmap\n"
+	"\tunsigned char Reserved[5];\t///< 0\n"
+	"\tunsigned KerningPairs;\t\t///< number of kerning pairs\n"
+	"\tunsigned Size;\t\t\t///< bytes of file\n"
+	"\tstruct bitmap_font_section Sections[10];\t///< by section number\n"
+	"};\n\n"
+	"#define BITMAP_FONT_IMAGE_VERSION 1\t///< version of font image file\n"
+	"#define BITMAP_FONT_SECTION_WIDTHS 0\t\t///< section of Widths\n"
+	"#define BITMAP_FONT_SECTION_INDEX 1\t\t///< section of Index\n"
+	"#define BITMAP_FONT_SECTION_BITMAP 2\t\t///< section of Bitmap\n"
+	"#define BITMAP_FONT_SECTION_PAGE_INDEX 3\t///< section of PageIndex\n"
+	"#define BITMAP_FONT_SECTION_PAGES 4\t\t///< section of Pages\n"
+	"#define BITMAP_FONT_SECTION_OFFSETS 5\t\t///< section of Offsets\n"
+	"#define BITMAP_FONT_SECTION_BBX 6\t\t///< section of BBX\n"
+	"#define BITMAP_FONT_SECTION_METRICS 7\t\t///< section of Metrics\n"
+	"#define BITMAP_FONT_SECTION_KERNING 8\t\t///< section of Kerning\n"
+	"#define BITMAP_FONT_SECTION_ATLAS 9\t\t///< section of Atlas\n"
+	"#define BITMAP_FONT_SECTIONS 10\t\t///< number of sections\n\n");
+
+    fprintf(out,
+	"\t/// font of shard with encoding, NULL if none\n"
+	"static inline const struct bitmap_font *bitmap_font_shard(\n"
+	"\tconst struct bitmap_font_shards *shards, unsigned encoding)\n"
+	"{\n"
+	"\tif (encoding / shards->Size >= shards->Count) {\n"
+	"\t\treturn 0;\n" "\t}\n"
+	"\treturn shards->Fonts[encoding / shards->Size];\n" "}\n\n");
+
+    fprintf(out,
+	"\t/// bytes of bitmap with width x height pixels\n"
+	"static inline unsigned bitmap_font_size(const struct bitmap_font *font,\n"
+	"\tunsigned width, unsigned height)\n" "{\n"
+	"\tif (font->Layout == BITMAP_FONT_PAGES) {\n"
+	"\t\treturn width * ((height + 7) / 8);\n" "\t}\n"
+	"\treturn (width * (font->Bpp ? font->Bpp : 1) + 7) / 8 * height;\n"
+	"}\n\n");
+
+    fprintf(out,
+	"\t/// lookup character index of encoding, -1 if not in font\n"
+	"static inline int bitmap_font_index(const struct bitmap_font *font,\n"
+	"\tunsigned encoding)\n" "{\n" "\tunsigned i;\n\n"
+	"\tif (font->PageIndex) {\t// generated with --page-index\n"
+	"\t\tif (encoding > 0xFFFF) {\n" "\t\t\treturn -1;\n" "\t\t}\n"
+	"\t\ti = font->Pages[font->PageIndex[encoding >> 8] << 8\n"
+	"\t\t\t| (encoding & 0xFF)];\n"
+	"\t\treturn i == 0xFFFF ? -1 : (int)i;\n" "\t}\n"
+	"\tfor (i = 0; i < font->Chars; ++i) {\n"
+	"\t\tif (font->Index[i] == encoding) {\n" "\t\t\treturn i;\n"
+	"\t\t}\n" "\t}\n" "\treturn -1;\n" "}\n\n");
+
+    fprintf(out,
+	"\t/// kerning of character pair in pixels, 0 if none\n"
+	"static inline int bitmap_font_kerning(const struct bitmap_font *font,\n"
+	"\tunsigned first, unsigned second)\n" "{\n"
+	"\tunsigned long key;\n" "\tunsigned long k;\n"
+	"\tunsigned lo;\n" "\tunsigned hi;\n" "\tunsigned i;\n\n"
+	"\tkey = (unsigned long)first << 16 | second;\n"
+	"\tlo = 0;\n" "\thi = font->KerningPairs;\n"
+	"\twhile (lo < hi) {\t// binary search\n"
+	"\t\ti = (lo + hi) / 2;\n"
+	"\t\tk = (unsigned long)font->Kerning[i].First << 16\n"
+	"\t\t\t| font->Kerning[i].Second;\n"
+	"\t\tif (k == key) {\n" "\t\t\treturn font->Kerning[i].Adjust;\n"
+	"\t\t}\n" "\t\tif (k < key) {\n" "\t\t\tlo = i + 1;\n"
+	"\t\t} else {\n" "\t\t\thi = i;\n" "\t\t}\n" "\t}\n"
+	"\treturn 0;\n" "}\n\n");
+
+    fprintf(out,
+	"\t/// advance of n encodings in pixels, with kerning\n"
+	"static inline int bitmap_font_measure(const struct bitmap_font *font,\n"
+	"\tconst unsigned *text, unsigned n)\n" "{\n"
+	"\tint width;\n" "\tint index;\n" "\tunsigned i;\n\n"
+	"\twidth = 0;\n"
+	"\tfor (i = 0; i < n; ++i) {\n"
+	"\t\tif ((index = bitmap_font_index(font, text[i])) < 0) {\n"
+	"\t\t\tcontinue;\n" "\t\t}\n"
+	"\t\twidth += font->Metrics ? font->Metrics[index].Advance\n"
+	"\t\t\t: font->Widths[index];\n"
+	"\t\tif (i + 1 < n) {\n"
+	"\t\t\twidth += bitmap_font_kerning(font, text[i], text[i + 1]);\n"
+	"\t\t}\n" "\t}\n" "\treturn width;\n" "}\n\n");
+
+    fprintf(out,
+	"\t/// bitmap of character index\n"
+	"static inline const unsigned char *bitmap_font_bitmap(\n"
+	"\tconst struct bitmap_font *font, int index)\n" "{\n"
+	"\tif (font->Offsets) {\t// generated with --proportional or --dedup\n"
+	"\t\treturn font->Bitmap + font->Offsets[index];\n" "\t}\n"
+	"\treturn font->Bitmap + index * bitmap_font_size(font, font->Width,\n"
+	"\t\tfont->Height);\n"
+	"}\n\n");
+
+    fprintf(out,
+	"\t/// unpack bitmap of character index into buffer of bitmap size\n"
+	"static inline void bitmap_font_unpack(const struct bitmap_font *font,\n"
+	"\tint index, unsigned char *bitmap)\n" "{\n"
+	"\tconst unsigned char *s;\n" "\tunsigned stride;\n"
+	"\tunsigned size;\n" "\tunsigned i;\n" "\tunsigned n;\n"
+	"\tunsigned c;\n\n"
+	"\tif (font->BBX) {\n"
+	"\t\tstride = font->BBX[index].Width;\n"
+	"\t\tsize = bitmap_font_size(font, stride, font->BBX[index].Height);\n"
+	"\t} else {\n" "\t\tstride = font->Width;\n"
+	"\t\tsize = bitmap_font_size(font, stride, font->Height);\n" "\t}\n"
+	"\tif (font->Layout != BITMAP_FONT_PAGES) {\t// bytes per row\n"
+	"\t\tstride = (stride * (font->Bpp ? font->Bpp : 1) + 7) / 8;\n"
+	"\t}\n"
+	"\ts = bitmap_font_bitmap(font, index);\n"
+	"\tif (!font->Compressed) {\n"
+	"\t\tfor (i = 0; i < size; ++i) {\n" "\t\t\tbitmap[i] = s[i];\n"
+	"\t\t}\n" "\t\treturn;\n" "\t}\n"
+	"\tfor (i = 0; i < size;) {\t// 1nnnnnnn: n+1 zeros, 0nnnnnnn: n+1 bytes\n"
+	"\t\tc = *s++;\n" "\t\tfor (n = (c & 0x7F) + 1; n && i < size; --n) {\n"
+	"\t\t\tbitmap[i++] = c & 0x80 ? 0 : *s++;\n" "\t\t}\n" "\t}\n"
+	"\tfor (i = stride; i < size; ++i) {\t// undo xor with row above\n"
+	"\t\tbitmap[i] ^= bitmap[i - stride];\n" "\t}\n" "}\n\n");
+
+    fprintf(out,
+	"\t/// check tables of image font against its sections, 0 ok\n"
+	"static inline int bitmap_font_image_check(const struct bitmap_font *font,\n"
+	"\tunsigned long size, unsigned pages)\n" "{\n"
+	"\tunsigned long n;\n" "\tunsigned i;\n\n"
+	"\tif (font->PageIndex) {\t// pages and characters exist\n"
+	"\t\tfor (i = 0; i < 256; ++i) {\n"
+	"\t\t\tif (font->PageIndex[i] >= pages) {\n" "\t\t\t\treturn -1;\n"
+	"\t\t\t}\n" "\t\t}\n"
+	"\t\tfor (i = 0; i < pages * 256; ++i) {\n"
+	"\t\t\tif (font->Pages[i] != 0xFFFF && font->Pages[i] >= font->Chars) {\n"
+	"\t\t\t\treturn -1;\n" "\t\t\t}\n" "\t\t}\n" "\t}\n"
+	"\tif (!font->Offsets) {\t// bitmaps of font size one after another\n"
+	"\t\tn = bitmap_font_size(font, font->Width, font->Height);\n"
+	"\t\treturn font->Chars * n > size ? -1 : 0;\n" "\t}\n"
+	"\tfor (i = 0; i < font->Chars; ++i) {\t// bitmaps in bitmap section\n"
+	"\t\tif (font->Offsets[i] > size) {\n" "\t\t\treturn -1;\n" "\t\t}\n"
+	"\t\tif (font->Compressed) {\t// packed size is known only by unpacking\n"
+	"\t\t\tcontinue;\n" "\t\t}\n"
+	"\t\tn = font->BBX ? bitmap_font_size(font, font->BBX[i].Width,\n"
+	"\t\t\tfont->BBX[i].Height)\n"
+	"\t\t\t: bitmap_font_size(font, font->Width, font->Height);\n"
+	"\t\tif (n > size - font->Offsets[i]) {\n" "\t\t\treturn -1;\n"
+	"\t\t}\n" "\t}\n" "\treturn 0;\n" "}\n\n");
+
+    fprintf(out,
+	"\t/// font of font image in memory, no copy, 0 ok, -1 invalid image\n"
+	"static inline int bitmap_font_image_view(struct bitmap_font *font,\n"
+	"\tconst void *data, unsigned long size)\n" "{\n"
+	"\tconst struct bitmap_font_image *image;\n"
+	"\tconst unsigned char *s[BITMAP_FONT_SECTIONS];\n"
+	"\tunsigned long n[BITMAP_FONT_SECTIONS];\n"
+	"\tunsigned long offset;\n" "\tunsigned i;\n\n"
+	"\timage = (const struct bitmap_font_image *)data;\n"
+	"\tif (size < sizeof(*image)\n"
+	"\t\t|| image->Version != BITMAP_FONT_IMAGE_VERSION\n"
+	"\t\t|| image->ByteOrder != 0x0102\n"
+	"\t\t|| image->LongSize != sizeof(unsigned long)\n"
+	"\t\t|| image->Size > size) {\n" "\t\treturn -1;\n" "\t}\n"
+	"\tfor (i = 0; i < 8; ++i) {\n"
+	"\t\tif (image->Magic[i] != \"bdf2cimg\"[i]) {\n"
+	"\t\t\treturn -1;\n" "\t\t}\n" "\t}\n"
+	"\tfor (i = 0; i < BITMAP_FONT_SECTIONS; ++i) {\t// aligned and in file\n"
+	"\t\toffset = image->Sections[i].Offset;\n"
+	"\t\tn[i] = image->Sections[i].Size;\n"
+	"\t\tif (offset %% 8 || offset > image->Size\n"
+	"\t\t\t|| n[i] > image->Size - offset) {\n"
+	"\t\t\treturn -1;\n" "\t\t}\n"
+	"\t\ts[i] = n[i] ? (const unsigned char *)data + offset : 0;\n"
+	"\t}\n"
+	"\tif (n[BITMAP_FONT_SECTION_WIDTHS] != image->Chars\n"
+	"\t\t|| n[BITMAP_FONT_SECTION_INDEX] != image->Chars * 2UL\n"
+	"\t\t|| (n[BITMAP_FONT_SECTION_PAGE_INDEX]\n"
+	"\t\t\t&& n[BITMAP_FONT_SECTION_PAGE_INDEX] != 256 * 2UL)\n"
+	"\t\t|| n[BITMAP_FONT_SECTION_PAGES] %% (256 * 2UL)\n"
+	"\t\t|| (n[BITMAP_FONT_SECTION_OFFSETS] && n[BITMAP_FONT_SECTION_OFFSETS]\n"
+	"\t\t\t!= image->Chars * sizeof(unsigned long))\n"
+	"\t\t|| (n[BITMAP_FONT_SECTION_BBX] && n[BITMAP_FONT_SECTION_BBX]\n"
+	"\t\t\t!= image->Chars * sizeof(struct bitmap_bbx))\n"
+	"\t\t|| (n[BITMAP_FONT_SECTION_METRICS] && n[BITMAP_FONT_SECTION_METRICS]\n"
+	"\t\t\t!= image->Chars * sizeof(struct bitmap_metrics))\n"
+	"\t\t|| n[BITMAP_FONT_SECTION_KERNING]\n"
+	"\t\t!= image->KerningPairs * sizeof(struct bitmap_kerning)\n"
+	"\t\t|| (n[BITMAP_FONT_SECTION_ATLAS] && n[BITMAP_FONT_SECTION_ATLAS]\n"
+	"\t\t\t!= image->Chars * sizeof(struct bitmap_atlas_glyph))) {\n"
+	"\t\treturn -1;\n" "\t}\n"
+	"\tfont->Width = image->Width;\n"
+	"\tfont->Height = image->Height;\n"
+	"\tfont->Chars = image->Chars;\n"
+	"\tfont->Widths = s[BITMAP_FONT_SECTION_WIDTHS];\n"
+	"\tfont->Index = (const unsigned short *)s[BITMAP_FONT_SECTION_INDEX];\n"
+	"\tfont->Bitmap = s[BITMAP_FONT_SECTION_BITMAP];\n"
+	"\tfont->PageIndex =\n"
+	"\t\t(const unsigned short *)s[BITMAP_FONT_SECTION_PAGE_INDEX];\n"
+	"\tfont->Pages = (const unsigned short *)s[BITMAP_FONT_SECTION_PAGES];\n"
+	"\tfont->Offsets =\n"
+	"\t\t(const unsigned long *)s[BITMAP_FONT_SECTION_OFFSETS];\n"
+	"\tfont->BBX = (const struct bitmap_bbx *)s[BITMAP_FONT_SECTION_BBX];\n"
+	"\tfont->Compressed = image->Compressed;\n"
+	"\tfont->Layout = image->Layout;\n"
+	"\tfont->Bpp = image->Bpp;\n"
+	"\tfont->Metrics =\n"
+	"\t\t(const struct bitmap_metrics *)s[BITMAP_FONT_SECTION_METRICS];\n"
+	"\tfont->Kerning =\n"
+	"\t\t(const struct bitmap_kerning *)s[BITMAP_FONT_SECTION_KERNING];\n"
+	"\tfont->KerningPairs = image->KerningPairs;\n"
+	"\tfont->Ascent = image->Ascent;\n"
+	"\tfont->Descent = image->Descent;\n"
+	"\tfont->Baseline = image->Baseline;\n"
+	"\tfont->Atlas = (const struct bitmap_atlas_glyph *)\n"
+	"\t\ts[BITMAP_FONT_SECTION_ATLAS];\n"
+	"\tfont->AtlasSize = image->AtlasSize;\n"
+	"\tfont->AtlasPages = image->AtlasPages;\n"
+	"\treturn bitmap_font_image_check(font, n[BITMAP_FONT_SECTION_BITMAP],\n"
+	"\t\tn[BITMAP_FONT_SECTION_PAGES] / (256 * 2));\n" "}\n\n");
+
+    fprintf(out,
+	"#ifdef BITMAP_FONT_MMAP\t// define it for bitmap_font_image_map()\n"
+	"#include <fcntl.h>\n" "#include <sys/mman.h>\n"
+	"#include <sys/stat.h>\n" "#include <unistd.h>\n\n"
+	"\t/// map font image file shared read only, returns mapping or 0\n"
+	"static inline void *bitmap_font_image_map(struct bitmap_font *font,\n"
+	"\tconst char *file, unsigned long *size)\n" "{\n"
+	"\tstruct stat st;\n" "\tvoid *map;\n" "\tint fd;\n\n"
+	"\tif ((fd = open(file, O_RDONLY)) < 0) {\n" "\t\treturn 0;\n"
+	"\t}\n"
+	"\tif (fstat(fd, &st) || !st.st_size) {\n" "\t\tclose(fd);\n"
+	"\t\treturn 0;\n" "\t}\n"
+	"\tmap = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);\n"
+	"\tclose(fd);\n"
+	"\tif (map == MAP_FAILED) {\n" "\t\treturn 0;\n" "\t}\n"
+	"\tif (bitmap_font_image_view(font, map, st.st_size)) {\n"
+	"\t\tmunmap(map, st.st_size);\n" "\t\treturn 0;\n" "\t}\n"
+	"\t*size = st.st_size;\t// munmap(map, size) frees the font\n"
+	"\treturn map;\n" "}\n" "#endif\n\n");
 
     fprintf(out, "\t/// @{ defines to have human readable font files\n");
     for (i = 0; i < 256; ++i) {
@@ -127,527 +564,5631 @@ void CreateFontHeaderFile(FILE * out)
 ///
 ///	Print header for c file.
 ///
-///	@param out	file stream for output
-///	@param name	font variable name in C source file
+///	@param out	output buffer
+///	@param options	conversion options
 ///
-void Header(FILE * out, const char *name)
+void Header(Output * out, const BdfOptions * options)
 {
-    fprintf(out,
+    char *path;
+
+    OutputPrintf(out,
 	"// Created from bdf2c Version %s, (c) 2009, 2010 by Lutz Sammer\n"
 	"//\tLicense AGPLv3: GNU Affero General Public License version 3\n"
 	"\n#include \"font.h\"\n\n", VERSION);
 
-    fprintf(out,
+    if (options->BinaryFile && options->BinaryEmbed) {
+	OutputPrintf(out,
+	    "\t/// character bitmap for each encoding\n"
+	    "static const unsigned char __%s_bitmap__[] = {\n"
+	    "#embed \"%s\"\n", options->Name, options->BinaryFile);
+	return;
+    }
+    if (options->BinaryFile) {
+	// the assembler resolves relative names in its working directory
+	path = realpath(options->BinaryFile, NULL);
+	OutputPrintf(out,
+	    "\t/// character bitmap for each encoding\n"
+	    "extern const unsigned char __%s_bitmap__[];\n"
+	    "__asm__(\".section .rodata\\n\"\n"
+	    "\t\".globl __%s_bitmap__\\n\"\n"
+	    "\t\".type __%s_bitmap__, %%object\\n\"\n"
+	    "\t\".balign 8\\n\"\n"
+	    "\t\"__%s_bitmap__:\\n\"\n"
+	    "\t\".incbin \\\"%s\\\"\\n\"\n"
+	    "\t\".size __%s_bitmap__, . - __%s_bitmap__\\n\"\n"
+	    "\t\".previous\\n\");\n\n", options->Name, options->Name,
+	    options->Name, options->Name, path ? path : options->BinaryFile,
+	    options->Name, options->Name);
+	free(path);
+	return;
+    }
+    OutputPrintf(out,
 	"\t/// character bitmap for each encoding\n"
-	"static const unsigned char __%s_bitmap__[] = {\n", name);
+	"static const unsigned char __%s_bitmap__[] = {\n", options->Name);
+}
+
+///
+///	Print end of bitmap.
+///
+///	@param out	output buffer
+///	@param options	conversion options
+///
+void BitmapFooter(Output * out, const BdfOptions * options)
+{
+    // .incbin has no array
+    if (options->BinaryFile && !options->BinaryEmbed) {
+	return;
+    }
+    OutputString(out, "};\n\n");
+}
+
+///
+///	Print table entries.
+///
+///	@param out	output buffer
+///	@param table	table values
+///	@param chars	number of entries in table
+///	@param per_line	number of entries per line
+///
+static void TableEntries(Output * out, const unsigned *table, int chars,
+    int per_line)
+{
+    int i;
+
+    for (i = 0; i < chars; ++i) {
+	OutputChar(out, i % per_line ? ' ' : '\t');
+	OutputUnsigned(out, table[i]);
+	OutputChar(out, ',');
+	if (i % per_line == per_line - 1 || i == chars - 1) {
+	    OutputChar(out, '\n');
+	}
+    }
 }
 
 ///
 ///	Print width table for c file
 ///
-///	@param out		file stream for output
-///	@param name		font variable name in C source file
+///	@param out		output buffer
+///	@param options		conversion options
 ///	@param width_table	width table read from BDF file
 ///	@param chars		number of characters in width table
 ///
-void WidthTable(FILE * out, const char *name, const unsigned *width_table,
-    int chars)
+void WidthTable(Output * out, const BdfOptions * options,
+    const unsigned *width_table, int chars)
 {
-    fprintf(out, "};\n\n");
-
-    fprintf(out,
+    OutputPrintf(out,
 	"\t/// character width for each encoding\n"
-	"static const unsigned char __%s_widths__[] = {\n", name);
-    while (chars--) {
-	fprintf(out, "\t%u,\n", *width_table++);
-    }
+	"static const unsigned char __%s_widths__[] = {\n", options->Name);
+    TableEntries(out, width_table, chars,
+	options->Compact ? COMPACT_PER_LINE : 1);
+    OutputString(out, "};\n\n");
 }
 
 ///
 ///	Print encoding table for c file
 ///
-///	@param out		file stream for output
-///	@param name		font variable name in C source file
+///	@param out		output buffer
+///	@param options		conversion options
 ///	@param encoding_table	encoding table read from BDF file
 ///	@param chars		number of characters in encoding table
 ///
-void EncodingTable(FILE * out, const char *name,
+void EncodingTable(Output * out, const BdfOptions * options,
     const unsigned *encoding_table, int chars)
 {
-    fprintf(out, "};\n\n");
-
-    fprintf(out,
+    OutputPrintf(out,
 	"\t/// character encoding for each index entry\n"
-	"static const unsigned short __%s_index__[] = {\n", name);
-    while (chars--) {
-	fprintf(out, "\t%u,\n", *encoding_table++);
+	"static const unsigned short __%s_index__[] = {\n", options->Name);
+    TableEntries(out, encoding_table, chars,
+	options->Compact ? COMPACT_PER_LINE : 1);
+    OutputString(out, "};\n\n");
+}
+
+///
+///	Print offset table for c file.
+///
+///	@param out		output buffer
+///	@param options		conversion options
+///	@param offset_table	bitmap offset of each character
+///	@param chars		number of characters in offset table
+///
+void OffsetTable(Output * out, const BdfOptions * options,
+    const unsigned *offset_table, int chars)
+{
+    OutputPrintf(out,
+	"\t/// bitmap offset for each index entry\n"
+	"static const unsigned long __%s_offsets__[] = {\n", options->Name);
+    TableEntries(out, offset_table, chars,
+	options->Compact ? COMPACT_PER_LINE : 1);
+    OutputString(out, "};\n\n");
+}
+
+///
+///	Print bounding box table for c file.
+///
+///	@param out		output buffer
+///	@param options		conversion options
+///	@param bbx_table	bounding box of each character
+///	@param chars		number of characters in bounding box table
+///
+void BbxTable(Output * out, const BdfOptions * options,
+    const BdfBbx * bbx_table, int chars)
+{
+    int i;
+
+    OutputPrintf(out,
+	"\t/// bounding box for each index entry\n"
+	"static const struct bitmap_bbx __%s_bbx__[] = {\n", options->Name);
+    for (i = 0; i < chars; ++i) {
+	OutputChar(out, options->Compact && i % (COMPACT_PER_LINE / 4) ? ' ' : '\t');
+	OutputChar(out, '{');
+	OutputInt(out, bbx_table[i].Width);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, bbx_table[i].Height);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, bbx_table[i].X);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, bbx_table[i].Y);
+	OutputWrite(out, "},", 2);
+	if (!options->Compact
+	    || i % (COMPACT_PER_LINE / 4) == COMPACT_PER_LINE / 4 - 1
+	    || i == chars - 1) {
+	    OutputChar(out, '\n');
+	}
+    }
+    OutputString(out, "};\n\n");
+}
+
+///
+///	Build page index.
+///
+///	Two level table for constant time lookup of encodings up to
+///	0xFFFF: the page index maps the high byte of the encoding to a page,
+///	the page maps the low byte to the character index.  Page 0 is empty,
+///	missing characters have index 0xFFFF.
+///
+///	@param[out] page_index	page of each encoding high byte
+///	@param encoding_table	encoding table read from BDF file
+///	@param chars		number of characters in encoding table
+///	@param arena		arena of conversion for the pages
+///	@param[out] count	number of pages
+///
+///	@returns 256 character indices of each page.
+///
+static unsigned *PageIndex(unsigned page_index[256],
+    const unsigned *encoding_table, int chars, Arena * arena, int *count)
+{
+    unsigned *pages;
+    int n;
+    int i;
+
+    memset(page_index, 0, 256 * sizeof(*page_index));
+    n = 1;
+    for (i = 0; i < chars; ++i) {
+	if (encoding_table[i] <= 0xFFFF && !page_index[encoding_table[i] >> 8]) {
+	    page_index[encoding_table[i] >> 8] = n++;
+	}
+    }
+    pages = ArenaAlloc(arena, n * 256 * sizeof(*pages));
+    for (i = 0; i < n * 256; ++i) {
+	pages[i] = 0xFFFF;
+    }
+    for (i = chars; i--;) {		// first character wins
+	if (encoding_table[i] <= 0xFFFF) {
+	    pages[page_index[encoding_table[i] >> 8] << 8 |
+		(encoding_table[i] & 0xFF)] = i;
+	}
+    }
+    *count = n;
+    return pages;
+}
+
+///
+///	Print page index for c file, see PageIndex().
+///
+///	@param out		output buffer
+///	@param options		conversion options
+///	@param encoding_table	encoding table read from BDF file
+///	@param chars		number of characters in encoding table
+///	@param arena		arena of conversion for the pages
+///
+void PageTable(Output * out, const BdfOptions * options,
+    const unsigned *encoding_table, int chars, Arena * arena)
+{
+    unsigned page_index[256];
+    unsigned *pages;
+    int n;
+    int i;
+
+    pages = PageIndex(page_index, encoding_table, chars, arena, &n);
+    OutputPrintf(out,
+	"\t/// page of each encoding high byte\n"
+	"static const unsigned short __%s_pageindex__[256] = {\n", options->Name);
+    TableEntries(out, page_index, 256, 16);
+    OutputString(out, "};\n\n");
+
+    OutputPrintf(out,
+	"\t/// character index of each encoding low byte, 0xFFFF none\n"
+	"static const unsigned short __%s_pages__[] = {\n", options->Name);
+    for (i = 0; i < n; ++i) {
+	if (!options->Compact) {
+	    OutputPrintf(out, "// page %d\n", i);
+	}
+	TableEntries(out, pages + i * 256, 256, 16);
+    }
+    OutputString(out, "};\n\n");
+}
+
+///
+///	Print metrics table for c file.
+///
+///	@param out		output buffer
+///	@param options		conversion options
+///	@param metrics_table	metrics of each character
+///	@param chars		number of characters in metrics table
+///
+void MetricsTable(Output * out, const BdfOptions * options,
+    const BdfMetrics * metrics_table, int chars)
+{
+    int i;
+
+    OutputPrintf(out,
+	"\t/// advance, bearing and ink box for each index entry\n"
+	"static const struct bitmap_metrics __%s_metrics__[] = {\n",
+	options->Name);
+    for (i = 0; i < chars; ++i) {
+	OutputChar(out, options->Compact && i % (COMPACT_PER_LINE / 4) ? ' ' : '\t');
+	OutputChar(out, '{');
+	OutputInt(out, metrics_table[i].Advance);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, metrics_table[i].Ink.X);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, metrics_table[i].Ink.Y);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, metrics_table[i].Ink.Width);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, metrics_table[i].Ink.Height);
+	OutputWrite(out, "},", 2);
+	if (!options->Compact
+	    || i % (COMPACT_PER_LINE / 4) == COMPACT_PER_LINE / 4 - 1
+	    || i == chars - 1) {
+	    OutputChar(out, '\n');
+	}
+    }
+    OutputString(out, "};\n\n");
+}
+
+///
+///	Select kerning pairs of font.
+///
+///	Only pairs of two characters in the font are kept, sorted like the
+///	--kerning pairs.  With --downscale the adjustments are scaled, pairs
+///	which become 0 are dropped.
+///
+///	@param options		conversion options
+///	@param encoding_table	encoding table read from BDF file
+///	@param chars		number of characters in encoding table
+///	@param arena		arena of conversion for set and pairs
+///	@param[out] pairs	kerning pairs of font
+///
+///	@returns number of kerning pairs.
+///
+static int KerningPairs(const BdfOptions * options,
+    const unsigned *encoding_table, int chars, Arena * arena,
+    BdfKerning ** pairs)
+{
+    const BdfKerning *pair;
+    unsigned char *set;
+    int scale;
+    int adjust;
+    int n;
+    int i;
+
+    *pairs = ArenaAlloc(arena, (options->KerningSize + 1) * sizeof(**pairs));
+    set = ArenaAlloc(arena, 0x10000 / 8);
+    memset(set, 0, 0x10000 / 8);
+    for (i = 0; i < chars; ++i) {
+	if (encoding_table[i] <= 0xFFFF) {
+	    set[encoding_table[i] >> 3] |= 0x80 >> (encoding_table[i] & 7);
+	}
+    }
+    scale = options->Downscale > 1 ? options->Downscale : 1;
+    n = 0;
+    for (i = 0; i < options->KerningSize; ++i) {
+	pair = &options->Kerning[i];
+	if (pair->First > 0xFFFF || pair->Second > 0xFFFF
+	    || !(set[pair->First >> 3] & (0x80 >> (pair->First & 7)))
+	    || !(set[pair->Second >> 3] & (0x80 >> (pair->Second & 7)))) {
+	    continue;
+	}
+	// round to nearest, symmetric for negative adjustments
+	adjust = pair->Adjust < 0 ? -((-pair->Adjust + scale / 2) / scale)
+	    : (pair->Adjust + scale / 2) / scale;
+	if (!adjust) {
+	    continue;
+	}
+	(*pairs)[n] = *pair;
+	(*pairs)[n++].Adjust = adjust;
+    }
+    return n;
+}
+
+///
+///	Print kerning table for c file, see KerningPairs().
+///
+///	@param out		output buffer
+///	@param options		conversion options
+///	@param encoding_table	encoding table read from BDF file
+///	@param chars		number of characters in encoding table
+///	@param arena		arena of conversion for the pairs
+///
+///	@returns number of written kerning pairs.
+///
+int KerningTable(Output * out, const BdfOptions * options,
+    const unsigned *encoding_table, int chars, Arena * arena)
+{
+    BdfKerning *pairs;
+    int n;
+    int i;
+
+    n = KerningPairs(options, encoding_table, chars, arena, &pairs);
+    for (i = 0; i < n; ++i) {
+	if (!i) {
+	    OutputPrintf(out,
+		"\t/// kerning pairs sorted by encodings\n"
+		"static const struct bitmap_kerning __%s_kerning__[] = {\n",
+		options->Name);
+	}
+	OutputChar(out, options->Compact && i % (COMPACT_PER_LINE / 4) ? ' ' : '\t');
+	OutputChar(out, '{');
+	OutputInt(out, pairs[i].First);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, pairs[i].Second);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, pairs[i].Adjust);
+	OutputWrite(out, "},", 2);
+	if (!options->Compact
+	    || i % (COMPACT_PER_LINE / 4) == COMPACT_PER_LINE / 4 - 1) {
+	    OutputChar(out, '\n');
+	}
+    }
+    if (n) {
+	if (options->Compact && n % (COMPACT_PER_LINE / 4)) {
+	    OutputChar(out, '\n');
+	}
+	OutputString(out, "};\n\n");
+    }
+    return n;
+}
+
+///
+///	Print atlas table for c file.
+///
+///	@param out		output buffer
+///	@param options		conversion options
+///	@param rects		atlas rectangle of each character
+///	@param boxes		atlas box of each character
+///	@param chars		number of characters in tables
+///
+void AtlasTable(Output * out, const BdfOptions * options,
+    const AtlasRect * rects, const BdfAtlasBox * boxes, int chars)
+{
+    int i;
+
+    OutputPrintf(out,
+	"\t/// atlas position, size and cell offset for each index entry\n"
+	"static const struct bitmap_atlas_glyph __%s_atlas__[] = {\n",
+	options->Name);
+    for (i = 0; i < chars; ++i) {
+	OutputChar(out, options->Compact && i % (COMPACT_PER_LINE / 4) ? ' ' : '\t');
+	OutputChar(out, '{');
+	OutputInt(out, rects[i].X);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, rects[i].Y);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, rects[i].Width);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, rects[i].Height);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, boxes[i].Left);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, boxes[i].Top);
+	OutputWrite(out, ", ", 2);
+	OutputInt(out, rects[i].Page < 0 ? 0 : rects[i].Page);
+	OutputWrite(out, "},", 2);
+	if (!options->Compact
+	    || i % (COMPACT_PER_LINE / 4) == COMPACT_PER_LINE / 4 - 1
+	    || i == chars - 1) {
+	    OutputChar(out, '\n');
+	}
     }
+    OutputString(out, "};\n\n");
 }
 
 ///
 ///	Print footer for c file.
 ///
-///	@param out		file stream for output
-///	@param name		font variable name in C source file
+///	@param out		output buffer
+///	@param options		conversion options
 ///	@param width		character width of font
 ///	@param height		character height of font
 ///	@param chars		number of characters in font
+///	@param line		line metrics of font for --metrics and
+///				--kerning
 ///
-void Footer(FILE * out, const char *name, int width, int height, int chars)
+void Footer(Output * out, const BdfOptions * options, int width, int height,
+    int chars, const BdfLine * line)
 {
-    fprintf(out, "};\n\n");
-    fprintf(out,
+    OutputPrintf(out,
 	"\t/// bitmap font structure\n" "const struct bitmap_font %s = {\n",
-	name);
-    fprintf(out, "\t.Width = %d, .Height = %d,\n", width, height);
-    fprintf(out, "\t.Chars = %d,\n", chars);
-    fprintf(out, "\t.Widths = __%s_widths__,\n", name);
-    fprintf(out, "\t.Index = __%s_index__,\n", name);
-    fprintf(out, "\t.Bitmap = __%s_bitmap__,\n", name);
-    fprintf(out, "};\n\n");
+	options->Name);
+    OutputPrintf(out, "\t.Width = %d, .Height = %d,\n", width, height);
+    OutputPrintf(out, "\t.Chars = %d,\n", chars);
+    OutputPrintf(out, "\t.Widths = __%s_widths__,\n", options->Name);
+    OutputPrintf(out, "\t.Index = __%s_index__,\n", options->Name);
+    OutputPrintf(out, "\t.Bitmap = __%s_bitmap__,\n", options->Name);
+    if (options->Proportional || options->Dedup || options->Compress) {
+	OutputPrintf(out, "\t.Offsets = __%s_offsets__,\n", options->Name);
+    }
+    if (options->Proportional) {
+	OutputPrintf(out, "\t.BBX = __%s_bbx__,\n", options->Name);
+    }
+    if (options->Compress) {
+	OutputString(out, "\t.Compressed = 1,\n");
+    }
+    if (options->Layout != LAYOUT_ROWS) {
+	OutputPrintf(out, "\t.Layout = %s,\n",
+	    options->Layout == LAYOUT_PAGES ? "BITMAP_FONT_PAGES" :
+	    "BITMAP_FONT_ROWS_LSB");
+    }
+    if (options->Bpp > 1) {
+	OutputPrintf(out, "\t.Bpp = %d,\n", options->Bpp);
+    }
+    if (options->PageIndex) {
+	OutputPrintf(out, "\t.PageIndex = __%s_pageindex__,\n", options->Name);
+	OutputPrintf(out, "\t.Pages = __%s_pages__,\n", options->Name);
+    }
+    if (options->Metrics) {
+	OutputPrintf(out, "\t.Metrics = __%s_metrics__,\n", options->Name);
+	OutputPrintf(out, "\t.Ascent = %d, .Descent = %d, .Baseline = %d,\n",
+	    line->Ascent, line->Descent, line->Baseline);
+    }
+    if (line->KerningPairs) {
+	OutputPrintf(out, "\t.Kerning = __%s_kerning__,\n", options->Name);
+	OutputPrintf(out, "\t.KerningPairs = %d,\n", line->KerningPairs);
+    }
+    if (line->AtlasSize) {
+	OutputPrintf(out, "\t.Atlas = __%s_atlas__,\n", options->Name);
+	OutputPrintf(out, "\t.AtlasSize = %d, .AtlasPages = %d,\n",
+	    line->AtlasSize, line->AtlasPages);
+    }
+    OutputString(out, "};\n\n");
 }
 
+///
+///	Print comment lines before each character.
+///
+///	@param out	output buffer
+///	@param encoding	character encoding
+///	@param name	character name
+///	@param width	character width
+///	@param bbx	bounding box x offset
+///	@param bby	bounding box y offset
+///	@param bbw	bounding box width
+///	@param bbh	bounding box height
+///
+void CharacterComment(Output * out, int encoding, const char *name,
+    int width, int bbx, int bby, int bbw, int bbh)
+{
+    // "// %3d $%02x '%s'\n"
+    OutputWrite(out, "// ", 3);
+    OutputIntPadded(out, encoding, 3);
+    OutputWrite(out, " $", 2);
+    OutputHex(out, encoding, 2);
+    OutputWrite(out, " '", 2);
+    OutputString(out, name);
+    OutputWrite(out, "'\n", 2);
+    // "//\twidth %d, bbx %d, bby %d, bbw %d, bbh %d\n"
+    OutputWrite(out, "//\twidth ", 9);
+    OutputInt(out, width);
+    OutputWrite(out, ", bbx ", 6);
+    OutputInt(out, bbx);
+    OutputWrite(out, ", bby ", 6);
+    OutputInt(out, bby);
+    OutputWrite(out, ", bbw ", 6);
+    OutputInt(out, bbw);
+    OutputWrite(out, ", bbh ", 6);
+    OutputInt(out, bbh);
+    OutputChar(out, '\n');
+}
 
 ///
 ///	Dump character.
 ///
-///	@param out	file stream for output
+///	@param out	output buffer
+///	@param bitmap	input bitmap
+///	@param width	character width
+///	@param height	character height
+///
+void DumpCharacter(Output * out, const unsigned char *bitmap, int width,
+    int height)
+{
+    int x;
+    int y;
+    int n;
+    char *s;
+
+    n = (width + 7) / 8;
+    for (y = 0; y < height; ++y) {
+	s = OutputReserve(out, 2 + n * sizeof(*OutputByteToken));
+	*s++ = '\t';
+	for (x = 0; x < n; ++x) {
+	    memcpy(s, OutputByteToken[*bitmap++], sizeof(*OutputByteToken));
+	    s += sizeof(*OutputByteToken);
+	}
+	*s++ = '\n';
+	out->Used = s - out->Buffer;
+    }
+}
+
+///
+///	Dump bytes as dense hex literals, many per line.
+///
+///	@param out	output buffer
+///	@param data	bytes to dump
+///	@param n	number of bytes
+///
+void DumpBytes(Output * out, const unsigned char *data, int n)
+{
+    int i;
+    char *s;
+
+    // "\t" + n * "0xXX," + separators + newline per line
+    s = OutputReserve(out, n * 6 + 2 * (n / COMPACT_PER_LINE + 1));
+    for (i = 0; i < n; ++i) {
+	*s++ = i % COMPACT_PER_LINE ? ' ' : '\t';
+	*s++ = '0';
+	*s++ = 'x';
+	*s++ = "0123456789ABCDEF"[data[i] >> 4];
+	*s++ = "0123456789ABCDEF"[data[i] & 15];
+	*s++ = ',';
+	if (i % COMPACT_PER_LINE == COMPACT_PER_LINE - 1 || i == n - 1) {
+	    *s++ = '\n';
+	}
+    }
+    out->Used = s - out->Buffer;
+}
+
+///
+///	Dump character as dense hex literals, many per line.
+///
+///	@param out	output buffer
+///	@param bitmap	input bitmap
+///	@param width	character width
+///	@param height	character height
+///
+void DumpCharacterCompact(Output * out, const unsigned char *bitmap,
+    int width, int height)
+{
+    DumpBytes(out, bitmap, ((width + 7) / 8) * height);
+}
+
+///
+///	Pack character bitmap for --compress.
+///
+///	Each row is xor'ed with the row above, so empty and repeated rows
+///	become zero.  The result is run length encoded: a control byte
+///	1nnnnnnn stands for n+1 zero bytes, 0nnnnnnn is followed by n+1
+///	literal bytes.  bitmap_font_unpack() of font.h reverses it.
+///
+///	@param out	output buffer
 ///	@param bitmap	input bitmap
 ///	@param width	character width
 ///	@param height	character height
+///	@param scratch	arena for the xor'ed rows, released on return
+///
+///	@returns size of packed bitmap.
+///
+int PackBitmap(Output * out, const unsigned char *bitmap, int width,
+    int height, Arena * scratch)
+{
+    ArenaMark mark;
+    unsigned char *delta;
+    int stride;
+    int n;
+    int i;
+    int j;
+    size_t used;
+
+    stride = (width + 7) / 8;
+    n = stride * height;
+    ArenaGetMark(scratch, &mark);
+    delta = ArenaAlloc(scratch, n + 1);
+    for (i = 0; i < n; ++i) {
+	delta[i] = bitmap[i] ^ (i >= stride ? bitmap[i - stride] : 0);
+    }
+    delta[n] = 0;			// sentinel for literal end check
+
+    used = out->Used;
+    for (i = 0; i < n; i = j) {
+	if (!delta[i]) {
+	    for (j = i + 1; j < n && j - i < 128 && !delta[j]; ++j) {
+	    }
+	    OutputChar(out, 0x80 | (j - i - 1));
+	    continue;
+	}
+	// literals end at two zeros, a single zero is cheaper as literal
+	for (j = i + 1; j < n && j - i < 128 && (delta[j] || delta[j + 1]);
+	    ++j) {
+	}
+	OutputChar(out, j - i - 1);
+	OutputWrite(out, delta + i, j - i);
+    }
+    ArenaRelease(scratch, &mark);
+    return out->Used - used;
+}
+
+///
+///	Load 8 bytes big endian, the first byte is the most significant.
+///
+static inline uint64_t LoadBe64(const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+///
+///	Store 8 bytes big endian.
+///
+static inline void StoreBe64(unsigned char *p, uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+///
+///	Shift one bitmap row right.  Pixels shifted out of the row are lost,
+///	the row is filled with zeros from the left.
+///
+///	@param row	bitmap row
+///	@param shift	number of pixels to shift
+///	@param stride	bytes of the row
+///
+static inline void ShiftRow(unsigned char *row, int shift, int stride)
+{
+    uint64_t v;
+    int bits;
+    int i;
+
+    if (shift >= stride * 8) {
+	memset(row, 0, stride);
+	return;
+    }
+    switch (stride) {			// common narrow fonts
+	case 0:
+	    return;
+	case 1:
+	    row[0] >>= shift;
+	    return;
+	case 2:
+	    v = (row[0] << 8 | row[1]) >> shift;
+	    row[0] = v >> 8;
+	    row[1] = v;
+	    return;
+    }
+    if (stride <= 8) {			// row fits into one word
+	v = 0;
+	for (i = 0; i < stride; ++i) {
+	    v = v << 8 | row[i];
+	}
+	v >>= shift;
+	for (i = stride; i--;) {
+	    row[i] = v;
+	    v >>= 8;
+	}
+	return;
+    }
+    // move whole bytes, then shift the bits 8 bytes at a time from the end
+    if (shift >= 8) {
+	memmove(row + shift / 8, row, stride - shift / 8);
+	memset(row, 0, shift / 8);
+    }
+    if (!(bits = shift % 8)) {
+	return;
+    }
+    for (i = stride; i >= 8; i -= 8) {
+	v = LoadBe64(row + i - 8) >> bits;
+	if (i > 8) {
+	    v |= (uint64_t) row[i - 9] << (64 - bits);
+	}
+	StoreBe64(row + i - 8, v);
+    }
+    for (; i > 0; --i) {
+	row[i - 1] = row[i - 1] >> bits | (i > 1 ? row[i - 2] << (8 - bits) : 0);
+    }
+}
+
+///
+///	Shift all rows of a character right.  Used to move the character by
+///	its bounding box.
+///
+///	@param bitmap	character bitmap
+///	@param shift	number of pixels to shift, 0 < shift < width
+///	@param width	character width
+///	@param height	character height
+///
+void RotateBitmap(unsigned char *bitmap, int shift, int width, int height)
+{
+    int stride;
+    int y;
+
+    if ((shift <= 0) || (shift >= width)) {
+	fprintf(stderr,
+	    "Waring: This shift isn't supported: w=%d,h=%d, shift=%2d; ignored!!\n",
+	    shift, width, height);
+	return;
+    }
+    stride = (width + 7) / 8;
+    for (y = 0; y < height; ++y) {
+	ShiftRow(bitmap + y * stride, shift, stride);
+    }
+}
+
+///
+///	Bytes of bitmap in stored layout.
+///
+///	@param layout	LAYOUT_ROWS, LAYOUT_ROWS_LSB or LAYOUT_PAGES
+///	@param bpp	bits per pixel, 0 or 1 mono
+///	@param width	bitmap width
+///	@param height	bitmap height
+///
+static inline int LayoutSize(int layout, int bpp, int width, int height)
+{
+    if (layout == LAYOUT_PAGES) {
+	return width * ((height + 7) / 8);
+    }
+    return ((width * (bpp > 1 ? bpp : 1) + 7) / 8) * height;
+}
+
+///
+///	Position of pixel in rotated character.
+///
+///	@param x	column in upright character
+///	@param y	row in upright character
+///	@param width	upright character width
+///	@param height	upright character height
+///	@param rotate	clockwise rotation 0, 90, 180 or 270
+///	@param[out] u	column in rotated character
+///	@param[out] v	row in rotated character
+///
+static inline void RotatePixel(int x, int y, int width, int height,
+    int rotate, int *u, int *v)
+{
+    switch (rotate) {
+	case 90:
+	    *u = height - 1 - y;
+	    *v = x;
+	    break;
+	case 180:
+	    *u = width - 1 - x;
+	    *v = height - 1 - y;
+	    break;
+	case 270:
+	    *u = y;
+	    *v = width - 1 - x;
+	    break;
+	default:
+	    *u = x;
+	    *v = y;
+	    break;
+    }
+}
+
+///
+///	Rotate character and store it in the layout of the display, once
+///	at conversion instead of each time it is drawn.
+///
+///	LAYOUT_PAGES is the layout of SSD1306 and ST7565 controllers: each
+///	byte is a column of 8 pixels with the top pixel in bit 0, the bytes
+///	of a page of 8 rows follow from left to right.
+///
+///	@param[out] dst	bitmap in layout, LayoutSize() of the rotated size
+///	@param src	character bitmap, rows with left pixel in bit 7
+///	@param width	character width
+///	@param height	character height
+///	@param layout	LAYOUT_ROWS, LAYOUT_ROWS_LSB or LAYOUT_PAGES
+///	@param rotate	clockwise rotation 0, 90, 180 or 270
+///
+void LayoutBitmap(unsigned char *dst, const unsigned char *src, int width,
+    int height, int layout, int rotate)
+{
+    int stride;
+    int w;
+    int h;
+    int x;
+    int y;
+    int u;
+    int v;
+
+    stride = (width + 7) / 8;
+    w = rotate == 90 || rotate == 270 ? height : width;
+    h = rotate == 90 || rotate == 270 ? width : height;
+    memset(dst, 0, LayoutSize(layout, 1, w, h));
+    for (y = 0; y < height; ++y) {
+	for (x = 0; x < width; ++x) {
+	    if (!src[y * stride + x / 8]) {	// skip empty byte
+		x |= 7;
+		continue;
+	    }
+	    if (!(src[y * stride + x / 8] & (0x80 >> (x & 7)))) {
+		continue;
+	    }
+	    RotatePixel(x, y, width, height, rotate, &u, &v);
+	    switch (layout) {
+		case LAYOUT_ROWS_LSB:
+		    dst[v * ((w + 7) / 8) + u / 8] |= 1 << (u & 7);
+		    break;
+		case LAYOUT_PAGES:
+		    dst[(v / 8) * w + u] |= 1 << (v & 7);
+		    break;
+		default:
+		    dst[v * ((w + 7) / 8) + u / 8] |= 0x80 >> (u & 7);
+		    break;
+	    }
+	}
+    }
+}
+
+///
+///	Downscale character with a box filter.  Each output pixel is the
+///	coverage of a block of n x n pixels, counted a block row at a time
+///	with one popcount.  Blocks at the right and bottom edge are padded
+///	with empty pixels.
+///
+///	@param[out] gray	(width + n - 1) / n x (height + n - 1) / n
+///				pixels, one byte each from 0 to max
+///	@param src	character bitmap, rows with left pixel in bit 7
+///	@param width	character width
+///	@param height	character height
+///	@param n	downscale factor 1 .. 8
+///	@param max	pixel value of full coverage
+///
+void DownscaleBitmap(unsigned char *gray, const unsigned char *src,
+    int width, int height, int n, int max)
+{
+    const unsigned char *row;
+    unsigned bits;
+    int stride;
+    int count;
+    int w;
+    int h;
+    int k;
+    int x;
+    int y;
+    int u;
+    int v;
+
+    stride = (width + 7) / 8;
+    w = (width + n - 1) / n;
+    h = (height + n - 1) / n;
+    for (v = 0; v < h; ++v) {
+	for (u = 0; u < w; ++u) {
+	    x = u * n;
+	    // block row of up to 8 pixels spans at most two bytes
+	    k = width - x < n ? width - x : n;
+	    count = 0;
+	    for (y = v * n; y < v * n + n && y < height; ++y) {
+		row = src + y * stride + x / 8;
+		bits = row[0] << 8;
+		if (x / 8 + 1 < stride) {
+		    bits |= row[1];
+		}
+		bits = (bits >> (16 - (x & 7) - k)) & ((1 << k) - 1);
+		count += __builtin_popcount(bits);
+	    }
+	    // round to nearest level
+	    gray[v * w + u] = (count * max + n * n / 2) / (n * n);
+	}
+    }
+}
+
+///
+///	Rotate downscaled character and pack its pixels into rows of bpp
+///	bits, the left pixel in the high (LAYOUT_ROWS) or low bits
+///	(LAYOUT_ROWS_LSB) of its byte.
+///
+///	@param[out] dst	bitmap in layout, LayoutSize() of the rotated size
+///	@param gray	character pixels, one byte each
+///	@param width	character width
+///	@param height	character height
+///	@param bpp	bits per pixel 1, 2, 4 or 8
+///	@param layout	LAYOUT_ROWS or LAYOUT_ROWS_LSB
+///	@param rotate	clockwise rotation 0, 90, 180 or 270
+///
+void LayoutGray(unsigned char *dst, const unsigned char *gray, int width,
+    int height, int bpp, int layout, int rotate)
+{
+    int stride;
+    int w;
+    int h;
+    int x;
+    int y;
+    int u;
+    int v;
+
+    w = rotate == 90 || rotate == 270 ? height : width;
+    h = rotate == 90 || rotate == 270 ? width : height;
+    stride = (w * bpp + 7) / 8;
+    memset(dst, 0, stride * h);
+    for (y = 0; y < height; ++y) {
+	for (x = 0; x < width; ++x) {
+	    if (!gray[y * width + x]) {
+		continue;
+	    }
+	    RotatePixel(x, y, width, height, rotate, &u, &v);
+	    u *= bpp;
+	    dst[v * stride + u / 8] |= gray[y * width + x]
+		<< (layout == LAYOUT_ROWS_LSB ? u & 7 : 8 - bpp - (u & 7));
+	}
+    }
+}
+
+#ifndef BDF2C_LIBRARY			// only the command line needs it
+
+///
+///	Grow array.
+///
+///	@param array	array to grow
+///	@param max	allocated elements
+///	@param size	size of one element
+///
+static void *GrowArray(void *array, int *max, size_t size)
+{
+    *max = *max ? *max * 2 : 64;
+    if (!(array = realloc(array, *max * size))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    return array;
+}
+
+#endif
+
+///
+///	Grow array in arena.
+///
+///	@param arena	arena of array
+///	@param array	array to grow
+///	@param max	allocated elements
+///	@param size	size of one element
+///
+static void *GrowArenaArray(Arena * arena, void *array, int *max,
+    size_t size)
+{
+    int old;
+
+    old = *max;
+    *max = *max ? *max * 2 : 64;
+    return ArenaGrow(arena, array, old * size, *max * size);
+}
+
+///
+///	Grow outline dilation one step.
+///
+///	Each pixel gets set if a pixel to the left, the right, above or
+///	below is set, with diagonal also the corner pixels.  Complete rows
+///	are processed as 64 bit words.
+///
+///	@param dst	dilated rows
+///	@param src	rows to dilate
+///	@param tmp	scratch rows for diagonal dilation
+///	@param words	64 bit words per row
+///	@param height	number of rows
+///	@param mask	valid pixels of the last word of each row
+///	@param diagonal	true use 8-connectivity, false 4-connectivity
+///
+static void OutlineDilate(uint64_t * dst, const uint64_t * src,
+    uint64_t * tmp, int words, int height, uint64_t mask, int diagonal)
+{
+    const uint64_t *up;
+    const uint64_t *down;
+    uint64_t *out;
+    uint64_t v;
+    int y;
+    int i;
+
+    // horizontal neighbours, with diagonal first into scratch rows
+    out = diagonal ? tmp : dst;
+    for (y = 0; y < height; ++y) {
+	for (i = 0; i < words; ++i) {
+	    v = src[y * words + i];
+	    v |= v >> 1 | v << 1;
+	    if (i) {
+		v |= src[y * words + i - 1] << 63;
+	    }
+	    if (i < words - 1) {
+		v |= src[y * words + i + 1] >> 63;
+	    }
+	    out[y * words + i] = v;
+	}
+	out[y * words + words - 1] &= mask;
+    }
+    // vertical neighbours, of the horizontal dilated rows with diagonal
+    if (diagonal) {
+	src = tmp;
+    }
+    for (y = 0; y < height; ++y) {
+	up = y ? src + (y - 1) * words : NULL;
+	down = y < height - 1 ? src + (y + 1) * words : NULL;
+	for (i = 0; i < words; ++i) {
+	    v = out[y * words + i];
+	    if (up) {
+		v |= up[i];
+	    }
+	    if (down) {
+		v |= down[i];
+	    }
+	    dst[y * words + i] = v;
+	}
+    }
+}
+
+///
+///	Outline character.  Create an outline font from normal fonts.
+///
+///	The outline contains all empty pixels within @p radius steps of a
+///	set pixel.  The rows are converted to 64 bit words, dilated as a
+///	whole and masked with the inverted character.
+///
+///	@param bitmap	input bitmap
+///	@param width	character width
+///	@param height	character height
+///	@param radius	outline width in pixels
+///	@param diagonal	true use 8-connectivity, false 4-connectivity
+///	@param scratch	arena for the rows, released on return
+///
+void OutlineCharacter(unsigned char *bitmap, int width, int height,
+    int radius, int diagonal, Arena * scratch)
+{
+    ArenaMark mark;
+    uint64_t *self;
+    uint64_t *grow;
+    uint64_t *next;
+    uint64_t *tmp;
+    uint64_t *swap;
+    uint64_t mask;
+    uint64_t v;
+    int stride;
+    int words;
+    int n;
+    int y;
+    int i;
+    int j;
+
+    if (width <= 0 || height <= 0) {
+	return;
+    }
+    stride = (width + 7) / 8;
+    words = (width + 63) / 64;
+    n = words * height;
+    ArenaGetMark(scratch, &mark);
+    self = ArenaAlloc(scratch, 4 * n * sizeof(*self));
+    grow = self + n;
+    next = grow + n;
+    tmp = next + n;
+    mask = width % 64 ? ~(~(uint64_t) 0 >> width % 64) : ~(uint64_t) 0;
+
+    // load rows, first pixel is the most significant bit
+    for (y = 0; y < height; ++y) {
+	for (i = 0, j = 0; i < words; ++i, j += 8) {
+	    if (j + 8 <= stride) {
+		v = LoadBe64(bitmap + y * stride + j);
+	    } else {
+		v = 0;
+		for (; j < stride; ++j) {
+		    v |= (uint64_t) bitmap[y * stride + j] << (56 - j % 8 * 8);
+		}
+	    }
+	    self[y * words + i] = v;
+	}
+	self[y * words + words - 1] &= mask;
+    }
+
+    OutlineDilate(grow, self, tmp, words, height, mask, diagonal);
+    for (i = 1; i < radius; ++i) {
+	OutlineDilate(next, grow, tmp, words, height, mask, diagonal);
+	swap = grow;
+	grow = next;
+	next = swap;
+    }
+
+    // store outline without the character
+    for (y = 0; y < height; ++y) {
+	for (i = 0, j = 0; i < words; ++i, j += 8) {
+	    v = grow[y * words + i] & ~self[y * words + i];
+	    if (j + 8 <= stride) {
+		StoreBe64(bitmap + y * stride + j, v);
+	    } else {
+		for (; j < stride; ++j) {
+		    bitmap[y * stride + j] = v >> (56 - j % 8 * 8);
+		}
+	    }
+	}
+    }
+    ArenaRelease(scratch, &mark);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Input
+//////////////////////////////////////////////////////////////////////////////
+
+#define BDF_BLOCK_SIZE	(1024 * 1024)	///< read block size for pipes
+
+///
+///	BDF input.
+///
+///	Regular files are mapped into memory, pipes and terminals are read
+///	in large blocks.  Lines are returned as pointer ranges into the
+///	buffer, nothing is copied or terminated.  Memory buffers of the
+///	library are used like a mapped file.
+///
+typedef struct _bdf_input_ {
+    FILE *File;				///< input stream
+    char *Buffer;			///< mapped or allocated input buffer
+    size_t Size;			///< size of mapping or allocation
+    const char *Pos;			///< current position in buffer
+    const char *End;			///< end of valid data in buffer
+    int Mapped;				///< true buffer is mmap'ed
+    int Borrowed;			///< true buffer of caller, not freed
+    int Eof;				///< true no more data in stream
+    size_t Bytes;			///< bytes read from stream
+} BdfInput;
+
+///
+///	Open BDF input.
+///
+///	@param in	input state to initialize
+///	@param bdf	file stream for input (bdf file)
+///
+static void BdfInputOpen(BdfInput * in, FILE * bdf)
+{
+    struct stat st;
+    off_t off;
+    void *map;
+
+    memset(in, 0, sizeof(*in));
+    in->File = bdf;
+
+    if (!fstat(fileno(bdf), &st) && S_ISREG(st.st_mode) && st.st_size > 0
+	&& (off = ftello(bdf)) >= 0 && off < st.st_size) {
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(bdf), 0);
+	if (map != MAP_FAILED) {
+	    madvise(map, st.st_size, MADV_SEQUENTIAL);
+	    in->Buffer = map;
+	    in->Size = st.st_size;
+	    in->Pos = in->Buffer + off;
+	    in->End = in->Buffer + st.st_size;
+	    in->Mapped = 1;
+	    in->Eof = 1;
+	    in->Bytes = st.st_size - off;
+	    return;
+	}
+    }
+    // fallback: read in large blocks
+    in->Size = BDF_BLOCK_SIZE;
+    if (!(in->Buffer = malloc(in->Size))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    in->Pos = in->Buffer;
+    in->End = in->Buffer;
+}
+
+///
+///	Open BDF input from memory buffer.
+///
+///	@param in	input state to initialize
+///	@param data	bdf font in memory, must stay valid until close
+///	@param size	size of bdf font
+///
+static void BdfInputMemory(BdfInput * in, const void *data, size_t size)
+{
+    memset(in, 0, sizeof(*in));
+    in->Buffer = (char *)data;
+    in->Size = size;
+    in->Pos = in->Buffer;
+    in->End = in->Buffer + size;
+    in->Mapped = 1;
+    in->Borrowed = 1;
+    in->Eof = 1;
+    in->Bytes = size;
+}
+
+///
+///	Close BDF input.  A mapped stream is positioned after the consumed
+///	data, like reading it would.
+///
+///	@param in	input state
+///
+static void BdfInputClose(BdfInput * in)
+{
+    if (in->Borrowed) {
+	// buffer of caller
+    } else if (in->Mapped) {
+	fseeko(in->File, in->Pos - in->Buffer, SEEK_SET);
+	munmap(in->Buffer, in->Size);
+    } else {
+	free(in->Buffer);
+    }
+    in->Buffer = NULL;
+}
+
+///
+///	Refill input buffer, keeps the unconsumed rest of the buffer.
+///
+///	@param in	input state
+///
+///	@returns false if no more data could be read.
+///
+static int BdfInputFill(BdfInput * in)
+{
+    size_t rest;
+    size_t n;
+
+    if (in->Eof) {
+	return 0;
+    }
+    rest = in->End - in->Pos;
+    if (rest == in->Size) {		// line longer than buffer
+	in->Size *= 2;
+	if (!(in->Buffer = realloc(in->Buffer, in->Size))) {
+	    fprintf(stderr, "Out of memory\n");
+	    exit(-1);
+	}
+    } else {
+	memmove(in->Buffer, in->Pos, rest);
+    }
+    in->Pos = in->Buffer;
+    in->End = in->Buffer + rest;
+
+    n = fread(in->Buffer + rest, 1, in->Size - rest, in->File);
+    if (!n) {
+	in->Eof = 1;
+	return 0;
+    }
+    in->End += n;
+    in->Bytes += n;
+    return 1;
+}
+
+///
+///	Get next line from input.
+///
+///	@param in	input state
+///	@param[out] end	end of line (excluding newline)
+///
+///	@returns start of line, NULL on end of file.  The line is valid until
+///	the next call.
+///
+static const char *BdfInputLine(BdfInput * in, const char **end)
+{
+    const char *line;
+    const char *nl;
+    size_t scanned;
+
+    scanned = 0;
+    while (!(nl = memchr(in->Pos + scanned, '\n',
+		in->End - in->Pos - scanned))) {
+	scanned = in->End - in->Pos;
+	if (!BdfInputFill(in)) {
+	    if (in->Pos == in->End) {	// EOF
+		return NULL;
+	    }
+	    // last line without newline
+	    line = in->Pos;
+	    *end = in->End;
+	    in->Pos = in->End;
+	    return line;
+	}
+    }
+    line = in->Pos;
+    *end = nl;
+    in->Pos = nl + 1;
+    return line;
+}
+
+///
+///	Split next token from line.
+///
+///	@param[in,out] s	current position in line, advanced past token
+///	@param e		end of line
+///	@param[out] len		length of token
+///
+///	@returns start of token, NULL if no more tokens.
+///
+static const char *NextToken(const char **s, const char *e, size_t * len)
+{
+    const char *p;
+    const char *t;
+
+    p = *s;
+    while (p < e && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+	++p;
+    }
+    if (p == e) {
+	*s = p;
+	return NULL;
+    }
+    t = p;
+    while (p < e && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+	++p;
+    }
+    *s = p;
+    *len = p - t;
+    return t;
+}
+
+///
+///	Token to integer, like atoi but bounded by the token length.
+///	Too large numbers are limited to INT_MAX.
+///
+///	@param s	token, can be NULL
+///	@param len	length of token
+///
+///	@returns converted integer, 0 for missing token.
+///
+static int TokenInt(const char *s, size_t len)
+{
+    const char *e;
+    int neg;
+    int i;
+
+    if (!s) {
+	return 0;
+    }
+    e = s + len;
+    neg = 0;
+    if (s < e && (*s == '-' || *s == '+')) {
+	neg = *s++ == '-';
+    }
+    for (i = 0; s < e && *s >= '0' && *s <= '9'; ++s) {
+	i = i > (INT_MAX - 9) / 10 ? INT_MAX : i * 10 + *s - '0';
+    }
+    return neg ? -i : i;
+}
+
+///
+///	Get next token of line as integer.
+///
+///	@param[in,out] s	current position in line
+///	@param e		end of line
+///
+static int NextInt(const char **s, const char *e)
+{
+    const char *t;
+    size_t len;
+
+    t = NextToken(s, e, &len);
+    return TokenInt(t, t ? len : 0);
+}
+
+///
+///	BDF keywords used by the convertor.
+///
+enum BdfKeyword {
+    KeywordNone,			///< no keyword or scanline
+    KeywordFontBoundingBox,		///< FONTBOUNDINGBOX
+    KeywordChars,			///< CHARS
+    KeywordFontAscent,			///< FONT_ASCENT property
+    KeywordFontDescent,			///< FONT_DESCENT property
+    KeywordStartChar,			///< STARTCHAR
+    KeywordEncoding,			///< ENCODING
+    KeywordDWidth,			///< DWIDTH
+    KeywordBbx,				///< BBX
+    KeywordBitmap,			///< BITMAP
+    KeywordEndChar,			///< ENDCHAR
+};
+
+///
+///	Compare token with keyword, ignoring case.
+///
+#define TokenIs(s, len, kw) \
+    ((len) == sizeof(kw) - 1 && !strncasecmp((s), (kw), sizeof(kw) - 1))
+
+///
+///	Lookup keyword of token, dispatched on the first character.
+///
+///	@param s	token
+///	@param len	length of token
+///
+static enum BdfKeyword Keyword(const char *s, size_t len)
+{
+    switch (*s | 0x20) {		// lower case
+	case 'b':
+	    if (TokenIs(s, len, "BBX")) {
+		return KeywordBbx;
+	    }
+	    if (TokenIs(s, len, "BITMAP")) {
+		return KeywordBitmap;
+	    }
+	    break;
+	case 'c':
+	    if (TokenIs(s, len, "CHARS")) {
+		return KeywordChars;
+	    }
+	    break;
+	case 'd':
+	    if (TokenIs(s, len, "DWIDTH")) {
+		return KeywordDWidth;
+	    }
+	    break;
+	case 'e':
+	    if (TokenIs(s, len, "ENCODING")) {
+		return KeywordEncoding;
+	    }
+	    if (TokenIs(s, len, "ENDCHAR")) {
+		return KeywordEndChar;
+	    }
+	    break;
+	case 'f':
+	    if (TokenIs(s, len, "FONTBOUNDINGBOX")) {
+		return KeywordFontBoundingBox;
+	    }
+	    if (TokenIs(s, len, "FONT_ASCENT")) {
+		return KeywordFontAscent;
+	    }
+	    if (TokenIs(s, len, "FONT_DESCENT")) {
+		return KeywordFontDescent;
+	    }
+	    break;
+	case 's':
+	    if (TokenIs(s, len, "STARTCHAR")) {
+		return KeywordStartChar;
+	    }
+	    break;
+    }
+    return KeywordNone;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Statistics
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Phases of the conversion for --stats.
+///
+enum BdfPhase {
+    PhaseRead,				///< read header, split chunks, read cache
+    PhaseConvert,			///< convert chunks, contains the next three
+    PhaseDecode,			///< hex decode and shift scanlines
+    PhaseOutline,			///< outline characters
+    PhaseEmit,				///< store, pack and dump characters
+    PhaseWrite,				///< write chunks, tables and cache
+    PhasePreview,			///< draw and write preview picture
+    PhaseMax				///< number of phases
+};
+
+    /// names of phases
+static const char *const PhaseNames[PhaseMax] = {
+    "read", "convert", "decode", "outline", "emit", "write", "preview"
+};
+
+///
+///	Check if phase is part of the conversion phase.  Only wall time is
+///	measured for them, per character.
+///
+#define PhaseInConvert(phase) \
+    ((phase) > PhaseConvert && (phase) <= PhaseEmit)
+
+///
+///	Point in time for --stats.
+///
+typedef struct _bdf_clock_ {
+    double Wall;			///< wall clock seconds
+    double Cpu;				///< cpu seconds of calling thread
+} BdfClock;
+
+///
+///	Times and counters of a conversion or chunk for --stats.
+///
+typedef struct _bdf_stats_ {
+    double Wall[PhaseMax];		///< wall seconds of each phase
+    double Cpu[PhaseMax];		///< cpu seconds of each phase
+    int Glyphs;				///< stored characters
+    int Shifted;			///< characters shifted by their bbx
+    size_t ArenaPeak;			///< most bytes used of the arenas
+} BdfStats;
+
+///
+///	Get wall clock time.
+///
+///	@returns seconds of monotonic clock.
+///
+static double WallNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+///	Get wall clock and cpu time of calling thread.
+///
+///	@param[out] now	current time
+///
+static void ClockNow(BdfClock * now)
+{
+    struct timespec ts;
+
+    now->Wall = WallNow();
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    now->Cpu = ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+///	Add time since start to phase.
+///
+///	@param stats	statistics to update
+///	@param phase	phase which ends now
+///	@param start	start time of phase
+///
+static void StatsAdd(BdfStats * stats, enum BdfPhase phase,
+    const BdfClock * start)
+{
+    BdfClock now;
+
+    ClockNow(&now);
+    stats->Wall[phase] += now.Wall - start->Wall;
+    stats->Cpu[phase] += now.Cpu - start->Cpu;
+}
+
+///
+///	Add times and counters of a chunk.
+///
+///	@param stats	statistics to update
+///	@param add	statistics to add
+///
+static void StatsMerge(BdfStats * stats, const BdfStats * add)
+{
+    int i;
+
+    for (i = 0; i < PhaseMax; ++i) {
+	stats->Wall[i] += add->Wall[i];
+	stats->Cpu[i] += add->Cpu[i];
+    }
+    stats->Glyphs += add->Glyphs;
+    stats->Shifted += add->Shifted;
+}
+
+///
+///	Print statistics of a conversion on stderr.
+///
+///	The total cpu time is the sum of the phases, so it stays correct
+///	with other fonts converted in parallel.  The peak memory is that
+///	of the whole process, the arena peak is the sum of the arenas of
+///	the conversion.
+///
+///	@param options	conversion options
+///	@param stats	times and counters of the conversion
+///	@param wall	wall seconds of the whole conversion
+///	@param read	bytes read
+///	@param written	bytes written
+///	@param writes	blocks written
+///
+static void StatsPrint(const BdfOptions * options, const BdfStats * stats,
+    double wall, size_t read, size_t written, unsigned writes)
+{
+    struct rusage usage;
+    Output out;
+    double cpu;
+    long peak;
+    int i;
+
+    cpu = 0.0;
+    for (i = 0; i < PhaseMax; ++i) {
+	if (!PhaseInConvert(i)) {
+	    cpu += stats->Cpu[i];
+	}
+    }
+    peak = getrusage(RUSAGE_SELF, &usage) ? 0 : usage.ru_maxrss;
+
+    // collected and written at once, parallel fonts don't mix lines
+    OutputOpen(&out, NULL);
+    if (options->Stats == STATS_JSON) {
+	OutputString(&out, "{\"font\":");
+	OutputJsonString(&out, options->Name);
+	OutputPrintf(&out, ",\"glyphs\":%d,\"shifted\":%d,"
+	    "\"bytes_read\":%zu,\"bytes_written\":%zu,\"writes\":%u,"
+	    "\"peak_memory_kib\":%ld,\"arena_peak_bytes\":%zu,"
+	    "\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"phases\":{", stats->Glyphs, stats->Shifted, read, written, writes, peak,
+	    stats->ArenaPeak, wall * 1e3, cpu * 1e3);
+	for (i = 0; i < PhaseMax; ++i) {
+	    OutputPrintf(&out, "%s\"%s\":{\"wall_ms\":%.3f", i ? "," : "",
+		PhaseNames[i], stats->Wall[i] * 1e3);
+	    if (!PhaseInConvert(i)) {
+		OutputPrintf(&out, ",\"cpu_ms\":%.3f", stats->Cpu[i] * 1e3);
+	    }
+	    OutputChar(&out, '}');
+	}
+	OutputString(&out, "}}\n");
+    } else {
+	OutputPrintf(&out, "%s: %d glyphs, %d shifted, %zu bytes read, "
+	    "%zu bytes written in %u writes, peak memory %ld KiB, "
+	    "arena peak %zu bytes\n", options->Name, stats->Glyphs,
+	    stats->Shifted, read, written, writes, peak, stats->ArenaPeak);
+	OutputPrintf(&out, "%s: %-10s %10s %10s\n", options->Name, "phase",
+	    "wall ms", "cpu ms");
+	for (i = 0; i < PhaseMax; ++i) {
+	    if (PhaseInConvert(i)) {
+		OutputPrintf(&out, "%s:   %-8s %10.3f %10s\n", options->Name,
+		    PhaseNames[i], stats->Wall[i] * 1e3, "-");
+	    } else {
+		OutputPrintf(&out, "%s: %-10s %10.3f %10.3f\n", options->Name,
+		    PhaseNames[i], stats->Wall[i] * 1e3, stats->Cpu[i] * 1e3);
+	    }
+	}
+	OutputPrintf(&out, "%s: %-10s %10.3f %10.3f\n", options->Name,
+	    "total", wall * 1e3, cpu * 1e3);
+    }
+    fwrite(out.Buffer, 1, out.Used, stderr);
+    OutputClose(&out);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Conversion
+//////////////////////////////////////////////////////////////////////////////
+
+#define CHUNK_CHARACTERS 512		///< characters per chunk
+#define BDF_MAX_SIZE 16384		///< largest size and offset in pixels
+
+    /// check size or offset of font file
+#define InRange(v) ((v) >= -BDF_MAX_SIZE && (v) <= BDF_MAX_SIZE)
+
+    /// check size of the tables of font.h, stored as unsigned char
+#define FitsSize(v) ((v) >= 0 && (v) <= UCHAR_MAX)
+
+    /// check offset of the tables of font.h, stored as signed char
+#define FitsOffset(v) ((v) >= SCHAR_MIN && (v) <= SCHAR_MAX)
+
+///
+///	Font values needed to convert the characters.
+///
+typedef struct _bdf_font_ {
+    const BdfOptions *Options;		///< conversion options
+    int Width;				///< bitmap width (with outline)
+    int Height;				///< bitmap height (with outline)
+    int X;				///< font bounding box x offset
+    int Y;				///< font bounding box y offset
+    int Ascent;				///< FONT_ASCENT, pixels above baseline
+    int Descent;			///< FONT_DESCENT, pixels below baseline
+    int Cache;				///< true record all characters for cache
+    jmp_buf *Fail;			///< error exit of library or NULL
+    char *Error;			///< error message buffer of library
+    size_t ErrorSize;			///< size of error message buffer
+} BdfFont;
+
+///
+///	Fail with error in font.  The command line prints the message and
+///	exits, the library returns the message to its caller.
+///
+///	@param font	font with error exit
+///	@param fmt	printf format of message, without newline
+///
+static void __attribute__ ((format(printf, 2, 3), noreturn))
+BdfFail(const BdfFont * font, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    if (font->Fail) {
+	vsnprintf(font->Error, font->ErrorSize, fmt, ap);
+	va_end(ap);
+	longjmp(*font->Fail, 1);
+    }
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(-1);
+}
+
+///
+///	Table entries of one character.
+///
+typedef struct _bdf_entry_ {
+    unsigned Width;			///< character width
+    unsigned Encoding;			///< character encoding
+    unsigned Size;			///< bitmap size in bytes
+    BdfBbx Bbx;				///< stored bitmap bounding box
+    BdfMetrics Metrics;			///< metrics of font file for --metrics
+    size_t Start;			///< start of character in chunk source
+    size_t Dump;			///< start of bitmap dump in chunk source
+    size_t End;				///< end of character in chunk source
+    long Bitmap;			///< offset in stored bitmaps, -1 none
+    uint64_t Hash;			///< bitmap hash for --dedup
+} BdfEntry;
+
+///
+///	Character for the preview picture.
+///
+typedef struct _bdf_preview_ {
+    size_t Bitmap;			///< offset of bitmap in chunk or writer
+    int Encoding;			///< character encoding
+    char Shifted;			///< character was shifted by bbx
+    int Width;				///< bitmap width
+    int Height;				///< bitmap height
+    int X;				///< bitmap x position in font cell
+    int Y;				///< bitmap y position in font cell
+    int Index;				///< character index in chunk or writer
+} BdfPreview;
+
+///
+///	Character record of the binary cache.
+///
+///	The record is followed by the character name and the bitmap, the
+///	entry bounding box gives the bitmap size.  The BBX and DWIDTH of
+///	the font file are kept for the character comment.
+///
+typedef struct _bdf_cache_char_ {
+    int Encoding;			///< character encoding
+    int DWidth;				///< DWIDTH of font file
+    int BbxX;				///< BBX x offset of font file
+    int BbxY;				///< BBX y offset of font file
+    int BbxWidth;			///< BBX width of font file
+    int BbxHeight;			///< BBX height of font file
+    unsigned Width;			///< character width of table
+    BdfBbx Bbx;				///< stored bitmap bounding box
+    int Shifted;			///< character was shifted by bbx
+    int NameLength;			///< length of character name
+} BdfCacheChar;
+
+///
+///	Header of the binary cache file.
+///
+typedef struct _bdf_cache_header_ {
+    char Magic[8];			///< CACHE_MAGIC
+    uint64_t Key;			///< hash of font file and options
+    int Width;				///< bitmap width (with outline)
+    int Height;				///< bitmap height (with outline)
+    int X;				///< font bounding box x offset
+    int Y;				///< font bounding box y offset
+    int Ascent;				///< FONT_ASCENT
+    int Descent;			///< FONT_DESCENT
+    int Size;				///< size of header, check for layout
+} BdfCacheHeader;
+
+#define CACHE_MAGIC "bdf2c\0c1"		///< cache file magic and version
+
+///
+///	Chunk of characters.
+///
+///	The input is split at STARTCHAR lines into chunks of complete
+///	characters, which are converted independent of each other.
+///
+typedef struct _bdf_chunk_ {
+    const char *Text;			///< input lines of chunk
+    size_t Length;			///< length of input lines
+    char *Copy;				///< copy of input lines (pipes)
+    size_t CopySize;			///< allocated size of copy
+
+    Output Source;			///< converted C source
+    Output Bitmaps;			///< raw bitmaps of characters
+    Output Packed;			///< packed bitmaps for --compress
+    Output Cache;			///< cache records for --cache
+
+    BdfEntry *Entries;			///< table entries of characters
+    int EntryCount;			///< number of table entries
+    int EntryMax;			///< allocated table entries
+    BdfPreview *Previews;		///< characters for preview
+    int PreviewCount;			///< number of preview characters
+    int PreviewMax;			///< allocated preview characters
+    Arena Arena;			///< tables and bitmaps of one chunk
+    BdfStats Stats;			///< times and counters for --stats
+
+    int Done;				///< chunk is converted
+} BdfChunk;
+
+///
+///	Input splitter state.
+///
+typedef struct _bdf_splitter_ {
+    BdfInput *Input;			///< input to split
+    const char *Line;			///< line read ahead for next chunk
+    const char *LineEnd;		///< end of read ahead line
+    const BdfFont *Font;		///< font for errors
+    int Eof;				///< true no more characters
+    int Stats;				///< true time reading for --stats
+} BdfSplitter;
+
+///
+///	Allocate chunk.
+///
+///	@param font	font for errors
+///
+static BdfChunk *ChunkNew(const BdfFont * font)
+{
+    BdfChunk *chunk;
+
+    if (!(chunk = calloc(1, sizeof(*chunk)))) {
+	BdfFail(font, "Out of memory");
+    }
+    OutputOpen(&chunk->Source, NULL);
+    OutputOpen(&chunk->Bitmaps, NULL);
+    OutputOpen(&chunk->Packed, NULL);
+    OutputOpen(&chunk->Cache, NULL);
+    ArenaInit(&chunk->Arena);
+    return chunk;
+}
+
+///
+///	Free chunk.
+///
+///	@param chunk	chunk to free
+///
+static void ChunkDel(BdfChunk * chunk)
+{
+    OutputClose(&chunk->Source);
+    OutputClose(&chunk->Bitmaps);
+    OutputClose(&chunk->Packed);
+    OutputClose(&chunk->Cache);
+    free(chunk->Copy);
+    ArenaFree(&chunk->Arena);
+    free(chunk);
+}
+
+///
+///	Empty chunk for the next characters.  The tables and bitmaps of the
+///	chunk arena are released.
+///
+///	@param chunk	chunk to reset
+///
+static void ChunkReset(BdfChunk * chunk)
+{
+    OutputReset(&chunk->Source);
+    OutputReset(&chunk->Bitmaps);
+    OutputReset(&chunk->Packed);
+    OutputReset(&chunk->Cache);
+    ArenaReset(&chunk->Arena);
+    chunk->Entries = NULL;
+    chunk->EntryCount = 0;
+    chunk->EntryMax = 0;
+    chunk->Previews = NULL;
+    chunk->PreviewCount = 0;
+    chunk->PreviewMax = 0;
+}
+
+///
+///	Add input line to chunk.
+///
+///	@param splitter	input splitter
+///	@param chunk	chunk to fill
+///	@param line	start of line
+///	@param e	end of line
+///
+static void ChunkAddLine(BdfSplitter * splitter, BdfChunk * chunk,
+    const char *line, const char *e)
+{
+    if (splitter->Input->Mapped) {	// lines are consecutive in memory
+	if (!chunk->Text) {
+	    chunk->Text = line;
+	}
+	chunk->Length = e - chunk->Text;
+	if (e < splitter->Input->End) {	// include newline
+	    chunk->Length++;
+	}
+	return;
+    }
+    if (chunk->Length + (e - line) + 1 > chunk->CopySize) {
+	chunk->CopySize = (chunk->Length + (e - line) + 1) * 2;
+	if (!(chunk->Copy = realloc(chunk->Copy, chunk->CopySize))) {
+	    BdfFail(splitter->Font, "Out of memory");
+	}
+    }
+    memcpy(chunk->Copy + chunk->Length, line, e - line);
+    chunk->Length += e - line;
+    chunk->Copy[chunk->Length++] = '\n';
+    chunk->Text = chunk->Copy;
+}
+
+///
+///	Split next chunk of characters from input.
+///
+///	@param splitter	input splitter
+///	@param chunk	chunk to fill
+///
+///	@returns false if there are no more characters.
+///
+static int SplitChunk(BdfSplitter * splitter, BdfChunk * chunk)
+{
+    const char *line;
+    const char *e;
+    const char *s;
+    const char *t;
+    size_t len;
+    int n;
+
+    chunk->Text = NULL;
+    chunk->Length = 0;
+    if (splitter->Eof) {
+	return 0;
+    }
+    n = 0;
+    if ((line = splitter->Line)) {	// STARTCHAR read ahead
+	ChunkAddLine(splitter, chunk, line, splitter->LineEnd);
+	splitter->Line = NULL;
+	n = 1;
+    }
+    while ((line = BdfInputLine(splitter->Input, &e))) {
+	t = line;
+	if (!(s = NextToken(&t, e, &len))) {	// empty line
+	    break;
+	}
+	if ((*s | 0x20) == 's' && TokenIs(s, len, "STARTCHAR")
+	    && n++ == CHUNK_CHARACTERS) {
+	    splitter->Line = line;
+	    splitter->LineEnd = e;
+	    return 1;
+	}
+	ChunkAddLine(splitter, chunk, line, e);
+    }
+    splitter->Eof = 1;
+    return chunk->Length != 0;
+}
+
+///
+///	Read next chunk of characters.
+///
+///	@param splitter	input splitter
+///	@param chunk	chunk to fill, its statistics are reset
+///
+///	@returns false if there are no more characters.
+///
+static int ReadChunk(BdfSplitter * splitter, BdfChunk * chunk)
+{
+    BdfClock start;
+    int ret;
+
+    memset(&chunk->Stats, 0, sizeof(chunk->Stats));
+    if (!splitter->Stats) {
+	return SplitChunk(splitter, chunk);
+    }
+    ClockNow(&start);
+    ret = SplitChunk(splitter, chunk);
+    StatsAdd(&chunk->Stats, PhaseRead, &start);
+    return ret;
+}
+
+///
+///	Hash character bitmap (FNV-1a).
+///
+///	@param bitmap	character bitmap
+///	@param width	bitmap width
+///	@param height	bitmap height
+///	@param size	bitmap size in bytes
+///
+static uint64_t BitmapHash(const unsigned char *bitmap, int width,
+    int height, int size)
+{
+    uint64_t hash;
+    int i;
+
+    hash = 14695981039346656037ULL;
+    hash = (hash ^ (unsigned)width) * 1099511628211ULL;
+    hash = (hash ^ (unsigned)height) * 1099511628211ULL;
+    for (i = 0; i < size; ++i) {
+	hash = (hash ^ bitmap[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+///
+///	Scale character metrics for --downscale.  The ink box covers all
+///	downscaled pixels of the ink, the advance is rounded to nearest.
+///
+///	@param metrics	character metrics to scale
+///	@param scale	downscale factor
+///
+static void ScaleMetrics(BdfMetrics * metrics, int scale)
+{
+    int x;
+    int y;
+
+    x = FloorDiv(metrics->Ink.X, scale);
+    y = FloorDiv(metrics->Ink.Y, scale);
+    if (metrics->Ink.Width && metrics->Ink.Height) {
+	metrics->Ink.Width =
+	    FloorDiv(metrics->Ink.X + metrics->Ink.Width + scale - 1,
+	    scale) - x;
+	metrics->Ink.Height =
+	    FloorDiv(metrics->Ink.Y + metrics->Ink.Height + scale - 1,
+	    scale) - y;
+    }
+    metrics->Ink.X = x;
+    metrics->Ink.Y = y;
+    metrics->Advance = (metrics->Advance + scale / 2) / scale;
+}
+
+///
+///	Check that the emitted tables can hold the stored character.  The
+///	font file allows larger sizes and offsets than font.h.
+///
+///	@param font	font with conversion options
+///	@param entry	table entry of stored character
+///
+static void CheckCharacter(const BdfFont * font, const BdfEntry * entry)
+{
+    const BdfOptions *options;
+    const BdfBbx *bbx;
+
+    options = font->Options;
+    if (!FitsSize((int)entry->Width)) {
+	BdfFail(font, "Character %u: width %d larger than %d of font.h",
+	    entry->Encoding, (int)entry->Width, UCHAR_MAX);
+    }
+    bbx = &entry->Bbx;
+    if (options->Proportional && (!FitsSize(bbx->Width)
+	    || !FitsSize(bbx->Height) || !FitsOffset(bbx->X)
+	    || !FitsOffset(bbx->Y))) {
+	BdfFail(font, "Character %u: bounding box %d %d %d %d out of range "
+	    "of font.h", entry->Encoding, bbx->Width, bbx->Height, bbx->X,
+	    bbx->Y);
+    }
+    bbx = &entry->Metrics.Ink;
+    if (options->Metrics && (!FitsSize(entry->Metrics.Advance)
+	    || !FitsSize(bbx->Width) || !FitsSize(bbx->Height)
+	    || !FitsOffset(bbx->X) || !FitsOffset(bbx->Y))) {
+	BdfFail(font, "Character %u: metrics %d %d %d %d %d out of range "
+	    "of font.h", entry->Encoding, entry->Metrics.Advance, bbx->Width,
+	    bbx->Height, bbx->X, bbx->Y);
+    }
+}
+
+///
+///	Store converted character bitmap in chunk.
+///
+///	Adds the character to the preview and atlas, stores the bitmap and
+///	writes its dump to the chunk source.  With --layout, --rotate,
+///	--downscale or --bpp the stored bitmap and its bounding box are
+///	converted, the preview keeps the character upright at font size.
+///
+///	@param font	font with conversion options
+///	@param chunk	chunk to store character in
+///	@param entry	table entry of character, Bbx gives bitmap size
+///	@param bitmap	character bitmap, after shift and outline
+///	@param shifted	true character was shifted by its bbx
+///
+static void StoreCharacter(const BdfFont * font, BdfChunk * chunk,
+    BdfEntry * entry, const unsigned char *bitmap, int shifted)
+{
+    const BdfOptions *options;
+    BdfPreview *preview;
+    ArenaMark mark;
+    unsigned char *stored;
+    unsigned char *gray;
+    int bitmap_width;
+    int bitmap_height;
+    int converted;
+    int scale;
+    int bpp;
+    int size;
+
+    options = font->Options;
+    bitmap_width = entry->Bbx.Width;
+    bitmap_height = entry->Bbx.Height;
+    scale = options->Downscale > 1 ? options->Downscale : 1;
+    bpp = options->Bpp > 1 ? options->Bpp : 1;
+    converted = options->Layout != LAYOUT_ROWS || options->Rotate
+	|| scale > 1 || bpp > 1;
+    if (options->Outline) {		// outline pixels around the ink
+	entry->Metrics.Advance += options->Outline;
+	if (entry->Metrics.Ink.Width && entry->Metrics.Ink.Height) {
+	    entry->Metrics.Ink.X -= options->Outline;
+	    entry->Metrics.Ink.Y -= options->Outline;
+	    entry->Metrics.Ink.Width += 2 * options->Outline;
+	    entry->Metrics.Ink.Height += 2 * options->Outline;
+	}
+    }
+    chunk->Stats.Glyphs++;
+    chunk->Stats.Shifted += shifted != 0;
+    // the atlas needs all characters, DrawPreview() skips them
+    if (options->Atlas || (options->Preview
+	    && (int)entry->Encoding >= options->PreviewFirst
+	    && (int)entry->Encoding <= options->PreviewLast)) {
+	if (chunk->PreviewCount == chunk->PreviewMax) {
+	    chunk->Previews =
+		GrowArenaArray(&chunk->Arena, chunk->Previews,
+		&chunk->PreviewMax, sizeof(*chunk->Previews));
+	}
+	preview = &chunk->Previews[chunk->PreviewCount++];
+	preview->Bitmap = chunk->Bitmaps.Used;
+	preview->Encoding = entry->Encoding;
+	preview->Shifted = shifted;
+	preview->Width = bitmap_width;
+	preview->Height = bitmap_height;
+	preview->X = 0;
+	preview->Y = 0;
+	preview->Index = entry - chunk->Entries;
+	if (options->Proportional) {
+	    // position in font bounding box
+	    preview->X = entry->Bbx.X - font->X;
+	    preview->Y =
+		font->Y + font->Height - entry->Bbx.Y - bitmap_height;
+	}
+	if (converted) {		// upright copy for preview
+	    OutputWrite(&chunk->Bitmaps, bitmap,
+		((bitmap_width + 7) / 8) * bitmap_height);
+	}
+    }
+    if (converted) {
+	ArenaGetMark(&chunk->Arena, &mark);
+	gray = NULL;
+	if (scale > 1 || bpp > 1) {
+	    bitmap_width = (entry->Bbx.Width + scale - 1) / scale;
+	    bitmap_height = (entry->Bbx.Height + scale - 1) / scale;
+	    gray = ArenaAlloc(&chunk->Arena, bitmap_width * bitmap_height);
+	    DownscaleBitmap(gray, bitmap, entry->Bbx.Width, entry->Bbx.Height,
+		scale, (1 << bpp) - 1);
+	    entry->Bbx.Width = bitmap_width;
+	    entry->Bbx.Height = bitmap_height;
+	    // offsets rounded down, the advance to nearest
+	    entry->Bbx.X = FloorDiv(entry->Bbx.X, scale);
+	    entry->Bbx.Y = FloorDiv(entry->Bbx.Y, scale);
+	    entry->Width = (entry->Width + scale / 2) / scale;
+	    ScaleMetrics(&entry->Metrics, scale);
+	}
+	if (options->Rotate == 90 || options->Rotate == 270) {
+	    bitmap_width = entry->Bbx.Height;
+	    bitmap_height = entry->Bbx.Width;
+	}
+	stored = ArenaAlloc(&chunk->Arena,
+	    LayoutSize(options->Layout, bpp, bitmap_width, bitmap_height));
+	if (gray) {
+	    LayoutGray(stored, gray, entry->Bbx.Width, entry->Bbx.Height, bpp,
+		options->Layout, options->Rotate);
+	} else {
+	    LayoutBitmap(stored, bitmap, entry->Bbx.Width, entry->Bbx.Height,
+		options->Layout, options->Rotate);
+	}
+	bitmap = stored;
+	entry->Bbx.Width = bitmap_width;
+	entry->Bbx.Height = bitmap_height;
+    }
+    CheckCharacter(font, entry);
+    size = LayoutSize(options->Layout, bpp, bitmap_width, bitmap_height);
+    entry->Bitmap = chunk->Bitmaps.Used;
+    OutputWrite(&chunk->Bitmaps, bitmap, size);
+    if (options->Dedup) {
+	entry->Hash = BitmapHash(bitmap, bitmap_width, bitmap_height, size);
+    }
+    // raw bitmap file is written from stored bitmaps
+    if (options->Compress) {
+	entry->Bitmap = chunk->Packed.Used;
+	// xor with the row above, for pages with the page above
+	entry->Size = options->Layout == LAYOUT_PAGES ?
+	    PackBitmap(&chunk->Packed, bitmap, bitmap_width * 8,
+	    (bitmap_height + 7) / 8, &chunk->Arena) :
+	    PackBitmap(&chunk->Packed, bitmap, bitmap_width * bpp,
+	    bitmap_height, &chunk->Arena);
+	if (!options->BinaryFile) {
+	    DumpBytes(&chunk->Source, (const unsigned char *)
+		chunk->Packed.Buffer + entry->Bitmap, entry->Size);
+	}
+    } else {
+	entry->Size = size;
+	if (options->BinaryFile) {
+	    // raw bitmap only
+	} else if (options->Layout != LAYOUT_ROWS || bpp > 1) {
+	    DumpBytes(&chunk->Source, bitmap, size);
+	} else if (options->Compact) {
+	    DumpCharacterCompact(&chunk->Source, bitmap, bitmap_width,
+		bitmap_height);
+	} else {
+	    DumpCharacter(&chunk->Source, bitmap, bitmap_width,
+		bitmap_height);
+	}
+    }
+    if (converted) {
+	ArenaRelease(&chunk->Arena, &mark);
+    }
+    entry->End = chunk->Source.Used;
+}
+
+///
+///	Skip rest of character.
+///
+///	@param line	next line of chunk
+///	@param end	end of chunk
+///
+///	@returns line after ENDCHAR.
+///
+static const char *SkipCharacter(const char *line, const char *end)
+{
+    const char *e;
+    const char *s;
+    const char *t;
+    size_t len;
+
+    for (; line < end; line = e + 1) {
+	if (!(e = memchr(line, '\n', end - line))) {
+	    e = end;
+	}
+	t = line;
+	if ((s = NextToken(&t, e, &len)) && (*s | 0x20) == 'e'
+	    && TokenIs(s, len, "ENDCHAR")) {
+	    return e + 1;
+	}
+    }
+    return end;
+}
+
+///
+///	Add character record to cache.
+///
+///	@param out	cache records of chunk
+///	@param record	record with encoding, DWIDTH and BBX of font file
+///	@param name	character name
+///	@param entry	table entry of character
+///	@param shifted	true character was shifted by its bbx
+///	@param bitmap	character bitmap, after shift and outline
+///
+static void CacheCharacter(Output * out, BdfCacheChar * record,
+    const char *name, const BdfEntry * entry, int shifted,
+    const unsigned char *bitmap)
+{
+    record->Width = entry->Width;
+    record->Bbx = entry->Bbx;
+    record->Shifted = shifted;
+    record->NameLength = strlen(name);
+    OutputWrite(out, record, sizeof(*record));
+    OutputWrite(out, name, record->NameLength);
+    OutputWrite(out, bitmap,
+	((entry->Bbx.Width + 7) / 8) * entry->Bbx.Height);
+}
+
+///
+///	Convert chunk of characters.
+///
+///	All character values are reset at STARTCHAR, so each chunk can be
+///	converted independent of the others.
+///
+///	Normally each character is stored in a bitmap of the font bounding
+///	box, shifted by bbx.  For proportional output it is stored at its
+///	own BBX size and the BBX offsets are kept for the renderer.
+///
+///	@param font	font values
+///	@param chunk	chunk with input lines
+///
+static void ConvertChunk(const BdfFont * font, BdfChunk * chunk)
+{
+    const char *line;
+    const char *next;
+    const char *end;
+    const char *e;
+    const char *s;
+    const char *p;
+    size_t len;
+    int scanline;
+    int shift;
+    char charname[1024];
+    int encoding;
+    int bbx;
+    int bby;
+    int bbw;
+    int bbh;
+    int width;
+    int bitmap_width;
+    int bitmap_height;
+    int size;
+    int max;
+    size_t start;
+    unsigned char *bitmap;
+    BdfEntry *entry;
+    BdfEntry skipped;
+    BdfCacheChar comment;
+    const BdfOptions *options;
+    BdfClock begin;
+    double mark;
+    double now;
+
+    options = font->Options;
+    if (options->Stats) {
+	ClockNow(&begin);
+    }
+    mark = 0.0;
+    ChunkReset(chunk);
+
+    max = ((font->Width + 7) / 8) * font->Height;
+    bitmap = ArenaAlloc(&chunk->Arena, max);
+
+    scanline = -1;
+    shift = 0;
+    encoding = -1;
+    bbx = 0;
+    bby = 0;
+    bbw = 0;
+    bbh = 0;
+    width = INT_MIN;
+    bitmap_width = font->Width;
+    bitmap_height = font->Height;
+    size = max;
+    entry = NULL;
+    strcpy(charname, "unknown character");
+    end = chunk->Text + chunk->Length;
+    for (line = chunk->Text; line < end; line = next) {
+	if (!(e = memchr(line, '\n', end - line))) {
+	    e = end;
+	}
+	next = e + 1;
+	s = NextToken(&line, e, &len);	// no empty lines in chunks
+	switch (Keyword(s, len)) {
+	    case KeywordStartChar:
+		encoding = -1;
+		bbx = 0;
+		bby = 0;
+		bbw = 0;
+		bbh = 0;
+		strcpy(charname, "unknown character");
+		if ((p = NextToken(&line, e, &len))) {
+		    if (len >= sizeof(charname)) {
+			len = sizeof(charname) - 1;
+		    }
+		    memcpy(charname, p, len);
+		    charname[len] = '\0';
+		}
+		break;
+	    case KeywordEncoding:
+		encoding = NextInt(&line, e);
+		break;
+	    case KeywordDWidth:
+		width = NextInt(&line, e);
+		if (!InRange(width)) {
+		    BdfFail(font, "character width out of range");
+		}
+		break;
+	    case KeywordBbx:
+		bbw = NextInt(&line, e);
+		bbh = NextInt(&line, e);
+		bbx = NextInt(&line, e);
+		bby = NextInt(&line, e);
+		if (!InRange(bbw) || !InRange(bbh) || !InRange(bbx)
+		    || !InRange(bby)) {
+		    BdfFail(font, "character bounding box out of range");
+		}
+		break;
+	    case KeywordBitmap:
+		start = chunk->Source.Used;
+		if (!InSubset(options, encoding)) {	// not wanted
+		    if (!font->Cache) {
+			next = SkipCharacter(next, end);
+			width = INT_MIN;
+			break;
+		    }
+		    entry = &skipped;	// only decoded for cache
+		} else {
+		    if (!options->Compact && !options->BinaryFile) {
+			CharacterComment(&chunk->Source, encoding, charname,
+			    width, bbx, bby, bbw, bbh);
+		    }
+		    if (chunk->EntryCount == chunk->EntryMax) {
+			chunk->Entries =
+			    GrowArenaArray(&chunk->Arena, chunk->Entries,
+			    &chunk->EntryMax, sizeof(*chunk->Entries));
+		    }
+		    entry = &chunk->Entries[chunk->EntryCount++];
+		}
+		if (width == INT_MIN) {
+		    BdfFail(font, "character width not specified");
+		}
+		comment.Encoding = encoding;
+		comment.DWidth = width;
+		comment.BbxX = bbx;
+		comment.BbxY = bby;
+		comment.BbxWidth = bbw;
+		comment.BbxHeight = bbh;
+		entry->Metrics.Advance = width;
+		entry->Metrics.Ink.Width = bbw < 0 ? 0 : bbw;
+		entry->Metrics.Ink.Height = bbh < 0 ? 0 : bbh;
+		entry->Metrics.Ink.X = bbx;
+		entry->Metrics.Ink.Y = bby;
+		entry->Encoding = encoding;
+		entry->Start = start;
+		entry->Dump = chunk->Source.Used;
+		entry->End = chunk->Source.Used;
+		entry->Bitmap = -1;
+		entry->Hash = 0;
+		if (options->Proportional) {
+		    //
+		    //	Bitmap of BBX size, with outline radius pixels around
+		    //
+		    bitmap_width = bbw < 0 ? 0 : bbw;
+		    bitmap_height = bbh < 0 ? 0 : bbh;
+		    entry->Bbx.X = bbx;
+		    entry->Bbx.Y = bby;
+		    if (options->Outline) {
+			bitmap_width += 2 * options->Outline;
+			bitmap_height += 2 * options->Outline;
+			entry->Bbx.X -= options->Outline;
+			entry->Bbx.Y -= options->Outline;
+			width += options->Outline;
+		    }
+		    size = ((bitmap_width + 7) / 8) * bitmap_height;
+		    if (size > max) {	// doubled, the old one stays in arena
+			max = size > max * 2 ? size : max * 2;
+			bitmap = ArenaAlloc(&chunk->Arena, max);
+		    }
+		} else {
+		    //
+		    //	Adjust width based on bounding box
+		    //
+		    if (bbx < 0) {
+			width -= bbx;
+			bbx = 0;
+		    }
+		    if (bbx + bbw > width) {
+			width = bbx + bbw;
+		    }
+		    // Reserve space for outline border
+		    width += options->Outline;
+		    entry->Bbx.X = 0;
+		    entry->Bbx.Y = 0;
+		}
+		entry->Width = width;
+		entry->Bbx.Width = bitmap_width;
+		entry->Bbx.Height = bitmap_height;
+		// Leave first rows empty for outline
+		scanline = options->Outline;
+		memset(bitmap, 0, size);
+		//
+		//	Shift each scanline while it is decoded, by the bounding
+		//	box and by one pixel for the outline border.
+		//
+		shift = 0;
+		if (!options->Proportional && bbx) {
+		    if (bbx >= bitmap_width) {
+			fprintf(stderr,
+			    "Waring: This shift isn't supported: w=%d,h=%d, shift=%2d; ignored!!\n",
+			    bbx, bitmap_width, bitmap_height);
+		    } else {
+			shift = bbx;
+		    }
+		}
+		if (options->Outline) {
+		    if (options->Outline >= bitmap_width) {
+			fprintf(stderr,
+			    "Waring: This shift isn't supported: w=%d,h=%d, shift=%2d; ignored!!\n",
+			    options->Outline, bitmap_width, bitmap_height);
+		    } else {
+			shift += options->Outline;
+		    }
+		}
+		if (options->Stats) {
+		    mark = WallNow();
+		}
+		break;
+	    case KeywordEndChar:
+		if (!entry) {		// ENDCHAR without BITMAP
+		    break;
+		}
+		if (options->Stats) {
+		    now = WallNow();
+		    chunk->Stats.Wall[PhaseDecode] += now - mark;
+		    mark = now;
+		}
+		if (options->Outline) {
+		    OutlineCharacter(bitmap, bitmap_width, bitmap_height,
+			options->Outline, options->OutlineDiagonal,
+			&chunk->Arena);
+		    if (options->Stats) {
+			now = WallNow();
+			chunk->Stats.Wall[PhaseOutline] += now - mark;
+			mark = now;
+		    }
+		}
+		if (font->Cache) {
+		    CacheCharacter(&chunk->Cache, &comment, charname, entry,
+			bbx != 0, bitmap);
+		}
+		if (entry != &skipped) {
+		    StoreCharacter(font, chunk, entry, bitmap, bbx != 0);
+		}
+		if (options->Stats) {
+		    chunk->Stats.Wall[PhaseEmit] += WallNow() - mark;
+		}
+		scanline = -1;
+		width = INT_MIN;
+		entry = NULL;
+		break;
+	    default:
+		if (scanline >= 0) {
+		    if (scanline < bitmap_height
+			&& HexDecode(bitmap +
+			    scanline * ((bitmap_width + 7) / 8),
+			    (bitmap_width + 7) / 8, s, len) < 0) {
+			BdfFail(font,
+			    "Invalid hex digit '%.*s' in bitmap of character '%s'",
+			    (int)len, s, charname);
+		    }
+		    if (shift && scanline < bitmap_height) {
+			ShiftRow(bitmap + scanline * ((bitmap_width + 7) / 8),
+			    shift, (bitmap_width + 7) / 8);
+		    }
+		    ++scanline;
+		}
+		break;
+	}
+    }
+    if (options->Stats) {
+	StatsAdd(&chunk->Stats, PhaseConvert, &begin);
+    }
+}
+
+///
+///	Convert next chunk of characters from cache records.
+///
+///	@param font	font with conversion options
+///	@param chunk	chunk to fill
+///	@param[in,out] pos	next cache record
+///	@param end	end of cache records
+///
+///	@returns false if there are no more records.
+///
+static int CacheChunk(const BdfFont * font, BdfChunk * chunk,
+    const char **pos, const char *end)
+{
+    const BdfOptions *options;
+    BdfCacheChar record;
+    BdfEntry *entry;
+    char name[1024];
+    const char *p;
+    BdfClock start;
+    int size;
+    int n;
+
+    options = font->Options;
+    if (options->Stats) {
+	ClockNow(&start);
+    }
+    memset(&chunk->Stats, 0, sizeof(chunk->Stats));
+    ChunkReset(chunk);
+
+    p = *pos;
+    for (n = 0; n < CHUNK_CHARACTERS && p < end; ++n) {
+	if ((size_t)(end - p) < sizeof(record)) {
+	    BdfFail(font, "Broken cache file '%s'", options->Cache);
+	}
+	memcpy(&record, p, sizeof(record));
+	p += sizeof(record);
+	size = ((record.Bbx.Width + 7) / 8) * record.Bbx.Height;
+	if (record.NameLength < 0 || record.Bbx.Width < 0
+	    || record.Bbx.Height < 0
+	    || end - p < (long)record.NameLength + size) {
+	    BdfFail(font, "Broken cache file '%s'", options->Cache);
+	}
+	if (!InSubset(options, record.Encoding)) {
+	    p += record.NameLength + size;
+	    continue;
+	}
+	snprintf(name, sizeof(name), "%.*s", record.NameLength, p);
+	p += record.NameLength;
+
+	if (chunk->EntryCount == chunk->EntryMax) {
+	    chunk->Entries =
+		GrowArenaArray(&chunk->Arena, chunk->Entries,
+		&chunk->EntryMax, sizeof(*chunk->Entries));
+	}
+	entry = &chunk->Entries[chunk->EntryCount++];
+	entry->Start = chunk->Source.Used;
+	if (!options->Compact && !options->BinaryFile) {
+	    CharacterComment(&chunk->Source, record.Encoding, name,
+		record.DWidth, record.BbxX, record.BbxY, record.BbxWidth,
+		record.BbxHeight);
+	}
+	entry->Encoding = record.Encoding;
+	entry->Width = record.Width;
+	entry->Bbx = record.Bbx;
+	entry->Metrics.Advance = record.DWidth;
+	entry->Metrics.Ink.Width = record.BbxWidth < 0 ? 0 : record.BbxWidth;
+	entry->Metrics.Ink.Height = record.BbxHeight < 0 ? 0 : record.BbxHeight;
+	entry->Metrics.Ink.X = record.BbxX;
+	entry->Metrics.Ink.Y = record.BbxY;
+	entry->Dump = chunk->Source.Used;
+	entry->End = chunk->Source.Used;
+	entry->Bitmap = -1;
+	entry->Hash = 0;
+	StoreCharacter(font, chunk, entry, (const unsigned char *)p,
+	    record.Shifted);
+	p += size;
+    }
+    *pos = p;
+    if (options->Stats) {
+	StatsAdd(&chunk->Stats, PhaseRead, &start);
+    }
+    return n != 0;
+}
+
+///
+///	Stored bitmap for --dedup.
+///
+typedef struct _bdf_glyph_ {
+    uint64_t Hash;			///< bitmap hash
+    unsigned Offset;			///< bitmap offset in output
+    size_t Data;			///< bitmap offset in unique bitmaps
+    int Width;				///< bitmap width
+    int Height;				///< bitmap height
+    unsigned Size;			///< stored bitmap size
+    int Index;				///< first character with bitmap
+} BdfGlyph;
+
+///
+///	Output state, collects the tables of all chunks.
+///
+typedef struct _bdf_writer_ {
+    const BdfFont *Font;		///< font values
+    Output *Source;			///< C source output
+    Output *Binary;			///< raw bitmap output or NULL
+    unsigned *WidthTable;		///< width of each character
+    unsigned *EncodingTable;		///< encoding of each character
+    unsigned *OffsetTable;		///< bitmap offset of each character
+    BdfBbx *BbxTable;			///< bounding box of each character
+    BdfMetrics *MetricsTable;		///< metrics of each character
+    unsigned Offset;			///< bitmap offset of next character
+    BdfPreview *Previews;		///< characters for preview
+    int PreviewCount;			///< number of preview characters
+    int PreviewMax;			///< allocated preview characters
+    Output Cells;			///< preview bitmaps of font size
+    AtlasRect *AtlasRects;		///< atlas rectangle of each character
+    BdfAtlasBox *AtlasBoxes;		///< atlas box of each character
+    Output AtlasPixels;			///< 8 bit pixels of atlas boxes
+    int AtlasSize;			///< size of atlas pages
+    int AtlasPages;			///< number of atlas pages
+    Output Image;			///< font image, bitmaps after header
+    BdfLine Line;			///< line metrics of WriteTables()
+    int Chars;				///< allocated table entries
+    int N;				///< characters in tables
+
+    BdfGlyph *Glyphs;			///< hash table of stored bitmaps
+    int GlyphCount;			///< used hash table entries
+    int GlyphMax;			///< size of hash table, power of 2
+    Output Unique;			///< copy of stored bitmaps
+    int Duplicates;			///< characters sharing a bitmap
+    unsigned long Saved;		///< bitmap bytes saved
+    unsigned long Raw;			///< unpacked size of written bitmaps
+    Output *Cache;			///< cache records or NULL
+    Arena *Arena;			///< tables of the conversion
+    BdfStats Stats;			///< times and counters for --stats
+} BdfWriter;
+
+///
+///	Copy bitmap into a larger bitmap, clipped.
+///
+///	@param dst	destination bitmap
+///	@param dw	destination width
+///	@param dh	destination height
+///	@param src	source bitmap
+///	@param sw	source width
+///	@param sh	source height
+///	@param x	x position of source in destination
+///	@param y	y position of source in destination
+///
+static void BlitBitmap(unsigned char *dst, int dw, int dh,
+    const unsigned char *src, int sw, int sh, int x, int y)
+{
+    int i;
+    int j;
+
+    for (j = 0; j < sh; ++j) {
+	if (y + j < 0 || y + j >= dh) {
+	    continue;
+	}
+	for (i = 0; i < sw; ++i) {
+	    if (x + i < 0 || x + i >= dw) {
+		continue;
+	    }
+	    if (src[j * ((sw + 7) / 8) + i / 8] & (0x80 >> i % 8)) {
+		dst[(y + j) * ((dw + 7) / 8) + (x + i) / 8] |=
+		    0x80 >> (x + i) % 8;
+	    }
+	}
+    }
+}
+
+///
+///	Find or store character bitmap for --dedup.
+///
+///	@param writer	output state
+///	@param entry	table entry of character
+///	@param bitmap	character bitmap
+///
+///	@returns stored bitmap with the same content, NULL if the bitmap is
+///	new and was stored.
+///
+static const BdfGlyph *DedupBitmap(BdfWriter * writer,
+    const BdfEntry * entry, const unsigned char *bitmap)
+{
+    BdfGlyph *glyphs;
+    BdfGlyph *glyph;
+    int max;
+    int i;
+    int j;
+
+    if (writer->GlyphCount * 2 >= writer->GlyphMax) {	// rehash
+	max = writer->GlyphMax ? writer->GlyphMax * 2 : 1024;
+	glyphs = ArenaAlloc(writer->Arena, max * sizeof(*glyphs));
+	for (j = 0; j < max; ++j) {	// mark all entries free
+	    glyphs[j].Index = -1;
+	}
+	for (i = 0; i < writer->GlyphMax; ++i) {
+	    if (writer->Glyphs[i].Index < 0) {
+		continue;
+	    }
+	    for (j = writer->Glyphs[i].Hash & (max - 1); glyphs[j].Index >= 0;
+		j = (j + 1) & (max - 1)) {
+	    }
+	    glyphs[j] = writer->Glyphs[i];
+	}
+	writer->Glyphs = glyphs;
+	writer->GlyphMax = max;
+    }
+    for (i = entry->Hash & (writer->GlyphMax - 1);
+	(glyph = &writer->Glyphs[i])->Index >= 0;
+	i = (i + 1) & (writer->GlyphMax - 1)) {
+	if (glyph->Hash == entry->Hash && glyph->Width == entry->Bbx.Width
+	    && glyph->Height == entry->Bbx.Height && glyph->Size == entry->Size
+	    && !memcmp(writer->Unique.Buffer + glyph->Data, bitmap,
+		entry->Size)) {
+	    return glyph;
+	}
+    }
+    glyph->Hash = entry->Hash;
+    glyph->Offset = writer->Offset;
+    glyph->Data = writer->Unique.Used;
+    glyph->Width = entry->Bbx.Width;
+    glyph->Height = entry->Bbx.Height;
+    glyph->Size = entry->Size;
+    glyph->Index = writer->N;
+    writer->GlyphCount++;
+    OutputWrite(&writer->Unique, bitmap, entry->Size);
+    return NULL;
+}
+
+///
+///	Grow character tables.  The tables are doubled, the CHARS count
+///	of the font is only the first guess.
+///
+///	@param writer	output state
+///	@param n	needed table entries
+///
+static void GrowTables(BdfWriter * writer, int n)
+{
+    int chars;
+
+    chars = writer->Chars ? writer->Chars : 64;
+    while (chars < n) {
+	chars *= 2;
+    }
+    writer->WidthTable =
+	ArenaGrow(writer->Arena, writer->WidthTable,
+	writer->Chars * sizeof(*writer->WidthTable),
+	chars * sizeof(*writer->WidthTable));
+    writer->EncodingTable =
+	ArenaGrow(writer->Arena, writer->EncodingTable,
+	writer->Chars * sizeof(*writer->EncodingTable),
+	chars * sizeof(*writer->EncodingTable));
+    writer->OffsetTable =
+	ArenaGrow(writer->Arena, writer->OffsetTable,
+	writer->Chars * sizeof(*writer->OffsetTable),
+	chars * sizeof(*writer->OffsetTable));
+    writer->BbxTable =
+	ArenaGrow(writer->Arena, writer->BbxTable,
+	writer->Chars * sizeof(*writer->BbxTable),
+	chars * sizeof(*writer->BbxTable));
+    writer->MetricsTable =
+	ArenaGrow(writer->Arena, writer->MetricsTable,
+	writer->Chars * sizeof(*writer->MetricsTable),
+	chars * sizeof(*writer->MetricsTable));
+    writer->Chars = chars;
+}
+
+///
+///	Write converted chunk, in input order.
+///
+///	With --dedup a bitmap equal to an already written one isn't
+///	written again, the offset table points to the first copy.
+///
+///	@param writer	output state
+///	@param chunk	converted chunk
+///
+static void WriteChunk(BdfWriter * writer, const BdfChunk * chunk)
+{
+    const BdfOptions *options;
+    const BdfFont *font;
+    const BdfEntry *entry;
+    const BdfGlyph *glyph;
+    const BdfPreview *preview;
+    const unsigned char *bitmap;
+    unsigned char *cell;
+    BdfClock start;
+    int first;
+    int size;
+    int i;
+
+    options = writer->Font->Options;
+    if (options->Stats) {
+	ClockNow(&start);
+	StatsMerge(&writer->Stats, &chunk->Stats);
+    }
+    if (writer->Cache) {
+	OutputWrite(writer->Cache, chunk->Cache.Buffer, chunk->Cache.Used);
+    }
+    if (writer->N + chunk->EntryCount > writer->Chars) {
+	GrowTables(writer, writer->N + chunk->EntryCount);
+    }
+    first = writer->N;
+    for (i = 0; i < chunk->EntryCount; ++i) {
+	entry = &chunk->Entries[i];
+	bitmap = NULL;
+	glyph = NULL;
+	if (entry->Bitmap >= 0) {
+	    bitmap = (const unsigned char *)(options->Compress ?
+		chunk->Packed.Buffer : chunk->Bitmaps.Buffer) + entry->Bitmap;
+	    if (options->Dedup) {
+		glyph = DedupBitmap(writer, entry, bitmap);
+	    }
+	}
+	writer->WidthTable[writer->N] = entry->Width;
+	writer->EncodingTable[writer->N] = entry->Encoding;
+	writer->BbxTable[writer->N] = entry->Bbx;
+	writer->MetricsTable[writer->N] = entry->Metrics;
+	if (glyph) {			// same bitmap as other character
+	    writer->OffsetTable[writer->N] = glyph->Offset;
+	    writer->Duplicates++;
+	    writer->Saved += entry->Size;
+	    OutputWrite(writer->Source, chunk->Source.Buffer + entry->Start,
+		entry->Dump - entry->Start);
+	    if (!options->Compact && !options->BinaryFile) {
+		OutputString(writer->Source, "//\tsame bitmap as index ");
+		OutputInt(writer->Source, glyph->Index);
+		OutputChar(writer->Source, '\n');
+	    }
+	} else {
+	    writer->OffsetTable[writer->N] = writer->Offset;
+	    writer->Offset += entry->Size;
+	    writer->Raw +=
+		LayoutSize(options->Layout, options->Bpp, entry->Bbx.Width,
+		entry->Bbx.Height);
+	    OutputWrite(writer->Source, chunk->Source.Buffer + entry->Start,
+		entry->End - entry->Start);
+	    if (writer->Binary && bitmap) {
+		OutputWrite(writer->Binary, bitmap, entry->Size);
+	    }
+	    if (options->FontImage && bitmap) {
+		OutputWrite(&writer->Image, bitmap, entry->Size);
+	    }
+	}
+	writer->N++;
+    }
+    //
+    //	Keep preview bitmaps at font size, drawn when all are known
+    //
+    font = writer->Font;
+    size = ((font->Width + 7) / 8) * font->Height;
+    for (i = 0; i < chunk->PreviewCount; ++i) {
+	preview = &chunk->Previews[i];
+	if (writer->PreviewCount == writer->PreviewMax) {
+	    writer->Previews =
+		GrowArenaArray(writer->Arena, writer->Previews,
+		&writer->PreviewMax, sizeof(*writer->Previews));
+	}
+	cell = (unsigned char *)OutputReserve(&writer->Cells, size);
+	bitmap = (const unsigned char *)chunk->Bitmaps.Buffer + preview->Bitmap;
+	if (preview->Width == font->Width && preview->Height == font->Height
+	    && !preview->X && !preview->Y) {
+	    memcpy(cell, bitmap, size);
+	} else {
+	    memset(cell, 0, size);
+	    BlitBitmap(cell, font->Width, font->Height, bitmap,
+		preview->Width, preview->Height, preview->X, preview->Y);
+	}
+	writer->Previews[writer->PreviewCount] = *preview;
+	writer->Previews[writer->PreviewCount].Index += first;
+	writer->Previews[writer->PreviewCount++].Bitmap = writer->Cells.Used;
+	writer->Cells.Used += size;
+    }
+    if (options->Stats) {
+	StatsAdd(&writer->Stats, PhaseWrite, &start);
+    }
+}
+
+///
+///	Initialize output state.
+///
+///	@param writer	output state, its statistics are kept
+///	@param font	font values
+///	@param arena	arena for the tables
+///	@param source	C source output
+///	@param binary	raw bitmap output or NULL
+///	@param cache	cache records output or NULL
+///	@param chars	expected number of characters, 0 unknown
+///
+static void WriterOpen(BdfWriter * writer, const BdfFont * font,
+    Arena * arena, Output * source, Output * binary, Output * cache,
+    int chars)
+{
+    writer->Arena = arena;
+    writer->Font = font;
+    writer->Source = source;
+    writer->Binary = binary;
+    writer->Cache = cache;
+    writer->Chars = 0;
+    writer->N = 0;
+    writer->WidthTable = NULL;
+    writer->EncodingTable = NULL;
+    writer->OffsetTable = NULL;
+    writer->BbxTable = NULL;
+    writer->MetricsTable = NULL;
+    if (chars > 0) {
+	GrowTables(writer, chars);
+    }
+    writer->Offset = 0;
+    writer->Glyphs = NULL;
+    writer->GlyphCount = 0;
+    writer->GlyphMax = 0;
+    OutputOpen(&writer->Unique, NULL);
+    writer->Duplicates = 0;
+    writer->Saved = 0;
+    writer->Raw = 0;
+    writer->Previews = NULL;
+    writer->PreviewCount = 0;
+    writer->PreviewMax = 0;
+    OutputOpen(&writer->Cells, NULL);
+    writer->AtlasRects = NULL;
+    writer->AtlasBoxes = NULL;
+    OutputOpen(&writer->AtlasPixels, NULL);
+    writer->AtlasSize = 0;
+    writer->AtlasPages = 0;
+    OutputOpen(&writer->Image, NULL);
+    if (font->Options->FontImage) {	// header is filled by WriteImage()
+	memset(OutputReserve(&writer->Image, sizeof(BdfImageHeader)), 0,
+	    sizeof(BdfImageHeader));
+	writer->Image.Used = sizeof(BdfImageHeader);
+    }
+}
+
+///
+///	Pack the characters into the pages of --atlas.
+///
+///	The character cells of the preview are downscaled to 8 bit coverage,
+///	with --downscale by its box filter, and cut to the box of their
+///	pixels.  Characters without pixels get an empty box.  The atlas
+///	keeps the characters upright, also with --rotate.
+///
+///	@param writer	output state with all characters
+///
+static void PackAtlas(BdfWriter * writer)
+{
+    const BdfFont *font;
+    const BdfPreview *preview;
+    AtlasRect *rect;
+    BdfAtlasBox *box;
+    unsigned char *gray;
+    int scale;
+    int w;
+    int h;
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    int x;
+    int y;
+    int i;
+
+    font = writer->Font;
+    scale = font->Options->Downscale > 1 ? font->Options->Downscale : 1;
+    w = (font->Width + scale - 1) / scale;
+    h = (font->Height + scale - 1) / scale;
+    writer->AtlasRects = ArenaAlloc(writer->Arena,
+	(writer->N + 1) * sizeof(*writer->AtlasRects));
+    memset(writer->AtlasRects, 0, writer->N * sizeof(*writer->AtlasRects));
+    writer->AtlasBoxes = ArenaAlloc(writer->Arena,
+	(writer->N + 1) * sizeof(*writer->AtlasBoxes));
+    memset(writer->AtlasBoxes, 0, writer->N * sizeof(*writer->AtlasBoxes));
+    gray = ArenaAlloc(writer->Arena, w * h + 1);
+
+    for (i = 0; i < writer->PreviewCount; ++i) {
+	preview = &writer->Previews[i];
+	DownscaleBitmap(gray, (const unsigned char *)writer->Cells.Buffer +
+	    preview->Bitmap, font->Width, font->Height, scale, 255);
+	x0 = w;
+	y0 = h;
+	x1 = -1;
+	y1 = -1;
+	for (y = 0; y < h; ++y) {
+	    for (x = 0; x < w; ++x) {
+		if (gray[y * w + x]) {
+		    x0 = x < x0 ? x : x0;
+		    x1 = x > x1 ? x : x1;
+		    y0 = y < y0 ? y : y0;
+		    y1 = y;
+		}
+	    }
+	}
+	if (x1 < 0) {			// no pixels, f.e. space
+	    continue;
+	}
+	rect = &writer->AtlasRects[preview->Index];
+	box = &writer->AtlasBoxes[preview->Index];
+	rect->Width = x1 - x0 + 1;
+	rect->Height = y1 - y0 + 1;
+	box->Left = x0;
+	box->Top = y0;
+	box->Pixels = writer->AtlasPixels.Used;
+	for (y = y0; y <= y1; ++y) {
+	    OutputWrite(&writer->AtlasPixels, gray + y * w + x0, rect->Width);
+	}
+    }
+    // one pixel between the boxes, that filtering doesn't mix them
+    writer->AtlasPages =
+	AtlasPack(writer->AtlasRects, writer->N, font->Options->AtlasSize, 1,
+	&writer->AtlasSize);
+    if (writer->AtlasPages < 0) {
+	BdfFail(font, "%s: characters larger than atlas size %d",
+	    font->Options->Name, font->Options->AtlasSize);
+    }
+    if (writer->AtlasPages > 0xFF) {
+	BdfFail(font, "%s: atlas needs %d pages, more than 255",
+	    font->Options->Name, writer->AtlasPages);
+    }
+    if (!writer->AtlasPages) {		// at least an empty page
+	writer->AtlasPages = 1;
+    }
+}
+
+///
+///	Write the tables and the font structure after all characters.
+///
+///	@param writer	output state with all characters
+///
+static void WriteTables(BdfWriter * writer)
+{
+    const BdfOptions *options;
+    const BdfFont *font;
+    Output *out;
+    BdfLine line;
+    int width;
+    int height;
+    int scale;
+
+    font = writer->Font;
+    options = font->Options;
+    out = writer->Source;
+    BitmapFooter(out, options);
+    // Output width table for proportional font.
+    WidthTable(out, options, writer->WidthTable, writer->N);
+    // Output offset table for proportional, deduplicated or packed font.
+    if (options->Proportional || options->Dedup || options->Compress) {
+	OffsetTable(out, options, writer->OffsetTable, writer->N);
+    }
+    // Output bounding box table for proportional font.
+    if (options->Proportional) {
+	BbxTable(out, options, writer->BbxTable, writer->N);
+    }
+    // Output encoding table for utf-8 support
+    EncodingTable(out, options, writer->EncodingTable, writer->N);
+    if (options->PageIndex) {
+	PageTable(out, options, writer->EncodingTable, writer->N,
+	    writer->Arena);
+    }
+    if (options->Metrics) {
+	MetricsTable(out, options, writer->MetricsTable, writer->N);
+    }
+    line.KerningPairs = 0;
+    if (options->KerningSize) {
+	line.KerningPairs =
+	    KerningTable(out, options, writer->EncodingTable, writer->N,
+	    writer->Arena);
+    }
+    line.AtlasSize = 0;
+    line.AtlasPages = 0;
+    if (options->Atlas) {
+	PackAtlas(writer);
+	AtlasTable(out, options, writer->AtlasRects, writer->AtlasBoxes,
+	    writer->N);
+	line.AtlasSize = writer->AtlasSize;
+	line.AtlasPages = writer->AtlasPages;
+    }
+
+    scale = options->Downscale > 1 ? options->Downscale : 1;
+    width = (font->Width + scale - 1) / scale;
+    height = (font->Height + scale - 1) / scale;
+    line.Ascent = (font->Ascent + scale / 2) / scale;
+    line.Descent = (font->Descent + scale / 2) / scale;
+    line.Baseline = (font->Height + font->Y + scale / 2) / scale;
+    if (!FitsSize(width) || !FitsSize(height)) {
+	BdfFail(font, "Font size %dx%d larger than %d of font.h", width, height,
+	    UCHAR_MAX);
+    }
+    if (options->Metrics && (!FitsSize(line.Ascent)
+	    || !FitsSize(line.Descent) || !FitsSize(line.Baseline))) {
+	BdfFail(font, "Font ascent %d, descent %d or baseline %d out of range "
+	    "of font.h", line.Ascent, line.Descent, line.Baseline);
+    }
+    if (options->Rotate == 90 || options->Rotate == 270) {
+	Footer(out, options, height, width, writer->N, &line);
+    } else {
+	Footer(out, options, width, height, writer->N, &line);
+    }
+    writer->Line = line;
+}
+
+///
+///	Free output state.  The tables are freed with the arena.
+///
+///	@param writer	output state
+///
+static void WriterClose(BdfWriter * writer)
+{
+    OutputClose(&writer->Image);
+    OutputClose(&writer->AtlasPixels);
+    OutputClose(&writer->Cells);
+    OutputClose(&writer->Unique);
+}
+
+///
+///	Draw preview picture of converted characters.
+///
+///	The grid covers only the encodings of the preview characters.
+///
+///	@param writer	output state with preview characters
+///	@param stream	stream for the picture, NULL writes the preview file
+///
+static void DrawPreview(const BdfWriter * writer, FILE * stream)
+{
+    const BdfFont *font;
+    const BdfPreview *preview;
+    bdf2c_fontpic_t pic;
+    int first;
+    int last;
+    int i;
+
+    font = writer->Font;
+    for (i = 0; i < writer->PreviewCount; ++i) {
+	if (InPreview(font->Options, writer->Previews[i].Encoding)) {
+	    break;
+	}
+    }
+    if (i == writer->PreviewCount) {
+	fprintf(stderr, "No characters for preview '%s'\n",
+	    font->Options->Preview);
+	return;
+    }
+    first = INT_MAX;
+    last = 0;
+    for (i = 0; i < writer->PreviewCount; ++i) {
+	if (!InPreview(font->Options, writer->Previews[i].Encoding)) {
+	    continue;			// only for atlas
+	}
+	if (writer->Previews[i].Encoding < first) {
+	    first = writer->Previews[i].Encoding;
+	}
+	if (writer->Previews[i].Encoding > last) {
+	    last = writer->Previews[i].Encoding;
+	}
+    }
+    memset(&pic, 0, sizeof(pic));
+    if (bdf2c_fontpic_init (&pic, font->Options->Preview, first,
+	    last - first + 1, font->Width, font->Height)) {
+	BdfFail(font, "Can't create preview '%s'", font->Options->Preview);
+    }
+    pic.fp = stream;
+    for (i = 0; i < writer->PreviewCount; ++i) {
+	preview = &writer->Previews[i];
+	if (!InPreview(font->Options, preview->Encoding)) {
+	    continue;
+	}
+	bdf2c_fontpic_add (&pic,
+	    (uint8_t *) writer->Cells.Buffer + preview->Bitmap, font->Width,
+	    font->Height, preview->Encoding, preview->Shifted);
+    }
+    bdf2c_fontpic_clear (&pic);
+}
+
+///
+///	File name of atlas page.  With several pages the page number is
+///	inserted before the extension, f.e. atlas_1.png.
+///
+///	@param arena	arena for the name
+///	@param file	--atlas file name
+///	@param page	page number
+///	@param pages	number of pages
+///
+///	@returns file name in arena.
+///
+static char *AtlasPageName(Arena * arena, const char *file, int page,
+    int pages)
+{
+    const char *ext;
+    char *name;
+    size_t n;
+
+    n = strlen(file) + 16;
+    name = ArenaAlloc(arena, n);
+    if (pages == 1) {
+	strcpy(name, file);
+	return name;
+    }
+    if (!(ext = strrchr(file, '.')) || strchr(ext, '/')) {
+	ext = file + strlen(file);
+    }
+    snprintf(name, n, "%.*s_%d%s", (int)(ext - file), file, page, ext);
+    return name;
+}
+
+///
+///	Write atlas page into sink, as complete picture file.
+///
+///	@param page	atlas page
+///	@param png	true png, false pgm
+///	@param sink	write function of caller
+///
+///	@returns 0 on success, -1 if writing failed.
+///
+static int AtlasPageSink(ppm_cavas_t * page, int png, const Bdf2cSink * sink)
+{
+    char *picture;
+    size_t picture_size;
+    FILE *stream;
+    int ret;
+
+    if (!(stream = open_memstream(&picture, &picture_size))) {
+	return -1;
+    }
+    ret = png ? ppm_cavas_fwrite_png(page, stream, NULL, 0) :
+	ppm_cavas_fwrite_pgm(page, stream);
+    ret |= fclose(stream);
+    if (!ret && picture_size) {
+	ret = sink->Write(sink->User, picture, picture_size);
+    }
+    free(picture);
+    return ret ? -1 : 0;
+}
+
+///
+///	Write the --atlas pages and the --atlas-json description.
+///
+///	The extension of the file name selects the format: .png writes an
+///	8 bit gray png, all others a pgm.  Each pixel is the alpha of the
+///	characters.  Without sinks the pages and json go to their files,
+///	with a sink all pages are written one after another.
+///
+///	@param writer	output state with packed atlas
+///	@param atlas	sink for the atlas pages or NULL
+///	@param json	sink for the json description or NULL
+///
+///	@returns 0 on success, -1 if a sink failed.
+///
+static int WriteAtlas(const BdfWriter * writer, const Bdf2cSink * atlas,
+    const Bdf2cSink * json)
+{
+    const BdfOptions *options;
+    const BdfFont *font;
+    const AtlasRect *rect;
+    ppm_cavas_t *page;
+    const char *ext;
+    char *name;
+    Output out;
+    FILE *f;
+    int scale;
+    int png;
+    int ret;
+    int p;
+    int i;
+    int y;
+
+    font = writer->Font;
+    options = font->Options;
+    if (!(page = ppm_cavas_create(writer->AtlasSize, writer->AtlasSize,
+		PPM_CAVAS_INDEX))) {
+	BdfFail(font, "Out of memory");
+    }
+    ext = strrchr(options->Atlas, '.');
+    png = ext && !strcasecmp(ext, ".png");
+    for (p = 0; p < writer->AtlasPages; ++p) {
+	ppm_cavas_zero(page);
+	for (i = 0; i < writer->N; ++i) {
+	    rect = &writer->AtlasRects[i];
+	    if (rect->Page != p) {
+		continue;
+	    }
+	    for (y = 0; y < rect->Height; ++y) {
+		memcpy(page->buffer + (rect->Y + y) * page->stride + rect->X,
+		    writer->AtlasPixels.Buffer + writer->AtlasBoxes[i].Pixels +
+		    y * rect->Width, rect->Width);
+	    }
+	}
+	if (atlas) {
+	    if (AtlasPageSink(page, png, atlas)) {
+		ppm_cavas_destroy(page);
+		return -1;
+	    }
+	    continue;
+	}
+	name = AtlasPageName(writer->Arena, options->Atlas, p,
+	    writer->AtlasPages);
+	ret = png ? ppm_cavas_write_png(page, name, NULL, 0) :
+	    ppm_cavas_write_pgm(page, name);
+	if (ret) {
+	    ppm_cavas_destroy(page);
+	    BdfFail(font, "Can't write atlas '%s'", name);
+	}
+    }
+    ppm_cavas_destroy(page);
+
+    if (!options->AtlasJson && !json) {
+	return 0;
+    }
+    f = NULL;
+    if (json) {
+	OutputOpenWriter(&out, json->Write, json->User);
+    } else if (!(f = fopen(options->AtlasJson, "w"))) {
+	BdfFail(font, "Can't open file '%s': %s", options->AtlasJson,
+	    strerror(errno));
+    } else {
+	OutputOpen(&out, f);
+    }
+    scale = options->Downscale > 1 ? options->Downscale : 1;
+    OutputString(&out, "{\"font\":");
+    OutputJsonString(&out, options->Name);
+    OutputPrintf(&out, ",\"size\":%d,\"pages\":[", writer->AtlasSize);
+    for (p = 0; p < writer->AtlasPages; ++p) {
+	name = AtlasPageName(writer->Arena, options->Atlas, p,
+	    writer->AtlasPages);
+	if (p) {
+	    OutputChar(&out, ',');
+	}
+	OutputJsonString(&out, name);
+    }
+    OutputPrintf(&out, "],\"width\":%d,\"height\":%d,\"baseline\":%d,"
+	"\"glyphs\":[\n", (font->Width + scale - 1) / scale,
+	(font->Height + scale - 1) / scale,
+	(font->Height + font->Y + scale / 2) / scale);
+    for (i = 0; i < writer->N; ++i) {
+	rect = &writer->AtlasRects[i];
+	OutputPrintf(&out, "{\"encoding\":%u,\"page\":%d,\"x\":%d,\"y\":%d,"
+	    "\"width\":%d,\"height\":%d,\"left\":%d,\"top\":%d,"
+	    "\"advance\":%u,\"uv\":[%.6g,%.6g,%.6g,%.6g]}%s\n",
+	    writer->EncodingTable[i], rect->Page < 0 ? 0 : rect->Page, rect->X,
+	    rect->Y, rect->Width, rect->Height, writer->AtlasBoxes[i].Left,
+	    writer->AtlasBoxes[i].Top, writer->WidthTable[i],
+	    (double)rect->X / writer->AtlasSize,
+	    (double)rect->Y / writer->AtlasSize,
+	    (double)(rect->X + rect->Width) / writer->AtlasSize,
+	    (double)(rect->Y + rect->Height) / writer->AtlasSize,
+	    i + 1 < writer->N ? "," : "");
+    }
+    OutputString(&out, "]}\n");
+    OutputClose(&out);
+    ret = OutputError(&out);
+    if (!f) {
+	return ret ? -1 : 0;
+    }
+    if (ret | fclose(f)) {
+	BdfFail(font, "Can't write file '%s'", options->AtlasJson);
+    }
+    return 0;
+}
+
+///
+///	Store integer into font image, in the byte order of the image target.
+///
+///	@param options	conversion options with image target
+///	@param p	bytes to store into
+///	@param v	integer to store
+///	@param n	bytes of integer
+///
+static void ImagePut(const BdfOptions * options, void *p, uint64_t v, int n)
+{
+    unsigned char *s;
+    int i;
+
+    s = p;
+    for (i = 0; i < n; ++i) {
+	s[options->ImageBigEndian ? n - 1 - i : i] = v >> i * 8;
+    }
+}
+
+///
+///	Store header into font image, in the byte order of the image target.
+///
+///	@param options	conversion options with image target
+///	@param p	start of font image
+///	@param header	header in host byte order
+///
+static void ImageHeaderPut(const BdfOptions * options, unsigned char *p,
+    const BdfImageHeader * header)
+{
+    unsigned char *s;
+    int i;
+
+    memcpy(p, header, sizeof(*header));	// magic and bytes
+    ImagePut(options, p + offsetof(BdfImageHeader, Version), header->Version,
+	2);
+    ImagePut(options, p + offsetof(BdfImageHeader, ByteOrder),
+	header->ByteOrder, 2);
+    ImagePut(options, p + offsetof(BdfImageHeader, Chars), header->Chars, 2);
+    ImagePut(options, p + offsetof(BdfImageHeader, AtlasSize),
+	header->AtlasSize, 2);
+    ImagePut(options, p + offsetof(BdfImageHeader, AtlasPages),
+	header->AtlasPages, 2);
+    ImagePut(options, p + offsetof(BdfImageHeader, KerningPairs),
+	header->KerningPairs, 4);
+    ImagePut(options, p + offsetof(BdfImageHeader, Size), header->Size, 4);
+    for (i = 0; i < SectionMax; ++i) {
+	s = p + offsetof(BdfImageHeader, Sections) +
+	    i * sizeof(header->Sections[0]);
+	ImagePut(options, s, header->Sections[i].Offset, 4);
+	ImagePut(options, s + 4, header->Sections[i].Size, 4);
+    }
+}
+
+///
+///	Start section of font image, aligned to 8 bytes.
+///
+///	@param image	font image
+///	@param header	header of font image
+///	@param section	section number
+///	@param size	bytes of section
+///
+///	@returns zeroed space of section, valid until the next write.
+///
+static void *ImageSection(Output * image, BdfImageHeader * header,
+    enum BdfSection section, size_t size)
+{
+    char *p;
+
+    p = OutputReserve(image, 7 + size);
+    memset(p, 0, 7 + size);
+    image->Used += -image->Used & 7;
+    if (size) {				// missing sections keep offset 0
+	header->Sections[section].Offset = image->Used;
+	header->Sections[section].Size = size;
+    }
+    p = image->Buffer + image->Used;
+    image->Used += size;
+    return p;
+}
+
+///
+///	Write the --font-image file.
+///
+///	The image has the tables of the C source in the memory layout of
+///	font.h, bitmap_font_image_view() uses them in place.  The size of
+///	unsigned long and the byte order are those of the image target,
+///	by default the converting host.
+///
+///	@param writer	output state with all characters and tables
+///	@param sink	sink for the image, NULL writes the file
+///
+///	@returns 0 on success, -1 if the sink failed.
+///
+static int WriteImage(BdfWriter * writer, const Bdf2cSink * sink)
+{
+    const BdfOptions *options;
+    const BdfFont *font;
+    BdfImageHeader header;
+    BdfKerning *pairs;
+    unsigned page_index[256];
+    unsigned *pages;
+    unsigned char *p;
+    int scale;
+    int ret;
+    int n;
+    int i;
+    FILE *f;
+
+    font = writer->Font;
+    options = font->Options;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, "bdf2cimg", sizeof(header.Magic));
+    header.Version = 1;			// BITMAP_FONT_IMAGE_VERSION
+    header.ByteOrder = 0x0102;
+    header.Chars = writer->N;
+    header.LongSize = options->ImageLongSize;
+    scale = options->Downscale > 1 ? options->Downscale : 1;
+    header.Width = (font->Width + scale - 1) / scale;
+    header.Height = (font->Height + scale - 1) / scale;
+    if (options->Rotate == 90 || options->Rotate == 270) {
+	header.Width = (font->Height + scale - 1) / scale;
+	header.Height = (font->Width + scale - 1) / scale;
+    }
+    header.Compressed = options->Compress != 0;
+    header.Layout = options->Layout;
+    header.Bpp = options->Bpp > 1 ? options->Bpp : 0;
+    if (options->Metrics) {
+	header.Ascent = writer->Line.Ascent;
+	header.Descent = writer->Line.Descent;
+	header.Baseline = writer->Line.Baseline;
+    }
+    header.AtlasSize = writer->Line.AtlasSize;
+    header.AtlasPages = writer->Line.AtlasPages;
+
+    // bitmaps were collected after the header
+    header.Sections[SectionBitmap].Offset = sizeof(header);
+    header.Sections[SectionBitmap].Size = writer->Image.Used - sizeof(header);
+    if (!header.Sections[SectionBitmap].Size) {
+	header.Sections[SectionBitmap].Offset = 0;
+    }
+    p = ImageSection(&writer->Image, &header, SectionWidths, writer->N);
+    for (i = 0; i < writer->N; ++i) {
+	p[i] = writer->WidthTable[i];
+    }
+    p = ImageSection(&writer->Image, &header, SectionIndex,
+	writer->N * sizeof(uint16_t));
+    for (i = 0; i < writer->N; ++i) {
+	ImagePut(options, p + i * 2, writer->EncodingTable[i], 2);
+    }
+    if (options->PageIndex) {
+	pages = PageIndex(page_index, writer->EncodingTable, writer->N,
+	    writer->Arena, &n);
+	p = ImageSection(&writer->Image, &header, SectionPageIndex,
+	    256 * sizeof(uint16_t));
+	for (i = 0; i < 256; ++i) {
+	    ImagePut(options, p + i * 2, page_index[i], 2);
+	}
+	p = ImageSection(&writer->Image, &header, SectionPages,
+	    n * 256 * sizeof(uint16_t));
+	for (i = 0; i < n * 256; ++i) {
+	    ImagePut(options, p + i * 2, pages[i], 2);
+	}
+    }
+    if (options->Proportional || options->Dedup || options->Compress) {
+	p = ImageSection(&writer->Image, &header, SectionOffsets,
+	    writer->N * options->ImageLongSize);
+	for (i = 0; i < writer->N; ++i) {
+	    ImagePut(options, p + i * options->ImageLongSize,
+		writer->OffsetTable[i], options->ImageLongSize);
+	}
+    }
+    if (options->Proportional) {
+	p = ImageSection(&writer->Image, &header, SectionBbx, writer->N * 4);
+	for (i = 0; i < writer->N; ++i) {
+	    p[i * 4 + 0] = writer->BbxTable[i].Width;
+	    p[i * 4 + 1] = writer->BbxTable[i].Height;
+	    p[i * 4 + 2] = writer->BbxTable[i].X;
+	    p[i * 4 + 3] = writer->BbxTable[i].Y;
+	}
+    }
+    if (options->Metrics) {
+	p = ImageSection(&writer->Image, &header, SectionMetrics,
+	    writer->N * 5);
+	for (i = 0; i < writer->N; ++i) {
+	    p[i * 5 + 0] = writer->MetricsTable[i].Advance;
+	    p[i * 5 + 1] = writer->MetricsTable[i].Ink.X;
+	    p[i * 5 + 2] = writer->MetricsTable[i].Ink.Y;
+	    p[i * 5 + 3] = writer->MetricsTable[i].Ink.Width;
+	    p[i * 5 + 4] = writer->MetricsTable[i].Ink.Height;
+	}
+    }
+    if (writer->Line.KerningPairs) {	// struct bitmap_kerning has padding
+	n = KerningPairs(options, writer->EncodingTable, writer->N,
+	    writer->Arena, &pairs);
+	header.KerningPairs = n;
+	p = ImageSection(&writer->Image, &header, SectionKerning, n * 6);
+	for (i = 0; i < n; ++i) {
+	    ImagePut(options, p + i * 6, pairs[i].First, 2);
+	    ImagePut(options, p + i * 6 + 2, pairs[i].Second, 2);
+	    p[i * 6 + 4] = pairs[i].Adjust;
+	}
+    }
+    if (writer->Line.AtlasSize) {	// struct bitmap_atlas_glyph too
+	p = ImageSection(&writer->Image, &header, SectionAtlas,
+	    writer->N * 10);
+	for (i = 0; i < writer->N; ++i) {
+	    ImagePut(options, p + i * 10, writer->AtlasRects[i].X, 2);
+	    ImagePut(options, p + i * 10 + 2, writer->AtlasRects[i].Y, 2);
+	    p[i * 10 + 4] = writer->AtlasRects[i].Width;
+	    p[i * 10 + 5] = writer->AtlasRects[i].Height;
+	    p[i * 10 + 6] = writer->AtlasBoxes[i].Left;
+	    p[i * 10 + 7] = writer->AtlasBoxes[i].Top;
+	    p[i * 10 + 8] =
+		writer->AtlasRects[i].Page < 0 ? 0 : writer->AtlasRects[i].Page;
+	}
+    }
+    if (writer->Image.Used > UINT32_MAX) {
+	BdfFail(font, "Font image larger than 4 GiB");
+    }
+    header.Size = writer->Image.Used;
+    ImageHeaderPut(options, (unsigned char *)writer->Image.Buffer, &header);
+
+    if (sink) {
+	return sink->Write(sink->User, writer->Image.Buffer,
+	    writer->Image.Used) ? -1 : 0;
+    }
+    if (!(f = fopen(options->FontImage, "wb"))) {
+	BdfFail(font, "Can't open file '%s': %s", options->FontImage,
+	    strerror(errno));
+    }
+    ret = fwrite(writer->Image.Buffer, 1, writer->Image.Used, f)
+	!= writer->Image.Used;
+    if (fclose(f) | ret) {
+	BdfFail(font, "Can't write file '%s'", options->FontImage);
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Threads
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Threaded conversion pipeline.
+///
+///	The reader (main thread) splits the input into chunks, the workers
+///	convert them and the writer thread writes them in input order.
+///	Chunks in flight are kept in a ring of slots indexed by sequence
+///	number.
+///
+typedef struct _bdf_pipeline_ {
+    const BdfFont *Font;		///< font values
+    BdfWriter *Writer;			///< output state
+
+    pthread_mutex_t Lock;		///< protects all following
+    pthread_cond_t WorkCond;		///< chunk read or end of input
+    pthread_cond_t DoneCond;		///< chunk converted or end of input
+    pthread_cond_t RoomCond;		///< chunk written
+
+    BdfChunk **Slots;			///< chunks in flight
+    unsigned Depth;			///< number of slots
+    unsigned Read;			///< number of chunks read
+    unsigned Claimed;			///< number of chunks taken by workers
+    unsigned Written;			///< number of chunks written
+    int Eof;				///< reader is finished
+} BdfPipeline;
+
+///
+///	Worker thread, converts chunks.
+///
+///	@param arg	pipeline
+///
+static void *WorkerThread(void *arg)
+{
+    BdfPipeline *pipe;
+    BdfChunk *chunk;
+
+    pipe = arg;
+    for (;;) {
+	pthread_mutex_lock(&pipe->Lock);
+	while (pipe->Claimed == pipe->Read && !pipe->Eof) {
+	    pthread_cond_wait(&pipe->WorkCond, &pipe->Lock);
+	}
+	if (pipe->Claimed == pipe->Read) {
+	    pthread_mutex_unlock(&pipe->Lock);
+	    return NULL;
+	}
+	chunk = pipe->Slots[pipe->Claimed++ % pipe->Depth];
+	pthread_mutex_unlock(&pipe->Lock);
+
+	ConvertChunk(pipe->Font, chunk);
+
+	pthread_mutex_lock(&pipe->Lock);
+	chunk->Done = 1;
+	pthread_cond_broadcast(&pipe->DoneCond);
+	pthread_mutex_unlock(&pipe->Lock);
+    }
+}
+
+///
+///	Writer thread, writes converted chunks in input order.
+///
+///	@param arg	pipeline
+///
+static void *WriterThread(void *arg)
+{
+    BdfPipeline *pipe;
+    BdfChunk *chunk;
+
+    pipe = arg;
+    for (;;) {
+	pthread_mutex_lock(&pipe->Lock);
+	for (;;) {
+	    if (pipe->Written < pipe->Read) {
+		chunk = pipe->Slots[pipe->Written % pipe->Depth];
+		if (chunk->Done) {
+		    break;
+		}
+	    } else if (pipe->Eof) {
+		pthread_mutex_unlock(&pipe->Lock);
+		return NULL;
+	    }
+	    pthread_cond_wait(&pipe->DoneCond, &pipe->Lock);
+	}
+	pthread_mutex_unlock(&pipe->Lock);
+
+	WriteChunk(pipe->Writer, chunk);
+
+	pthread_mutex_lock(&pipe->Lock);
+	chunk->Done = 0;
+	pipe->Written++;
+	pthread_cond_signal(&pipe->RoomCond);
+	pthread_mutex_unlock(&pipe->Lock);
+    }
+}
+
+///
+///	Convert all characters with worker threads.
+///
+///	@param splitter	input splitter
+///	@param font	font values
+///	@param writer	output state
+///	@param jobs	number of worker threads
+///
+static void ConvertThreaded(BdfSplitter * splitter, const BdfFont * font,
+    BdfWriter * writer, int jobs)
+{
+    BdfPipeline pipe;
+    pthread_t *workers;
+    pthread_t writer_thread;
+    BdfChunk *chunk;
+    unsigned u;
+    int i;
+
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.Font = font;
+    pipe.Writer = writer;
+    pipe.Depth = jobs * 4;
+    pthread_mutex_init(&pipe.Lock, NULL);
+    pthread_cond_init(&pipe.WorkCond, NULL);
+    pthread_cond_init(&pipe.DoneCond, NULL);
+    pthread_cond_init(&pipe.RoomCond, NULL);
+    if (!(pipe.Slots = calloc(pipe.Depth, sizeof(*pipe.Slots)))
+	|| !(workers = malloc(jobs * sizeof(*workers)))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    for (u = 0; u < pipe.Depth; ++u) {
+	pipe.Slots[u] = ChunkNew(font);
+    }
+
+    for (i = 0; i < jobs; ++i) {
+	if (pthread_create(&workers[i], NULL, WorkerThread, &pipe)) {
+	    fprintf(stderr, "Can't create thread: %s\n", strerror(errno));
+	    exit(-1);
+	}
+    }
+    if (pthread_create(&writer_thread, NULL, WriterThread, &pipe)) {
+	fprintf(stderr, "Can't create thread: %s\n", strerror(errno));
+	exit(-1);
+    }
+
+    for (;;) {
+	pthread_mutex_lock(&pipe.Lock);
+	while (pipe.Read - pipe.Written == pipe.Depth) {
+	    pthread_cond_wait(&pipe.RoomCond, &pipe.Lock);
+	}
+	chunk = pipe.Slots[pipe.Read % pipe.Depth];
+	pthread_mutex_unlock(&pipe.Lock);
+
+	// the slot is free, nobody else touches the chunk
+	if (!ReadChunk(splitter, chunk)) {
+	    break;
+	}
+
+	pthread_mutex_lock(&pipe.Lock);
+	pipe.Read++;
+	pthread_cond_signal(&pipe.WorkCond);
+	pthread_mutex_unlock(&pipe.Lock);
+    }
+    pthread_mutex_lock(&pipe.Lock);
+    pipe.Eof = 1;
+    pthread_cond_broadcast(&pipe.WorkCond);
+    pthread_cond_broadcast(&pipe.DoneCond);
+    pthread_mutex_unlock(&pipe.Lock);
+
+    for (i = 0; i < jobs; ++i) {
+	pthread_join(workers[i], NULL);
+    }
+    pthread_join(writer_thread, NULL);
+
+    for (u = 0; u < pipe.Depth; ++u) {
+	writer->Stats.ArenaPeak += pipe.Slots[u]->Arena.Peak;
+	ChunkDel(pipe.Slots[u]);
+    }
+    free(pipe.Slots);
+    free(workers);
+    pthread_cond_destroy(&pipe.RoomCond);
+    pthread_cond_destroy(&pipe.DoneCond);
+    pthread_cond_destroy(&pipe.WorkCond);
+    pthread_mutex_destroy(&pipe.Lock);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Read font header up to the first character.
+///
+///	@param in	input
+///	@param splitter	input splitter, gets the first STARTCHAR line
+///	@param font	font to fill with metrics
+///
+///	@returns number of characters given by CHARS, 0 without CHARS.
+///
+static int ReadHeader(BdfInput * in, BdfSplitter * splitter, BdfFont * font)
+{
+    const char *line;
+    const char *e;
+    const char *s;
+    size_t len;
+    int fontboundingbox_width;
+    int fontboundingbox_height;
+    int chars;
+
+    fontboundingbox_width = 0;
+    fontboundingbox_height = 0;
+    font->X = 0;
+    font->Y = 0;
+    font->Ascent = INT_MIN;
+    font->Descent = INT_MIN;
+    chars = 0;
+    while ((line = BdfInputLine(in, &e))) {
+	if (!(s = NextToken(&line, e, &len))) {	// empty line
+	    break;
+	}
+	// printf("token:%.*s\n", (int)len, s);
+	switch (Keyword(s, len)) {
+	    case KeywordFontBoundingBox:
+		fontboundingbox_width = NextInt(&line, e);
+		fontboundingbox_height = NextInt(&line, e);
+		font->X = NextInt(&line, e);
+		font->Y = NextInt(&line, e);
+		continue;
+	    case KeywordChars:		// only a hint, can be wrong
+		chars = NextInt(&line, e);
+		continue;
+	    case KeywordFontAscent:
+		font->Ascent = NextInt(&line, e);
+		continue;
+	    case KeywordFontDescent:
+		font->Descent = NextInt(&line, e);
+		continue;
+	    case KeywordStartChar:	// first character for splitter
+		splitter->Line = s;
+		splitter->LineEnd = e;
+		break;
+	    default:
+		continue;
+	}
+	break;
+    }
+    /*
+       printf("%d * %dx%d\n", chars, fontboundingbox_width,
+       fontboundingbox_height);
+     */
+    //
+    //	Some checks.
+    //
+    if (fontboundingbox_width <= 0 || fontboundingbox_height <= 0) {
+	BdfFail(font, "Need to know the character size");
+    }
+    if (fontboundingbox_width > BDF_MAX_SIZE
+	|| fontboundingbox_height > BDF_MAX_SIZE || !InRange(font->X)
+	|| !InRange(font->Y)) {
+	BdfFail(font, "Font bounding box out of range");
+    }
+    if ((font->Ascent != INT_MIN && !InRange(font->Ascent))
+	|| (font->Descent != INT_MIN && !InRange(font->Descent))) {
+	BdfFail(font, "Font ascent or descent out of range");
+    }
+    // Without properties the font bounding box gives the line
+    if (font->Ascent == INT_MIN) {
+	font->Ascent = fontboundingbox_height + font->Y;
+    }
+    if (font->Descent == INT_MIN) {
+	font->Descent = -font->Y;
+    }
+    // Reserve space for outline border
+    font->Width = fontboundingbox_width + font->Options->Outline;
+    font->Height = fontboundingbox_height + font->Options->Outline;
+    return chars;
+}
+
+///
+///	Hash font file and the options changing the decoded characters
+///	(FNV-1a).  The whole input is read into memory.
+///
+///	@param options	conversion options
+///	@param in	input, not yet read
+///
+static uint64_t CacheKey(const BdfOptions * options, BdfInput * in)
+{
+    uint64_t hash;
+    const unsigned char *p;
+    int args[4];
+    size_t i;
+
+    while (BdfInputFill(in)) {		// whole file into buffer
+    }
+    args[0] = options->Outline;
+    args[1] = options->OutlineDiagonal;
+    args[2] = options->Proportional;
+    args[3] = sizeof(BdfCacheChar);
+    hash = 14695981039346656037ULL;
+    p = (const unsigned char *)args;
+    for (i = 0; i < sizeof(args); ++i) {
+	hash = (hash ^ p[i]) * 1099511628211ULL;
+    }
+    p = (const unsigned char *)in->Pos;
+    for (i = 0; i < (size_t)(in->End - in->Pos); ++i) {
+	hash = (hash ^ p[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+///
+///	Map cache file, if it was made from the same font file and options.
+///
+///	@param file	cache file name
+///	@param key	hash of font file and options
+///	@param[out] size	size of mapping
+///
+///	@returns mapped cache file, NULL if there is no usable cache.
+///
+static const char *CacheMap(const char *file, uint64_t key, size_t * size)
+{
+    FILE *f;
+    struct stat st;
+    void *map;
+    BdfCacheHeader header;
+
+    if (!(f = fopen(file, "rb"))) {
+	return NULL;
+    }
+    map = MAP_FAILED;
+    if (!fstat(fileno(f), &st) && st.st_size >= (off_t) sizeof(header)) {
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    }
+    fclose(f);
+    if (map == MAP_FAILED) {
+	return NULL;
+    }
+    memcpy(&header, map, sizeof(header));
+    if (memcmp(header.Magic, CACHE_MAGIC, sizeof(header.Magic))
+	|| header.Key != key || header.Size != sizeof(header)) {
+	munmap(map, st.st_size);
+	return NULL;
+    }
+    *size = st.st_size;
+    return map;
+}
+
+///
+///	Write cache file.  The file is written under a temporary name and
+///	renamed, other runs see the old or the complete new cache.
+///
+///	@param file	cache file name
+///	@param key	hash of font file and options
+///	@param font	font metrics
+///	@param records	character records of all characters
+///
+static void CacheWrite(const char *file, uint64_t key, const BdfFont * font,
+    const Output * records)
+{
+    BdfCacheHeader header;
+    char *tmp;
+    FILE *f;
+    int ok;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, CACHE_MAGIC, sizeof(header.Magic));
+    header.Key = key;
+    header.Width = font->Width;
+    header.Height = font->Height;
+    header.X = font->X;
+    header.Y = font->Y;
+    header.Ascent = font->Ascent;
+    header.Descent = font->Descent;
+    header.Size = sizeof(header);
+
+    if (!(tmp = malloc(strlen(file) + 32))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    sprintf(tmp, "%s.%d", file, (int)getpid());
+    if (!(f = fopen(tmp, "wb"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", tmp, strerror(errno));
+	exit(-1);
+    }
+    ok = fwrite(&header, sizeof(header), 1, f) == 1
+	&& fwrite(records->Buffer, 1, records->Used, f) == records->Used;
+    if (fclose(f) || !ok || rename(tmp, file)) {
+	fprintf(stderr, "Can't write cache file '%s': %s\n", file,
+	    strerror(errno));
+	remove(tmp);
+	exit(-1);
+    }
+    free(tmp);
+}
+
+///
+///	Read BDF font file.
+///
+///	@param options	conversion options
+///	@param bdf	file stream for input (bdf file)
+///	@param fout	file stream for output (C source file)
+///
+void ReadBdf(const BdfOptions * options, FILE * bdf, FILE * fout)
+{
+    BdfInput in;
+    BdfSplitter splitter;
+    BdfFont font;
+    BdfWriter writer;
+    BdfChunk *chunk;
+    Output output;
+    Output binary;
+    Output *out;
+    FILE *fbinary;
+    Output records;
+    BdfCacheHeader header;
+    const char *cache;
+    const char *pos;
+    size_t cache_size;
+    uint64_t key;
+    int chars;
+    BdfClock start;
+    BdfClock phase;
+    struct stat st;
+    size_t written;
+    unsigned writes;
+    Arena arena;
+
+    memset(&writer.Stats, 0, sizeof(writer.Stats));
+    if (options->Stats) {
+	ClockNow(&start);
+    }
+    BdfInputOpen(&in, bdf);
+    memset(&splitter, 0, sizeof(splitter));
+    splitter.Input = &in;
+    splitter.Font = &font;
+    splitter.Stats = options->Stats != 0;
+
+    font.Options = options;
+    font.Cache = 0;
+    font.Fail = NULL;
+    chars = 0;
+    cache = NULL;
+    cache_size = 0;
+    key = 0;
+    if (options->Cache) {
+	key = CacheKey(options, &in);
+	if ((cache = CacheMap(options->Cache, key, &cache_size))) {
+	    memcpy(&header, cache, sizeof(header));
+	    font.Width = header.Width;
+	    font.Height = header.Height;
+	    font.X = header.X;
+	    font.Y = header.Y;
+	    font.Ascent = header.Ascent;
+	    font.Descent = header.Descent;
+	} else {
+	    font.Cache = 1;
+	}
+    }
+    if (!cache) {
+	chars = ReadHeader(&in, &splitter, &font);
+    }
+    if (options->Stats) {
+	StatsAdd(&writer.Stats, PhaseRead, &start);
+    }
+    //
+    //	Allocate tables
+    //
+    ArenaInit(&arena);
+    if (font.Cache) {
+	OutputOpen(&records, NULL);
+    }
+    OutputOpen(&output, fout);
+    out = &output;
+    fbinary = NULL;
+    if (options->BinaryFile) {
+	if (!(fbinary = fopen(options->BinaryFile, "wb"))) {
+	    fprintf(stderr, "Can't open file '%s': %s\n", options->BinaryFile,
+		strerror(errno));
+	    exit(-1);
+	}
+	OutputOpen(&binary, fbinary);
+    }
+    WriterOpen(&writer, &font, &arena, out,
+	options->BinaryFile ? &binary : NULL, font.Cache ? &records : NULL,
+	chars);
+    Header(out, options);
+
+    if (cache) {			// characters from cache file
+	chunk = ChunkNew(&font);
+	pos = cache + sizeof(header);
+	while (CacheChunk(&font, chunk, &pos, cache + cache_size)) {
+	    WriteChunk(&writer, chunk);
+	}
+	writer.Stats.ArenaPeak += chunk->Arena.Peak;
+	ChunkDel(chunk);
+	munmap((void *)cache, cache_size);
+	in.Pos = in.End;		// the key was the whole input
+    } else if (options->Jobs > 1) {
+	ConvertThreaded(&splitter, &font, &writer, options->Jobs);
+    } else {
+	chunk = ChunkNew(&font);
+	while (ReadChunk(&splitter, chunk)) {
+	    ConvertChunk(&font, chunk);
+	    WriteChunk(&writer, chunk);
+	}
+	writer.Stats.ArenaPeak += chunk->Arena.Peak;
+	ChunkDel(chunk);
+    }
+    BdfInputClose(&in);
+    if (options->Stats) {
+	ClockNow(&phase);
+    }
+    written = 0;
+    writes = 0;
+    if (writer.Cache) {
+	CacheWrite(options->Cache, key, &font, writer.Cache);
+	written += sizeof(header) + writer.Cache->Used;
+	writes += 2;
+	OutputClose(writer.Cache);
+    }
+
+    if (options->BinaryFile) {
+	OutputClose(&binary);
+	fclose(fbinary);
+	written += binary.Written;
+	writes += binary.Writes;
+    }
+    WriteTables(&writer);
+    OutputClose(out);
+    written += out->Written;
+    writes += out->Writes;
+    if (options->Stats) {
+	StatsAdd(&writer.Stats, PhaseWrite, &phase);
+	ClockNow(&phase);
+    }
+    if (options->Preview) {
+	DrawPreview(&writer, NULL);
+	// written through stdio, one write per buffer
+	if (options->Stats && !stat(options->Preview, &st)) {
+	    written += st.st_size;
+	    writes += (st.st_size + st.st_blksize - 1) / st.st_blksize;
+	}
+    }
+    if (options->Atlas) {
+	WriteAtlas(&writer, NULL, NULL);
+    }
+    if (options->FontImage) {
+	WriteImage(&writer, NULL);
+    }
+    if (options->Stats) {
+	StatsAdd(&writer.Stats, PhasePreview, &phase);
+    }
+    WriterClose(&writer);
+    writer.Stats.ArenaPeak += arena.Peak;
+    ArenaFree(&arena);			// all tables at once
+
+    if (options->Dedup) {
+	fprintf(stderr, "%s: %d of %d characters share a bitmap, "
+	    "%lu of %lu bitmap bytes saved\n", options->Name, writer.Duplicates,
+	    writer.N, writer.Saved, writer.Offset + writer.Saved);
+    }
+    if (options->Compress) {
+	fprintf(stderr, "%s: bitmaps packed to %lu of %lu bytes (%lu%%)\n",
+	    options->Name, (unsigned long)writer.Offset, writer.Raw,
+	    writer.Raw ? writer.Offset * 100UL / writer.Raw : 100UL);
+    }
+    if (options->Stats) {
+	StatsPrint(options, &writer.Stats, WallNow() - start.Wall,
+	    in.Bytes + cache_size, written, writes);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Library
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Parsed font of the library.
+///
+///	The characters are kept decoded, as records of the binary cache.
+///	Emitting them is the same as a conversion from the cache file.
+///
+struct _bdf2c_font_ {
+    BdfOptions Options;			///< options the characters are decoded with
+    BdfFont Font;			///< font metrics
+    Output Records;			///< cache records of all characters
+};
+
+///
+///	Set default options.
+///
+///	@param[out] options	conversion options to initialize
+///
+void Bdf2cOptionsInit(BdfOptions * options)
+{
+    memset(options, 0, sizeof(*options));
+    options->Name = "font";		// default variable name
+    options->PreviewLast = INT_MAX;
+    options->Jobs = 1;
+    options->AtlasSize = 1024;
+    // font image for this host
+    options->ImageLongSize = sizeof(unsigned long);
+    options->ImageBigEndian = *(const uint16_t *)"\1\2" == 0x0102;
+}
+
+///
+///	Write function appending to a memory buffer.
+///
+///	@param user	Bdf2cBuffer to append to
+///	@param data	bytes to write
+///	@param n	number of bytes
+///
+///	@returns 0 on success, -1 if a fixed buffer is full or out of memory.
+///
+int Bdf2cBufferWrite(void *user, const void *data, size_t n)
+{
+    Bdf2cBuffer *buffer;
+    char *p;
+    size_t size;
+
+    buffer = user;
+    if (buffer->Used + n > buffer->Size) {
+	if (buffer->Fixed) {
+	    return -1;
+	}
+	size = buffer->Size ? buffer->Size * 2 : OUTPUT_BLOCK_SIZE;
+	if (size < buffer->Used + n) {
+	    size = buffer->Used + n;
+	}
+	if (!(p = realloc(buffer->Data, size))) {
+	    return -1;
+	}
+	buffer->Data = p;
+	buffer->Size = size;
+    }
+    memcpy(buffer->Data + buffer->Used, data, n);
+    buffer->Used += n;
+    return 0;
+}
+
+///
+///	Write function dropping the output.
+///
+static int Bdf2cDiscard(void *user, const void *data, size_t n)
+{
+    (void)user;
+    (void)data;
+    (void)n;
+    return 0;
+}
+
+///
+///	Parse font from memory buffer.
+///
+///	All characters are decoded, with the options Outline,
+///	OutlineDiagonal and Proportional.  All other options are given to
+///	Bdf2cEmit().
+///
+///	@param options	conversion options
+///	@param data	bdf font
+///	@param size	size of bdf font
+///	@param[out] error	buffer for error message or NULL
+///	@param error_size	size of error buffer
+///
+///	@returns parsed font, NULL on error in font.
+///
+Bdf2cFont *Bdf2cParse(const BdfOptions * options, const void *data,
+    size_t size, char *error, size_t error_size)
+{
+    Bdf2cFont *volatile font;
+    BdfInput in;
+    BdfSplitter splitter;
+    BdfChunk *volatile chunk;
+    jmp_buf fail;
+
+    if (!(font = calloc(1, sizeof(*font)))) {
+	if (error && error_size) {
+	    snprintf(error, error_size, "Out of memory");
+	}
+	return NULL;
+    }
+    Bdf2cOptionsInit(&font->Options);
+    font->Options.Outline = options->Outline;
+    font->Options.OutlineDiagonal = options->OutlineDiagonal;
+    font->Options.Proportional = options->Proportional;
+    // an empty subset: characters are only decoded into cache records
+    font->Options.Subset = (const unsigned char *)"";
+    font->Options.SubsetSize = 0;
+    font->Font.Options = &font->Options;
+    font->Font.Cache = 1;
+    font->Font.Fail = &fail;
+    font->Font.Error = error;
+    font->Font.ErrorSize = error ? error_size : 0;
+    OutputOpen(&font->Records, NULL);
+
+    chunk = NULL;
+    if (setjmp(fail)) {
+	if (chunk) {
+	    ChunkDel(chunk);
+	}
+	Bdf2cFontFree(font);
+	return NULL;
+    }
+    BdfInputMemory(&in, data, size);
+    memset(&splitter, 0, sizeof(splitter));
+    splitter.Input = &in;
+    splitter.Font = &font->Font;
+    ReadHeader(&in, &splitter, &font->Font);
+
+    chunk = ChunkNew(&font->Font);
+    while (ReadChunk(&splitter, chunk)) {
+	ConvertChunk(&font->Font, chunk);
+	OutputWrite(&font->Records, chunk->Cache.Buffer, chunk->Cache.Used);
+    }
+    ChunkDel(chunk);
+    BdfInputClose(&in);
+
+    font->Font.Cache = 0;
+    font->Font.Fail = NULL;		// jump buffer is gone after return
+    font->Font.Error = NULL;
+    font->Font.ErrorSize = 0;
+    return font;
+}
+
+///
+///	State of Bdf2cEmitSinks().  It is kept in the frame of the caller
+///	of setjmp, so it is still valid after an error in the font.
+///
+typedef struct _bdf_emit_ {
+    BdfOptions Options;			///< options of this emit
+    BdfFont Font;			///< font values with error exit
+    BdfWriter Writer;			///< output state
+    BdfChunk *Chunk;			///< chunk being written or NULL
+    Output Out;				///< C source output
+    Output Raw;				///< raw bitmap output
+    Arena Arena;			///< arena of the tables
+    FILE *Stream;			///< preview picture stream or NULL
+    char *Picture;			///< preview picture of stream
+    size_t PictureSize;			///< size of preview picture
+} BdfEmit;
+
+///
+///	Emit parsed font with the prepared emit state.
+///
+///	@param emit	emit state, options and font are set
+///	@param parsed	font of Bdf2cParse()
+///	@param sinks	output destinations
+///
+///	@returns 0 on success, -1 on error in font or if a sink failed.
+///
+static int EmitFont(BdfEmit * emit, const Bdf2cFont * parsed,
+    const Bdf2cSinks * sinks)
+{
+    const char *pos;
+    jmp_buf fail;
+    int failed;
+
+    emit->Font.Fail = &fail;
+    ArenaInit(&emit->Arena);
+    OutputOpenWriter(&emit->Out, sinks->Source ? sinks->Source->Write :
+	Bdf2cDiscard, sinks->Source ? sinks->Source->User : NULL);
+    OutputOpenWriter(&emit->Raw, sinks->Binary ? sinks->Binary->Write :
+	Bdf2cDiscard, sinks->Binary ? sinks->Binary->User : NULL);
+    memset(&emit->Writer.Stats, 0, sizeof(emit->Writer.Stats));
+    WriterOpen(&emit->Writer, &emit->Font, &emit->Arena, &emit->Out,
+	emit->Options.BinaryFile ? &emit->Raw : NULL, NULL, 0);
+    emit->Chunk = NULL;
+    emit->Stream = NULL;
+    emit->Picture = NULL;
+
+    if (setjmp(fail)) {			// error in font, drop the rest
+	if (emit->Chunk) {
+	    ChunkDel(emit->Chunk);
+	}
+	if (emit->Stream) {
+	    fclose(emit->Stream);
+	    free(emit->Picture);
+	}
+	OutputReset(&emit->Out);
+	OutputClose(&emit->Out);
+	OutputReset(&emit->Raw);
+	OutputClose(&emit->Raw);
+	WriterClose(&emit->Writer);
+	ArenaFree(&emit->Arena);
+	return -1;
+    }
+    Header(&emit->Out, &emit->Options);
+
+    emit->Chunk = ChunkNew(&emit->Font);
+    pos = parsed->Records.Buffer;
+    while (CacheChunk(&emit->Font, emit->Chunk, &pos,
+	    parsed->Records.Buffer + parsed->Records.Used)) {
+	WriteChunk(&emit->Writer, emit->Chunk);
+    }
+    ChunkDel(emit->Chunk);
+    emit->Chunk = NULL;
+    WriteTables(&emit->Writer);
+    OutputClose(&emit->Out);
+    OutputClose(&emit->Raw);
+    failed = OutputError(&emit->Out) || OutputError(&emit->Raw);
+
+    if (sinks->Preview && !failed) {
+	if (!(emit->Stream = open_memstream(&emit->Picture,
+		    &emit->PictureSize))) {
+	    BdfFail(&emit->Font, "Out of memory");
+	}
+	DrawPreview(&emit->Writer, emit->Stream);
+	failed = fclose(emit->Stream) != 0;
+	emit->Stream = NULL;
+	if (!failed && emit->PictureSize) {
+	    failed = sinks->Preview->Write(sinks->Preview->User,
+		emit->Picture, emit->PictureSize) != 0;
+	}
+	free(emit->Picture);
+    }
+    if (emit->Options.Atlas && !failed) {
+	failed = WriteAtlas(&emit->Writer, sinks->Atlas, sinks->AtlasJson);
+    }
+    if (emit->Options.FontImage && !failed) {
+	failed = WriteImage(&emit->Writer, sinks->Image);
+    }
+    WriterClose(&emit->Writer);
+    ArenaFree(&emit->Arena);
+
+    if (failed) {
+	if (emit->Font.ErrorSize) {
+	    snprintf(emit->Font.Error, emit->Font.ErrorSize,
+		"Can't write output of '%s'", emit->Options.Name);
+	}
+	return -1;
+    }
+    return 0;
+}
+
+///
+///	Emit C source, raw bitmap, preview, atlas and image of parsed font.
+///
+///	The options are used like for the command line, only Outline,
+///	OutlineDiagonal and Proportional are taken from Bdf2cParse().
+///	Preview, BinaryFile and Atlas are only file names for the formats
+///	and for the C source, the data goes to the sinks.  Without sink the
+///	Atlas pages, AtlasJson and FontImage are written to their files, an
+///	Image sink also emits the font image without FontImage.  The font
+///	isn't changed, several threads can emit it at once.
+///
+///	@param parsed	font of Bdf2cParse()
+///	@param options	conversion options
+///	@param sinks	output destinations
+///	@param[out] error	buffer for error message or NULL
+///	@param error_size	size of error buffer
+///
+///	@returns 0 on success, -1 on error in font or if a sink failed.
+///
+int Bdf2cEmitSinks(const Bdf2cFont * parsed, const BdfOptions * options,
+    const Bdf2cSinks * sinks, char *error, size_t error_size)
+{
+    BdfEmit emit;
+
+    emit.Options = *options;
+    emit.Options.Outline = parsed->Options.Outline;
+    emit.Options.OutlineDiagonal = parsed->Options.OutlineDiagonal;
+    emit.Options.Proportional = parsed->Options.Proportional;
+    emit.Options.Jobs = 1;
+    emit.Options.Cache = NULL;
+    emit.Options.Stats = 0;
+    emit.Options.Preview = NULL;
+    if (sinks->Preview) {
+	emit.Options.Preview =
+	    options->Preview ? options->Preview : "preview.ppm";
+    }
+    if (sinks->Image && !emit.Options.FontImage) {
+	emit.Options.FontImage = "font.img";	// only the sink is used
+    }
+    emit.Font = parsed->Font;
+    emit.Font.Options = &emit.Options;
+    emit.Font.Error = error;
+    emit.Font.ErrorSize = error ? error_size : 0;
+    return EmitFont(&emit, parsed, sinks);
+}
+
+///
+///	Emit C source, raw bitmap and preview picture of parsed font.
+///	Bdf2cEmitSinks() without atlas and image sinks.
+///
+///	@param parsed	font of Bdf2cParse()
+///	@param options	conversion options
+///	@param source	sink for C source, NULL drops it
+///	@param binary	sink for raw bitmap of BinaryFile or NULL
+///	@param preview	sink for preview picture or NULL
+///	@param[out] error	buffer for error message or NULL
+///	@param error_size	size of error buffer
+///
+///	@returns 0 on success, -1 on error in font or if a sink failed.
+///
+int Bdf2cEmit(const Bdf2cFont * parsed, const BdfOptions * options,
+    const Bdf2cSink * source, const Bdf2cSink * binary,
+    const Bdf2cSink * preview, char *error, size_t error_size)
+{
+    Bdf2cSinks sinks;
+
+    memset(&sinks, 0, sizeof(sinks));
+    sinks.Source = source;
+    sinks.Binary = binary;
+    sinks.Preview = preview;
+    return Bdf2cEmitSinks(parsed, options, &sinks, error, error_size);
+}
+
+///
+///	Free parsed font.
+///
+///	@param font	font of Bdf2cParse() or NULL
+///
+void Bdf2cFontFree(Bdf2cFont * font)
+{
+    if (font) {
+	OutputClose(&font->Records);
+	free(font);
+    }
+}
+
+#ifndef BDF2C_LIBRARY
+
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Print version
+///
+void PrintVersion(void)
+{
+    printf("bdf2c Version %s, (c) 2009, 2010 by Lutz Sammer\n"
+	"\tLicense AGPLv3: GNU Affero General Public License version 3\n",
+	VERSION);
+}
+
+///
+///	Print usage
+///
+void PrintUsage(void)
+{
+    printf("Usage: bdf2c [OPTIONs]\n"
+	"\t-h or -?\tPrints this short page on stdout\n"
+	"\t-b\tRead bdf file from stdin, write to stdout\n"
+	"\t-i file\tRead bdf file, also gzip, xz or zstd compressed\n"
+	"\t-c\tCreate font header on stdout\n"
+	"\t-C file\tCreate font header file\n"
+	"\t-n name\tName of c font variable (place it before -b)\n"
+	"\t-O\tCreate outline for the font.\n"
+	"\t--outline-radius n\tOutline n pixels wide, implies -O\n"
+	"\t--outline-8\tOutline also diagonal neighbours, implies -O\n"
+	"\t-j n\tConvert with n threads, 0 for one per CPU\n"
+	"\t-I or --page-index\tGenerate page table for encoding lookup\n"
+	"\t-P or --proportional\tStore each character at its BBX size\n"
+	"\t-D or --dedup\tStore identical bitmaps only once\n"
+	"\t-z or --compress\tStore bitmaps row-xor and run length packed\n"
+	"\t-x or --compact\tWrite bitmap as dense hex values\n"
+	"\t--incbin file\tWrite raw bitmap to file, include it with .incbin\n"
+	"\t--embed file\tWrite raw bitmap to file, include it with #embed\n"
+	"\t-p file\tWrite preview picture of the font (.ppm, .pbm or .png)\n"
+	"\t--preview-range first-last\tOnly these encodings in preview\n"
+	"\t--range first-last,...\tConvert only these encodings\n"
+	"\t--charset file\tConvert only the characters of UTF-8 file\n"
+	"\t--cache file\tKeep decoded characters in file for next runs\n"
+	"\t--stats[=json]\tPrint phase times and counters on stderr\n"
+	"\t--layout row|row-lsb|page\tBitmap rows msb or lsb first, or pages\n"
+	"\t--rotate 90|180|270\tStore characters rotated clockwise\n"
+	"\t--bpp 1|2|4|8\tStore antialiased characters with n bits per pixel\n"
+	"\t--downscale n\tShrink characters by n with a box filter\n"
+	"\t--metrics\tGenerate advance, bearing and ink box table\n"
+	"\t--kerning file\tGenerate kerning table of pairs in file\n"
+	"\t--atlas file\tWrite texture atlas of characters (.pgm or .png)\n"
+	"\t--atlas-size n\tLargest atlas page size, power of two\n"
+	"\t--atlas-json file\tWrite atlas boxes and metrics as json\n"
+	"\t--font-image file\tWrite font tables as memory mappable file\n"
+	"\t--image-target le32|le64|be32|be64\tByte order and long bits of image\n"
+	"\t--shard n\tOne C file per n encodings, with -o file or -m\n"
+	"\t-m or --manifest file\tConvert fonts listed in file, -j parallel\n");
+    printf("\n\tOnly idiots print usage on stderr\n");
+}
+
+///
+///	Long only options.
+///
+enum LongOption {
+    OptionIncbin = 256,			///< --incbin file
+    OptionEmbed,			///< --embed file
+    OptionPreviewRange,			///< --preview-range first-last
+    OptionOutlineRadius,		///< --outline-radius n
+    OptionOutline8,			///< --outline-8
+    OptionRange,			///< --range ranges
+    OptionCharset,			///< --charset file
+    OptionCache,			///< --cache file
+    OptionStats,			///< --stats[=json]
+    OptionLayout,			///< --layout row|row-lsb|page
+    OptionRotate,			///< --rotate degrees
+    OptionBpp,				///< --bpp bits
+    OptionDownscale,			///< --downscale factor
+    OptionMetrics,			///< --metrics
+    OptionKerning,			///< --kerning file
+    OptionShard,			///< --shard encodings
+    OptionAtlas,			///< --atlas file
+    OptionAtlasSize,			///< --atlas-size pixels
+    OptionAtlasJson,			///< --atlas-json file
+    OptionFontImage,			///< --font-image file
+    OptionImageTarget,			///< --image-target le32|le64|be32|be64
+};
+
+    /// short options
+#define SHORT_OPTIONS "bcC:n:i:o:p:hO?xj:IPDzm:"
+
+    /// long options
+static const struct option LongOptions[] = {
+    {"compact", no_argument, NULL, 'x'},
+    {"jobs", required_argument, NULL, 'j'},
+    {"page-index", no_argument, NULL, 'I'},
+    {"proportional", no_argument, NULL, 'P'},
+    {"dedup", no_argument, NULL, 'D'},
+    {"compress", no_argument, NULL, 'z'},
+    {"manifest", required_argument, NULL, 'm'},
+    {"incbin", required_argument, NULL, OptionIncbin},
+    {"embed", required_argument, NULL, OptionEmbed},
+    {"preview-range", required_argument, NULL, OptionPreviewRange},
+    {"outline-radius", required_argument, NULL, OptionOutlineRadius},
+    {"outline-8", no_argument, NULL, OptionOutline8},
+    {"range", required_argument, NULL, OptionRange},
+    {"charset", required_argument, NULL, OptionCharset},
+    {"cache", required_argument, NULL, OptionCache},
+    {"stats", optional_argument, NULL, OptionStats},
+    {"layout", required_argument, NULL, OptionLayout},
+    {"rotate", required_argument, NULL, OptionRotate},
+    {"bpp", required_argument, NULL, OptionBpp},
+    {"downscale", required_argument, NULL, OptionDownscale},
+    {"metrics", no_argument, NULL, OptionMetrics},
+    {"kerning", required_argument, NULL, OptionKerning},
+    {"shard", required_argument, NULL, OptionShard},
+    {"atlas", required_argument, NULL, OptionAtlas},
+    {"atlas-size", required_argument, NULL, OptionAtlasSize},
+    {"atlas-json", required_argument, NULL, OptionAtlasJson},
+    {"font-image", required_argument, NULL, OptionFontImage},
+    {"image-target", required_argument, NULL, OptionImageTarget},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+};
+
+///
+///	Add encodings to subset.  The bitset is copied, because it can be
+///	shared with the options of other fonts.
+///
+///	@param options	conversion options to change
+///	@param first	first encoding to add
+///	@param last	last encoding to add
+///
+static void SubsetAdd(BdfOptions * options, int first, int last)
+{
+    unsigned char *subset;
+    int size;
+    int i;
+
+    subset = (unsigned char *)options->Subset;
+    size = options->SubsetSize;
+    if (last >= size) {
+	size = (last | 0xFFFF) + 1;	// whole 64k planes
+    }
+    // the bitset of shared options is copied once, then changed in place
+    if (!options->SubsetOwned || size != options->SubsetSize) {
+	if (!(subset = malloc(size / 8))) {
+	    fprintf(stderr, "Out of memory\n");
+	    exit(-1);
+	}
+	memset(subset + options->SubsetSize / 8, 0,
+	    (size - options->SubsetSize) / 8);
+	if (options->Subset) {
+	    memcpy(subset, options->Subset, options->SubsetSize / 8);
+	}
+	if (options->SubsetOwned) {
+	    free((void *)options->Subset);
+	}
+	options->Subset = subset;
+	options->SubsetSize = size;
+	options->SubsetOwned = 1;
+    }
+    for (i = first; i <= last; ++i) {
+	subset[i >> 3] |= 0x80 >> (i & 7);
+    }
+}
+
+///
+///	Parse encoding ranges, f.e. "0x20-0x7E,0xA0-0xFF".
+///
+///	@param options	conversion options to change
+///	@param arg	comma separated list of encodings or ranges
+///
+static void SubsetRange(BdfOptions * options, const char *arg)
+{
+    const char *s;
+    char *end;
+    long first;
+    long last;
+
+    for (s = arg;;) {
+	first = strtol(s, &end, 0);
+	last = first;
+	if (*end == '-') {
+	    last = strtol(end + 1, &end, 0);
+	}
+	if (end == s || (*end && *end != ',') || first < 0 || last < first
+	    || last > 0xFFFFFF) {
+	    fprintf(stderr, "Invalid encoding range '%s'\n", arg);
+	    exit(-1);
+	}
+	SubsetAdd(options, first, last);
+	if (!*end) {
+	    break;
+	}
+	s = end + 1;
+    }
+}
+
+///
+///	Read characters of an UTF-8 text file into subset.  Line ends are
+///	ignored.
+///
+///	@param options	conversion options to change
+///	@param file	UTF-8 text file name
+///
+static void SubsetCharset(BdfOptions * options, const char *file)
+{
+    FILE *f;
+    int c;
+    int n;
+    int code;
+
+    if (!(f = fopen(file, "rb"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", file, strerror(errno));
+	exit(-1);
+    }
+    while ((c = getc(f)) != EOF) {
+	if (c < 0x80) {
+	    if (c == '\n' || c == '\r') {
+		continue;
+	    }
+	    code = c;
+	    n = 0;
+	} else if ((c & 0xE0) == 0xC0) {
+	    code = c & 0x1F;
+	    n = 1;
+	} else if ((c & 0xF0) == 0xE0) {
+	    code = c & 0x0F;
+	    n = 2;
+	} else if ((c & 0xF8) == 0xF0) {
+	    code = c & 0x07;
+	    n = 3;
+	} else {
+	    n = -1;
+	}
+	for (; n > 0; --n) {
+	    if (((c = getc(f)) & 0xC0) != 0x80) {
+		n = -1;
+		break;
+	    }
+	    code = code << 6 | (c & 0x3F);
+	}
+	if (n < 0 || code > 0x10FFFF) {
+	    fprintf(stderr, "Invalid UTF-8 in charset file '%s'\n", file);
+	    exit(-1);
+	}
+	SubsetAdd(options, code, code);
+    }
+    fclose(f);
+}
+
+///
+///	Compare kerning pairs by encodings, for qsort().
+///
+///	@param a	first kerning pair
+///	@param b	second kerning pair
+///
+static int KerningCompare(const void *a, const void *b)
+{
+    const BdfKerning *x;
+    const BdfKerning *y;
+
+    x = a;
+    y = b;
+    if (x->First != y->First) {
+	return x->First < y->First ? -1 : 1;
+    }
+    if (x->Second != y->Second) {
+	return x->Second < y->Second ? -1 : 1;
+    }
+    return 0;
+}
+
+///
+///	Read kerning pairs file.  Each line has the encodings of the left
+///	and right character and the advance change in pixels, f.e. "0x41
+///	0x56 -1" for AV.  Empty lines and text after '#' are ignored.
+///
+///	@param options	conversion options to change
+///	@param file	kerning pairs file name
+///
+static void ReadKerning(BdfOptions * options, const char *file)
+{
+    FILE *f;
+    BdfKerning *pairs;
+    char buf[256];
+    char *s;
+    char *end;
+    long first;
+    long second;
+    long adjust;
+    int max;
+    int n;
+    int i;
+    int lineno;
+
+    if (!(f = fopen(file, "r"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", file, strerror(errno));
+	exit(-1);
+    }
+    pairs = NULL;
+    max = 0;
+    n = 0;
+    lineno = 0;
+    while (fgets(buf, sizeof(buf), f)) {
+	++lineno;
+	if ((s = strchr(buf, '#'))) {
+	    *s = '\0';
+	}
+	s = buf;
+	while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') {
+	    ++s;
+	}
+	if (!*s) {			// empty or comment line
+	    continue;
+	}
+	first = strtol(s, &end, 0);
+	second = strtol(end, &end, 0);
+	adjust = strtol(end, &end, 0);
+	while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') {
+	    ++end;
+	}
+	if (*end || first < 0 || second < 0 || adjust < -128 || adjust > 127) {
+	    fprintf(stderr, "%s:%d: Invalid kerning pair\n", file, lineno);
+	    exit(-1);
+	}
+	if (n == max) {
+	    pairs = GrowArray(pairs, &max, sizeof(*pairs));
+	}
+	pairs[n].First = first;
+	pairs[n].Second = second;
+	pairs[n].Adjust = adjust;
+	n++;
+    }
+    fclose(f);
+    qsort(pairs, n, sizeof(*pairs), KerningCompare);
+    for (i = 1; i < n; ++i) {
+	if (!KerningCompare(&pairs[i - 1], &pairs[i])) {
+	    fprintf(stderr, "%s: Kerning pair 0x%X 0x%X given twice\n", file,
+		pairs[i].First, pairs[i].Second);
+	    exit(-1);
+	}
+    }
+    options->Kerning = pairs;
+    options->KerningSize = n;
+}
+
+///
+///	Set conversion option.
+///
+///	@param options	conversion options to change
+///	@param opt	option character returned by getopt_long
+///	@param arg	option argument
 ///
-void DumpCharacter(FILE * out, unsigned char *bitmap, int width, int height)
+///	@returns false if opt isn't a conversion option.
+///
+static int SetOption(BdfOptions * options, int opt, const char *arg)
 {
-    int x;
-    int y;
-    int c;
+    char *end;
 
-    for (y = 0; y < height; ++y) {
-	fputc('\t', out);
-	for (x = 0; x < width; x += 8) {
-	    c = bitmap[y * ((width + 7) / 8) + x / 8];
-	    //printf("%d = %d\n", y * ((width+7)/8) + x/8, c);
-	    if (c & 0x80) {
-		fputc('X', out);
-	    } else {
-		fputc('_', out);
+    switch (opt) {
+	case 'n':
+	    options->Name = arg;
+	    return 1;
+	case 'p':
+	    options->Preview = arg;
+	    return 1;
+	case 'O':
+	    if (!options->Outline) {
+		options->Outline = 1;
 	    }
-	    if (c & 0x40) {
-		fputc('X', out);
-	    } else {
-		fputc('_', out);
+	    return 1;
+	case OptionOutlineRadius:
+	    options->Outline = strtol(arg, &end, 0);
+	    if (*end || options->Outline < 1 || options->Outline > 64) {
+		fprintf(stderr, "Invalid outline radius '%s'\n", arg);
+		exit(-1);
 	    }
-	    if (c & 0x20) {
-		fputc('X', out);
+	    return 1;
+	case OptionRange:
+	    SubsetRange(options, arg);
+	    return 1;
+	case OptionCache:
+	    options->Cache = arg;
+	    return 1;
+	case OptionStats:
+	    if (!arg || !strcmp(arg, "text")) {
+		options->Stats = STATS_TEXT;
+	    } else if (!strcmp(arg, "json")) {
+		options->Stats = STATS_JSON;
 	    } else {
-		fputc('_', out);
+		fprintf(stderr, "Invalid statistics format '%s'\n", arg);
+		exit(-1);
 	    }
-	    if (c & 0x10) {
-		fputc('X', out);
-	    } else {
-		fputc('_', out);
+	    return 1;
+	case OptionCharset:
+	    SubsetCharset(options, arg);
+	    return 1;
+	case OptionMetrics:
+	    options->Metrics = 1;
+	    return 1;
+	case OptionKerning:
+	    ReadKerning(options, arg);
+	    return 1;
+	case OptionAtlas:
+	    options->Atlas = arg;
+	    return 1;
+	case OptionAtlasSize:
+	    options->AtlasSize = strtol(arg, &end, 0);
+	    if (*end || options->AtlasSize < ATLAS_MIN_SIZE
+		|| options->AtlasSize > 16384
+		|| options->AtlasSize & (options->AtlasSize - 1)) {
+		fprintf(stderr, "Invalid atlas size '%s'\n", arg);
+		exit(-1);
 	    }
-	    if (c & 0x08) {
-		fputc('X', out);
-	    } else {
-		fputc('_', out);
+	    return 1;
+	case OptionAtlasJson:
+	    options->AtlasJson = arg;
+	    return 1;
+	case OptionFontImage:
+	    options->FontImage = arg;
+	    return 1;
+	case OptionImageTarget:
+	    if ((arg[0] != 'l' && arg[0] != 'b') || arg[1] != 'e'
+		|| (strcmp(arg + 2, "32") && strcmp(arg + 2, "64"))) {
+		fprintf(stderr, "Invalid image target '%s'\n", arg);
+		exit(-1);
 	    }
-	    if (c & 0x04) {
-		fputc('X', out);
-	    } else {
-		fputc('_', out);
+	    options->ImageBigEndian = arg[0] == 'b';
+	    options->ImageLongSize = arg[2] == '3' ? 4 : 8;
+	    return 1;
+	case OptionShard:
+	    options->Shard = strtol(arg, &end, 0);
+	    if (*end || options->Shard <= 0 || options->Shard > 0x110000) {
+		fprintf(stderr, "Invalid shard size '%s'\n", arg);
+		exit(-1);
 	    }
-	    if (c & 0x02) {
-		fputc('X', out);
+	    return 1;
+	case OptionLayout:
+	    if (!strcmp(arg, "row")) {
+		options->Layout = LAYOUT_ROWS;
+	    } else if (!strcmp(arg, "row-lsb")) {
+		options->Layout = LAYOUT_ROWS_LSB;
+	    } else if (!strcmp(arg, "page")) {
+		options->Layout = LAYOUT_PAGES;
 	    } else {
-		fputc('_', out);
+		fprintf(stderr, "Invalid bitmap layout '%s'\n", arg);
+		exit(-1);
 	    }
-	    if (c & 0x01) {
-		fputc('X', out);
-	    } else {
-		fputc('_', out);
+	    if (options->Layout == LAYOUT_PAGES && options->Bpp > 1) {
+		fprintf(stderr, "Pages can't store more than 1 bit per pixel\n");
+		exit(-1);
 	    }
-	    fputc(',', out);
-	}
-	fputc('\n', out);
+	    return 1;
+	case OptionRotate:
+	    options->Rotate = strtol(arg, &end, 0);
+	    if (*end || options->Rotate % 90 || options->Rotate < 0
+		|| options->Rotate > 270) {
+		fprintf(stderr, "Invalid rotation '%s'\n", arg);
+		exit(-1);
+	    }
+	    return 1;
+	case OptionBpp:
+	    options->Bpp = strtol(arg, &end, 0);
+	    if (*end || options->Bpp < 1 || options->Bpp > 8
+		|| options->Bpp & (options->Bpp - 1)) {
+		fprintf(stderr, "Invalid bits per pixel '%s'\n", arg);
+		exit(-1);
+	    }
+	    if (options->Layout == LAYOUT_PAGES && options->Bpp > 1) {
+		fprintf(stderr, "Pages can't store more than 1 bit per pixel\n");
+		exit(-1);
+	    }
+	    return 1;
+	case OptionDownscale:
+	    options->Downscale = strtol(arg, &end, 0);
+	    if (*end || options->Downscale < 1 || options->Downscale > 8) {
+		fprintf(stderr, "Invalid downscale factor '%s'\n", arg);
+		exit(-1);
+	    }
+	    return 1;
+	case OptionOutline8:
+	    options->OutlineDiagonal = 1;
+	    if (!options->Outline) {
+		options->Outline = 1;
+	    }
+	    return 1;
+	case 'x':
+	    options->Compact = 1;
+	    return 1;
+	case 'I':
+	    options->PageIndex = 1;
+	    return 1;
+	case 'P':
+	    options->Proportional = 1;
+	    return 1;
+	case 'D':
+	    options->Dedup = 1;
+	    return 1;
+	case 'z':
+	    options->Compress = 1;
+	    return 1;
+	case 'j':
+	    options->Jobs = atoi(arg);
+	    if (options->Jobs <= 0) {
+		options->Jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	    }
+	    return 1;
+	case OptionIncbin:
+	    options->BinaryFile = arg;
+	    options->BinaryEmbed = 0;
+	    return 1;
+	case OptionEmbed:
+	    options->BinaryFile = arg;
+	    options->BinaryEmbed = 1;
+	    return 1;
+	case OptionPreviewRange:
+	    options->PreviewFirst = strtol(arg, &end, 0);
+	    options->PreviewLast = options->PreviewFirst;
+	    if (*end == '-') {
+		options->PreviewLast = strtol(end + 1, &end, 0);
+	    }
+	    if (*end || options->PreviewFirst < 0
+		|| options->PreviewLast < options->PreviewFirst) {
+		fprintf(stderr, "Invalid encoding range '%s'\n", arg);
+		exit(-1);
+	    }
+	    return 1;
     }
+    return 0;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//	Sharded output
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Sharded conversion state.
+///
+typedef struct _bdf_shards_ {
+    const BdfOptions *Options;		///< conversion options
+    Bdf2cFont *Font;			///< parsed font
+    const char *Base;			///< output file name without .c
+    int BaseLength;			///< length of base name
+    unsigned char *Used;		///< shards with characters
+    int Count;				///< number of shards
 
+    pthread_mutex_t Lock;		///< protects Next and Written
+    int Next;				///< next shard to emit
+    int Written;			///< rewritten files
+} BdfShards;
 
 ///
-///	Hex ascii to integer
+///	Write C source file, only if its content changed.
 ///
-///	@param p	hex input character (0-9a-fA-F)
+///	The first line of the file is the hash of the content.  A file
+///	with the same hash and size is left untouched, it keeps its
+///	modification time and make doesn't compile it again.  Otherwise the
+///	file is written under a temporary name and renamed.
 ///
-///	@returns converted integer
+///	@param file	C source file name
+///	@param data	C source
+///	@param size	size of C source
 ///
-static inline int Hex2Int(const char *p)
-{
-    if (*p <= '9') {
-	return *p - '0';
-    } else if (*p <= 'F') {
-	return *p - 'A' + 10;
-    } else {
-	return *p - 'a' + 10;
-    }
-}
-
-extern void RotateBitmap(uint8_t *bitmap, int shift, int width, int height);
-
-#define BITSZ_OF(a) (sizeof (a) * 8)
-void RotateBitmap(uint8_t *bitmap, int shift, int width, int height)
+///	@returns true if the file was written.
+///
+static int ShardWrite(const char *file, const char *data, size_t size)
 {
-    int y;
+    FILE *f;
+    struct stat st;
+    uint64_t hash;
+    char line[64];
+    char old[64];
+    char *tmp;
+    size_t i;
+    int ok;
 
-    if ((shift <= 0) || (shift >= width)) {
-        fprintf(stderr, "Waring: This shift isn't supported: w=%d,h=%d, shift=%2d; ignored!!\n", shift, width, height);
-        return;
+    hash = 14695981039346656037ULL;	// FNV-1a
+    for (i = 0; i < size; ++i) {
+	hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
     }
-#if DEBUG
-    // debug
-    if ((size_t)shift >= BITSZ_OF (uint8_t)) {
-        fprintf(stderr, "Waring: This shift: w=%d,h=%d, shift=%2d\n", width, height, shift);
+    snprintf(line, sizeof(line), "// bdf2c hash %016llx\n",
+	(unsigned long long)hash);
+    if ((f = fopen(file, "rb"))) {
+	ok = fgets(old, sizeof(old), f) && !strcmp(old, line)
+	    && !fstat(fileno(f), &st)
+	    && (size_t)st.st_size == strlen(line) + size;
+	fclose(f);
+	if (ok) {
+	    return 0;
+	}
     }
-#endif
-
-    uint8_t * p0;
-    uint8_t * p1;
-    uint8_t * p2;
-    uint8_t val;
-    size_t byteshift;
-    byteshift = shift % BITSZ_OF (uint8_t);
 
-    for (y = 0; y < height; ++y) {
-        p0 = &bitmap[y * ((width + BITSZ_OF (uint8_t) - 1) / BITSZ_OF (uint8_t))];
-        p2 = p0 + ((width + BITSZ_OF (uint8_t) - 1) / BITSZ_OF (uint8_t)) - 1;
-        p1 = p2 + 1 - ((shift + BITSZ_OF (uint8_t) - 1) / BITSZ_OF (uint8_t));
-#if DEBUG
-if (shift < BITSZ_OF (uint8_t)) {
-    assert (p1 == p2);
-} else if (shift < BITSZ_OF (uint8_t) * 2) {
-    assert (p1 + 1 == p2);
-}
-#endif
-        for (; p2 >= p0; p2 --) {
-            val = 0;
-            if (p1 >= p0) {
-                val = *p1;
-                assert (byteshift < BITSZ_OF (uint8_t));
-                if (byteshift > 0) {
-                    val >>= byteshift;
-                    if (p1 > p0) {
-                        val |= (*(p1-1) << (BITSZ_OF (uint8_t) - byteshift));
-                    }
-                }
-                p1 --;
-            }
-            *p2 = val;
-        }
+    if (!(tmp = malloc(strlen(file) + 32))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    sprintf(tmp, "%s.%d", file, (int)getpid());
+    if (!(f = fopen(tmp, "wb"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", tmp, strerror(errno));
+	exit(-1);
+    }
+    ok = fputs(line, f) >= 0 && fwrite(data, 1, size, f) == size;
+    if (fclose(f) || !ok || rename(tmp, file)) {
+	fprintf(stderr, "Can't write file '%s': %s\n", file, strerror(errno));
+	remove(tmp);
+	exit(-1);
     }
+    free(tmp);
+    return 1;
 }
 
 ///
-///	Outline character.  Create an outline font from normal fonts.
+///	Shard thread, emits shards until all are done.
 ///
-///	@param bitmap	input bitmap
-///	@param width	character width
-///	@param height	character height
+///	@param arg	sharded conversion state
 ///
-void OutlineCharacter(unsigned char *bitmap, int width, int height)
+static void *ShardThread(void *arg)
 {
-    int x;
-    int y;
-    unsigned char *outline;
+    BdfShards *shards;
+    const BdfOptions *options;
+    BdfOptions emit;
+    Bdf2cBuffer source;
+    Bdf2cSink sink;
+    unsigned char *subset;
+    char name[256];
+    char error[256];
+    char *file;
+    int first;
+    int i;
+    int e;
 
-    outline = alloca(((width + 7) / 8) * height);
-    memset(outline, 0, ((width + 7) / 8) * height);
-    for (y = 0; y < height; ++y) {
-	for (x = 0; x < width; ++x) {
-	    // Bit not set check surroundings
-	    if (~bitmap[y * ((width + 7) / 8) + x / 8] & (0x80 >> x % 8)) {
-		// Upper row bit was set
-		if (y
-		    && bitmap[(y - 1) * ((width + 7) / 8) +
-			x / 8] & (0x80 >> x % 8)) {
-		    outline[y * ((width + 7) / 8) + x / 8] |= (0x80 >> x % 8);
-		    // Previous bit was set
-		} else if (x
-		    && bitmap[y * ((width + 7) / 8) + (x -
-			    1) / 8] & (0x80 >> (x - 1) % 8)) {
-		    outline[y * ((width + 7) / 8) + x / 8] |= (0x80 >> x % 8);
-		    // Next bit was set
-		} else if (x < width - 1
-		    && bitmap[y * ((width + 7) / 8) + (x +
-			    1) / 8] & (0x80 >> (x + 1) % 8)) {
-		    outline[y * ((width + 7) / 8) + x / 8] |= (0x80 >> x % 8);
-		    // below row was set
-		} else if (y < height - 1
-		    && bitmap[(y + 1) * ((width + 7) / 8) +
-			x / 8] & (0x80 >> x % 8)) {
-		    outline[y * ((width + 7) / 8) + x / 8] |= (0x80 >> x % 8);
-		}
+    shards = arg;
+    options = shards->Options;
+    if (!(file = malloc(shards->BaseLength + 16))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    for (;;) {
+	pthread_mutex_lock(&shards->Lock);
+	i = shards->Next++;
+	pthread_mutex_unlock(&shards->Lock);
+	if (i >= shards->Count) {
+	    break;
+	}
+	if (!shards->Used[i]) {
+	    continue;
+	}
+	//
+	//	Subset of the encodings of the shard, in the wanted encodings
+	//
+	first = i * options->Shard;
+	if (!(subset = calloc((first + options->Shard + 7) / 8, 1))) {
+	    fprintf(stderr, "Out of memory\n");
+	    exit(-1);
+	}
+	for (e = first; e < first + options->Shard; ++e) {
+	    if (InSubset(options, e)) {
+		subset[e >> 3] |= 0x80 >> (e & 7);
 	    }
 	}
+	emit = *options;
+	snprintf(name, sizeof(name), "%s_%04X", options->Name, first);
+	emit.Name = name;
+	emit.Subset = subset;
+	emit.SubsetSize = first + options->Shard;
+	emit.SubsetOwned = 0;
+
+	memset(&source, 0, sizeof(source));
+	sink.Write = Bdf2cBufferWrite;
+	sink.User = &source;
+	if (Bdf2cEmit(shards->Font, &emit, &sink, NULL, NULL, error,
+		sizeof(error))) {
+	    fprintf(stderr, "%s\n", error);
+	    exit(-1);
+	}
+	sprintf(file, "%.*s_%04X.c", shards->BaseLength, shards->Base, first);
+	if (ShardWrite(file, source.Data, source.Used)) {
+	    pthread_mutex_lock(&shards->Lock);
+	    shards->Written++;
+	    pthread_mutex_unlock(&shards->Lock);
+	}
+	free(source.Data);
+	free(subset);
     }
-    memcpy(bitmap, outline, ((width + 7) / 8) * height);
+    free(file);
+    return NULL;
 }
 
 ///
-///	Read BDF font file.
+///	Convert BDF font file into one C source file for each block of
+///	Shard encodings and a C source with the table of the shards.  Only
+///	changed files are written, see ShardWrite().
 ///
+///	@param options	conversion options
 ///	@param bdf	file stream for input (bdf file)
-///	@param out	file stream for output (C source file)
-///	@param name	font variable name in C source file
-///
-///	@todo bbx isn't used to correct character position in bitmap
+///	@param file	C source file name, the shards get _XXXX.c
 ///
-void ReadBdf(FILE * bdf, FILE * out, const char *name, const char * fnppm)
+static void ShardBdf(const BdfOptions * options, FILE * bdf, const char *file)
 {
-    char linebuf[1024];
-    char *s;
-    char *p;
-    int fontboundingbox_width;
-    int fontboundingbox_height;
-    int chars;
+    BdfShards shards;
+    BdfInput in;
+    BdfCacheChar record;
+    Output out;
+    pthread_t *threads;
+    const char *p;
+    char error[256];
+    int files;
+    int last;
+    int jobs;
     int i;
-    int j;
-    int n;
-    int scanline;
-    char charname[1024];
-    int encoding;
-    int bbx;
-    int bby;
-    int bbw;
-    int bbh;
-    int width;
-    unsigned *width_table;
-    unsigned *encoding_table;
-    unsigned char *bitmap;
 
-    fontboundingbox_width = 0;
-    fontboundingbox_height = 0;
-    chars = 0;
-    for (;;) {
-	if (!fgets(linebuf, sizeof(linebuf), bdf)) {	// EOF
-	    break;
-	}
-	if (!(s = strtok(linebuf, " \t\n\r"))) {	// empty line
-	    break;
-	}
-	// printf("token:%s\n", s);
-	if (!strcasecmp(s, "FONTBOUNDINGBOX")) {
-	    p = strtok(NULL, " \t\n\r");
-	    fontboundingbox_width = atoi(p);
-	    p = strtok(NULL, " \t\n\r");
-	    fontboundingbox_height = atoi(p);
-	} else if (!strcasecmp(s, "CHARS")) {
-	    p = strtok(NULL, " \t\n\r");
-	    chars = atoi(p);
-	    break;
-	}
+    if (options->Preview || options->BinaryFile || options->Cache
+	|| options->Atlas || options->FontImage) {
+	fprintf(stderr, "--shard can't be used with -p, --incbin, --embed, "
+	    "--cache, --atlas or --font-image\n");
+	exit(-1);
     }
-    /*
-       printf("%d * %dx%d\n", chars, fontboundingbox_width,
-       fontboundingbox_height);
-     */
-    bdf2c_fontpic_init (fnppm, chars, fontboundingbox_width, fontboundingbox_height);
+    BdfInputOpen(&in, bdf);
+    while (BdfInputFill(&in)) {		// whole file into buffer
+    }
+    memset(&shards, 0, sizeof(shards));
+    if (!(shards.Font =
+	    Bdf2cParse(options, in.Pos, in.End - in.Pos, error,
+		sizeof(error)))) {
+	fprintf(stderr, "%s\n", error);
+	exit(-1);
+    }
+    in.Pos = in.End;
+    BdfInputClose(&in);
+
     //
-    //	Some checks.
+    //	Find shards with characters, the records are checked by parse
     //
-    if (fontboundingbox_width <= 0 || fontboundingbox_height <= 0) {
-	fprintf(stderr, "Need to know the character size\n");
-	exit(-1);
+    last = -1;
+    for (p = shards.Font->Records.Buffer;
+	p < shards.Font->Records.Buffer + shards.Font->Records.Used;
+	p += sizeof(record) + record.NameLength +
+	((record.Bbx.Width + 7) / 8) * record.Bbx.Height) {
+	memcpy(&record, p, sizeof(record));
+	if (record.Encoding > last) {
+	    last = record.Encoding;
+	}
     }
-    if (chars <= 0) {
-	fprintf(stderr, "Need to know the number of characters\n");
+    shards.Count = last < 0 ? 0 : last / options->Shard + 1;
+    if (!(shards.Used = calloc(shards.Count + 1, 1))) {
+	fprintf(stderr, "Out of memory\n");
 	exit(-1);
     }
-    if (Outline) {			// Reserve space for outline border
-	fontboundingbox_width++;
-	fontboundingbox_height++;
+    for (p = shards.Font->Records.Buffer;
+	p < shards.Font->Records.Buffer + shards.Font->Records.Used;
+	p += sizeof(record) + record.NameLength +
+	((record.Bbx.Width + 7) / 8) * record.Bbx.Height) {
+	memcpy(&record, p, sizeof(record));
+	if (record.Encoding >= 0 && InSubset(options, record.Encoding)) {
+	    shards.Used[record.Encoding / options->Shard] = 1;
+	}
     }
+
     //
-    //	Allocate tables
+    //	Emit shards in parallel
     //
-    width_table = malloc(chars * sizeof(*width_table));
-    if (!width_table) {
-	fprintf(stderr, "Out of memory\n");
-	exit(-1);
+    shards.Options = options;
+    shards.Base = file;
+    shards.BaseLength = strlen(file);
+    if (shards.BaseLength > 2 && !strcmp(file + shards.BaseLength - 2, ".c")) {
+	shards.BaseLength -= 2;
     }
-    encoding_table = malloc(chars * sizeof(*encoding_table));
-    if (!encoding_table) {
+    jobs = options->Jobs < shards.Count ? options->Jobs : shards.Count;
+    if (!(threads = malloc((jobs + 1) * sizeof(*threads)))) {
 	fprintf(stderr, "Out of memory\n");
 	exit(-1);
     }
-    /*	FIXME: needed for proportional fonts.
-       offset_table = malloc(chars * sizeof(*offset_table));
-       if (!offset_table) {
-       fprintf(stderr, "Out of memory\n");
-       exit(-1);
-       }
-     */
-    bitmap =
-	malloc(((fontboundingbox_width + 7) / 8) * fontboundingbox_height);
-    if (!bitmap) {
-	fprintf(stderr, "Out of memory\n");
-	exit(-1);
+    pthread_mutex_init(&shards.Lock, NULL);
+    for (i = 0; i < jobs; ++i) {
+	if (pthread_create(&threads[i], NULL, ShardThread, &shards)) {
+	    fprintf(stderr, "Can't create thread\n");
+	    exit(-1);
+	}
     }
+    for (i = 0; i < jobs; ++i) {
+	pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&shards.Lock);
+    free(threads);
 
-    Header(out, name);
-
-    scanline = -1;
-    n = 0;
-    encoding = -1;
-    bbx = 0;
-    bby = 0;
-    bbw = 0;
-    bbh = 0;
-    width = INT_MIN;
-    strcpy(charname, "unknown character");
-    for (;;) {
-	if (!fgets(linebuf, sizeof(linebuf), bdf)) {	// EOF
-	    break;
+    //
+    //	Table of the shards
+    //
+    OutputOpen(&out, NULL);
+    OutputPrintf(&out,
+	"// Created from bdf2c Version %s, (c) 2009, 2010 by Lutz Sammer\n"
+	"//\tLicense AGPLv3: GNU Affero General Public License version 3\n"
+	"\n#include \"font.h\"\n\n", VERSION);
+    files = 1;
+    for (i = 0; i < shards.Count; ++i) {
+	if (shards.Used[i]) {
+	    OutputPrintf(&out, "extern const struct bitmap_font %s_%04X;\n",
+		options->Name, i * options->Shard);
+	    files++;
 	}
-	if (!(s = strtok(linebuf, " \t\n\r"))) {	// empty line
-	    break;
+    }
+    OutputPrintf(&out,
+	"\n\t/// font of each shard, NULL without characters\n"
+	"static const struct bitmap_font *const __%s_shards__[] = {\n",
+	options->Name);
+    for (i = 0; i < shards.Count; ++i) {
+	if (shards.Used[i]) {
+	    OutputPrintf(&out, "\t&%s_%04X,\n", options->Name,
+		i * options->Shard);
+	} else {
+	    OutputString(&out, "\t0,\n");
 	}
-	// printf("token:%s\n", s);
-	if (!strcasecmp(s, "STARTCHAR")) {
-	    p = strtok(NULL, " \t\n\r");
-	    strcpy(charname, p);
-	} else if (!strcasecmp(s, "ENCODING")) {
-	    p = strtok(NULL, " \t\n\r");
-	    encoding = atoi(p);
-	} else if (!strcasecmp(s, "DWIDTH")) {
-	    p = strtok(NULL, " \t\n\r");
-	    width = atoi(p);
-	} else if (!strcasecmp(s, "BBX")) {
-	    p = strtok(NULL, " \t\n\r");
-	    bbw = atoi(p);
-	    p = strtok(NULL, " \t\n\r");
-	    bbh = atoi(p);
-	    p = strtok(NULL, " \t\n\r");
-	    bbx = atoi(p);
-	    p = strtok(NULL, " \t\n\r");
-	    bby = atoi(p);
-	} else if (!strcasecmp(s, "BITMAP")) {
-	    fprintf(out, "// %3d $%02x '%s'\n", encoding, encoding, charname);
-	    fprintf(out, "//\twidth %d, bbx %d, bby %d, bbw %d, bbh %d\n",
-		width, bbx, bby, bbw, bbh);
-
-	    if (n == chars) {
-		fprintf(stderr, "Too many bitmaps for characters\n");
+    }
+    if (!shards.Count) {		// no empty initializer
+	OutputString(&out, "\t0,\n");
+    }
+    OutputPrintf(&out,
+	"};\n\n" "\t/// sharded bitmap font structure\n"
+	"const struct bitmap_font_shards %s = {\n"
+	"\t.Size = %d, .Count = %d,\n" "\t.Fonts = __%s_shards__,\n" "};\n",
+	options->Name, options->Shard, shards.Count, options->Name);
+    if (ShardWrite(file, out.Buffer, out.Used)) {
+	shards.Written++;
+    }
+    OutputClose(&out);
+
+    fprintf(stderr, "%s: %d of %d files written\n", options->Name,
+	shards.Written, files);
+    free(shards.Used);
+    Bdf2cFontFree(shards.Font);
+}
+
+///
+///	One font of the batch manifest.
+///
+typedef struct _bdf_batch_font_ {
+    BdfOptions Options;			///< conversion options
+    const char *Input;			///< bdf file name
+    const char *Output;			///< C source file name
+    char *Line;				///< manifest line, holds the arguments
+} BdfBatchFont;
+
+///
+///	Batch conversion state.
+///
+typedef struct _bdf_batch_ {
+    BdfBatchFont *Fonts;		///< fonts to convert
+    int FontCount;			///< number of fonts
+    int FontMax;			///< allocated fonts
+
+    pthread_mutex_t Lock;		///< protects Next
+    int Next;				///< next font to convert
+} BdfBatch;
+
+///
+///	Read batch manifest.
+///
+///	Each line names a bdf file and the C source file to create,
+///	followed by conversion options.  Empty lines and lines starting
+///	with '#' are ignored.
+///
+///	@param batch	batch state to fill
+///	@param base	options from command line
+///	@param file	manifest file name
+///
+static void ReadManifest(BdfBatch * batch, const BdfOptions * base,
+    const char *file)
+{
+    FILE *manifest;
+    BdfBatchFont *font;
+    char buf[4096];
+    char *args[64];
+    char *line;
+    char *s;
+    size_t n;
+    int argc;
+    int lineno;
+    int opt;
+    int i;
+
+    if (!(manifest = fopen(file, "r"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", file, strerror(errno));
+	exit(-1);
+    }
+    lineno = 0;
+    while (fgets(buf, sizeof(buf), manifest)) {
+	++lineno;
+	//
+	//	Split line into arguments, kept for the option values.
+	//
+	n = strlen(buf) + 1;
+	args[0] = "bdf2c";
+	argc = 1;
+	for (s = strtok(buf, " \t\r\n"); s && *s != '#';
+	    s = strtok(NULL, " \t\r\n")) {
+	    if (argc == 63) {
+		fprintf(stderr, "%s:%d: Too many arguments\n", file, lineno);
 		exit(-1);
 	    }
-	    if (width == INT_MIN) {
-		fprintf(stderr, "character width not specified\n");
+	    args[argc++] = s;
+	}
+	args[argc] = NULL;
+	if (argc == 1) {		// empty or comment line
+	    continue;
+	}
+	if (!(line = malloc(n))) {
+	    fprintf(stderr, "Out of memory\n");
+	    exit(-1);
+	}
+	memcpy(line, buf, n);
+	for (i = 1; i < argc; ++i) {
+	    args[i] = line + (args[i] - buf);
+	}
+
+	if (batch->FontCount == batch->FontMax) {
+	    batch->Fonts =
+		GrowArray(batch->Fonts, &batch->FontMax,
+		sizeof(*batch->Fonts));
+	}
+	font = &batch->Fonts[batch->FontCount++];
+	font->Line = line;
+	font->Options = *base;
+	font->Options.Preview = NULL;	// each font needs its own file
+	font->Options.Atlas = NULL;
+	font->Options.AtlasJson = NULL;
+	font->Options.FontImage = NULL;
+	font->Options.Cache = NULL;
+	font->Options.Jobs = 1;		// fonts are converted in parallel
+	font->Options.SubsetOwned = 0;	// the subset of base is shared
+#ifdef __GLIBC__
+	optind = 0;			// glibc resets also its own state
+#else
+	optind = 1;
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) \
+    || defined(__OpenBSD__)
+	optreset = 1;
+#endif
+#endif
+	while ((opt = getopt_long(argc, args, SHORT_OPTIONS, LongOptions,
+		    NULL)) != EOF) {
+	    if (!SetOption(&font->Options, opt, optarg)) {
+		fprintf(stderr, "%s:%d: Option not allowed in manifest\n",
+		    file, lineno);
 		exit(-1);
 	    }
-	    //
-	    //	Adjust width based on bounding box
-	    //
-	    if (bbx < 0) {
-		width -= bbx;
-		bbx = 0;
-	    }
-	    if (bbx + bbw > width) {
-		width = bbx + bbw;
-	    }
-	    if (Outline) {		// Reserve space for outline border
-		++width;
-	    }
-	    width_table[n] = width;
-	    encoding_table[n] = encoding;
-	    ++n;
-	    if (Outline) {		// Leave first row empty
-		scanline = 1;
-	    } else {
-		scanline = 0;
-	    }
-	    memset(bitmap, 0,
-		((fontboundingbox_width + 7) / 8) * fontboundingbox_height);
-	} else if (!strcasecmp(s, "ENDCHAR")) {
-        char flag_shifted = 0;
-	    if (bbx) {
-            flag_shifted = 1;
-		RotateBitmap(bitmap, bbx, fontboundingbox_width,
-		    fontboundingbox_height);
-	    }
-	    if (Outline) {
-		RotateBitmap(bitmap, 1, fontboundingbox_width,
-		    fontboundingbox_height);
-		OutlineCharacter(bitmap, fontboundingbox_width,
-		    fontboundingbox_height);
-	    }
-
-	    bdf2c_fontpic_add (bitmap, fontboundingbox_width, fontboundingbox_height, encoding, flag_shifted);
-	    DumpCharacter(out, bitmap, fontboundingbox_width,
-		fontboundingbox_height);
-	    scanline = -1;
-	    width = INT_MIN;
-	} else {
-	    if (scanline >= 0) {
-		p = s;
-		j = 0;
-		while (*p) {
-		    i = Hex2Int(p);
-		    ++p;
-		    if (*p) {
-			i = Hex2Int(p) | i * 16;
-		    } else {
-			bitmap[j + scanline * ((fontboundingbox_width +
-				    7) / 8)] = i;
-			break;
-		    }
-		    /* printf("%d = %d\n", 
-		       j + scanline * ((fontboundingbox_width + 7)/8), i); */
-		    bitmap[j + scanline * ((fontboundingbox_width + 7) / 8)] =
-			i;
-		    ++j;
-		    ++p;
-		}
-		++scanline;
-	    }
 	}
+	if (argc - optind != 2) {
+	    fprintf(stderr, "%s:%d: Need bdf file and C source file\n", file,
+		lineno);
+	    exit(-1);
+	}
+	if (font->Options.AtlasJson && !font->Options.Atlas) {
+	    fprintf(stderr, "%s:%d: --atlas-json needs --atlas file\n", file,
+		lineno);
+	    exit(-1);
+	}
+	font->Input = args[optind];
+	font->Output = args[optind + 1];
     }
-
-    // Output width table for proportional font.
-    WidthTable(out, name, width_table, chars);
-    // FIXME: Output offset table for proportional font.
-    // OffsetTable(out, name, offset_table, chars);
-    // Output encoding table for utf-8 support
-    EncodingTable(out, name, encoding_table, chars);
-
-    Footer(out, name, fontboundingbox_width, fontboundingbox_height, chars);
-    bdf2c_fontpic_clear ();
+    fclose(manifest);
 }
 
-//////////////////////////////////////////////////////////////////////////////
-
 ///
-///	Print version
+///	Batch conversion thread.
 ///
-void PrintVersion(void)
+///	@param arg	batch state
+///
+static void *BatchThread(void *arg)
 {
-    printf("bdf2c Version %s, (c) 2009, 2010 by Lutz Sammer\n"
-	"\tLicense AGPLv3: GNU Affero General Public License version 3\n",
-	VERSION);
+    BdfBatch *batch;
+    const BdfBatchFont *font;
+    ZRead zread;
+    FILE *file;
+    FILE *in;
+    FILE *out;
+    int i;
+
+    batch = arg;
+    for (;;) {
+	pthread_mutex_lock(&batch->Lock);
+	i = batch->Next++;
+	pthread_mutex_unlock(&batch->Lock);
+	if (i >= batch->FontCount) {
+	    return NULL;
+	}
+	font = &batch->Fonts[i];
+	if (!(file = fopen(font->Input, "rb"))) {
+	    fprintf(stderr, "Can't open file '%s': %s\n", font->Input,
+		strerror(errno));
+	    exit(-1);
+	}
+	in = ZReadOpen(&zread, file, font->Input);
+	if (font->Options.Shard) {	// writes only changed files
+	    ShardBdf(&font->Options, in, font->Output);
+	    ZReadClose(&zread);
+	    fclose(file);
+	    continue;
+	}
+	if (!(out = fopen(font->Output, "wb"))) {
+	    fprintf(stderr, "Can't open file '%s': %s\n", font->Output,
+		strerror(errno));
+	    exit(-1);
+	}
+	ReadBdf(&font->Options, in, out);
+	fclose(out);
+	ZReadClose(&zread);
+	fclose(file);
+    }
 }
 
 ///
-///	Print usage
+///	Convert all fonts of a manifest.
 ///
-void PrintUsage(void)
+///	@param options	options from command line, -j sets the number of
+///			fonts converted in parallel
+///	@param file	manifest file name
+///
+static void ConvertBatch(const BdfOptions * options, const char *file)
 {
-    printf("Usage: bdf2c [OPTIONs]\n"
-	"\t-h or -?\tPrints this short page on stdout\n"
-	"\t-b\tRead bdf file from stdin, write to stdout\n"
-	"\t-c\tCreate font header on stdout\n"
-	"\t-C file\tCreate font header file\n"
-	"\t-n name\tName of c font variable (place it before -b)\n"
-	"\t-O\tCreate outline for the font.\n");
-    printf("\n\tOnly idiots print usage on stderr\n");
+    BdfBatch batch;
+    pthread_t *threads;
+    int jobs;
+    int i;
+
+    memset(&batch, 0, sizeof(batch));
+    ReadManifest(&batch, options, file);
+
+    jobs = options->Jobs < batch.FontCount ? options->Jobs : batch.FontCount;
+    if (!(threads = malloc(jobs * sizeof(*threads)))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    pthread_mutex_init(&batch.Lock, NULL);
+    for (i = 0; i < jobs; ++i) {
+	if (pthread_create(&threads[i], NULL, BatchThread, &batch)) {
+	    fprintf(stderr, "Can't create thread\n");
+	    exit(-1);
+	}
+    }
+    for (i = 0; i < jobs; ++i) {
+	pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&batch.Lock);
+    free(threads);
+    for (i = 0; i < batch.FontCount; ++i) {
+	if (batch.Fonts[i].Options.SubsetOwned) {
+	    free((void *)batch.Fonts[i].Options.Subset);
+	}
+	free(batch.Fonts[i].Line);
+    }
+    free(batch.Fonts);
 }
 
 ///
@@ -659,28 +6200,48 @@ void PrintUsage(void)
 ///
 int main(int argc, char *const argv[])
 {
-    const char *name;
-    const char *fnppm = "out.ppm";
+    BdfOptions options;
+    const char *manifest = NULL;
+    const char *output = NULL;
+    const char *input = "stdin";
+    ZRead zread;
     FILE * fout = stdout;
     FILE * fin = stdin;
+    FILE * in;
+    int opt;
 
-    name = "font";			// default variable name
+    Bdf2cOptionsInit(&options);
     //
     //	Parse arguments.
     //
     for (;;) {
-	switch (getopt(argc, argv, "bcC:n:i:o:p:hO?-")) {
+	opt = getopt_long(argc, argv, SHORT_OPTIONS, LongOptions, NULL);
+	if (SetOption(&options, opt, optarg)) {
+	    continue;
+	}
+	switch (opt) {
 	    case 'b':			// bdf file name
-		ReadBdf(stdin, stdout, name, fnppm);
+		if (options.Shard) {
+		    fprintf(stderr, "--shard needs -o file\n");
+		    exit(-1);
+		}
+		in = ZReadOpen(&zread, stdin, "stdin");
+		ReadBdf(&options, in, stdout);
+		ZReadClose(&zread);
 		continue;
 	    case 'i':
-		fin = fopen(optarg, "rb");
+		if (!(fin = fopen(optarg, "rb"))) {
+		    fprintf(stderr, "Can't open file '%s': %s\n", optarg,
+			strerror(errno));
+		    exit(-1);
+		}
+		input = optarg;
 		continue;
 	    case 'o':
-		fout = fopen(optarg, "wb");
+		output = optarg;
 		continue;
-	    case 'p':
-		fnppm = optarg;
+	    case 'm':			// convert fonts of manifest
+		manifest = optarg;
 		continue;
 	    case 'c':			// create header file
 		CreateFontHeaderFile(stdout);
@@ -698,12 +6259,6 @@ int main(int argc, char *const argv[])
 		fclose(out);
 	    }
 		continue;
-	    case 'n':
-		name = optarg;
-		continue;
-	    case 'O':
-		Outline = 1;
-		continue;
 
 	    case EOF:
 		break;
@@ -712,10 +6267,6 @@ int main(int argc, char *const argv[])
 		PrintVersion();
 		PrintUsage();
 		exit(0);
-	    case '-':
-		fprintf(stderr, "We need no long options\n");
-		PrintUsage();
-		exit(-1);
 	    case ':':
 		PrintVersion();
 		fprintf(stderr, "Missing argument for option '%c'\n", optopt);
@@ -730,7 +6281,35 @@ int main(int argc, char *const argv[])
     while (optind < argc) {
 	fprintf(stderr, "Unhandled argument '%s'\n", argv[optind++]);
     }
+    if (options.AtlasJson && !options.Atlas) {
+	fprintf(stderr, "--atlas-json needs --atlas file\n");
+	exit(-1);
+    }
 
-    ReadBdf(fin, fout, name, fnppm);
+    if (manifest) {
+	ConvertBatch(&options, manifest);
+    } else if (options.Shard) {
+	if (!output) {
+	    fprintf(stderr, "--shard needs -o file\n");
+	    exit(-1);
+	}
+	in = ZReadOpen(&zread, fin, input);
+	ShardBdf(&options, in, output);
+	ZReadClose(&zread);
+    } else {
+	if (output && !(fout = fopen(output, "wb"))) {
+	    fprintf(stderr, "Can't open file '%s': %s\n", output,
+		strerror(errno));
+	    exit(-1);
+	}
+	in = ZReadOpen(&zread, fin, input);
+	ReadBdf(&options, in, fout);
+	ZReadClose(&zread);
+    }
+    if (options.SubsetOwned) {
+	free((void *)options.Subset);
+    }
     return 0;
 }
+
+#endif // BDF2C_LIBRARY
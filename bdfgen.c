@@ -0,0 +1,203 @@
+///
+///	@file bdfgen.c		@brief synthetic BDF font generator
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup bdfgen Synthetic font generator
+///
+///	Writes a BDF font with random character bitmaps to stdout, as
+///	input for the benchmark.  The same seed gives the same font.
+///
+/// @{
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+
+static uint64_t Seed = 88172645463325252ULL;	///< random generator state
+
+///
+///	Random number (xorshift64).
+///
+static unsigned Random(void)
+{
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 7;
+    Seed ^= Seed << 17;
+    return Seed >> 32;
+}
+
+///
+///	Random number in range.
+///
+///	@param first	smallest value
+///	@param last	largest value
+///
+static int RandomRange(int first, int last)
+{
+    if (last <= first) {
+	return first;
+    }
+    return first + Random() % (last - first + 1);
+}
+
+///
+///	Write one character.
+///
+///	@param encoding		character encoding
+///	@param width		font bounding box width
+///	@param height		font bounding box height
+///	@param offset		largest bbx x offset
+///	@param proportional	true random character sizes
+///
+static void WriteCharacter(int encoding, int width, int height, int offset,
+    int proportional)
+{
+    int bbw;
+    int bbh;
+    int bbx;
+    int bby;
+    int x;
+    int y;
+    int n;
+    int v;
+
+    if (proportional) {
+	bbw = RandomRange(1, width);
+	bbh = RandomRange(1, height);
+	bbx = RandomRange(-offset, offset);
+	bby = RandomRange(-height / 4, height - bbh - height / 4);
+    } else {
+	bbx = RandomRange(0, offset < width ? offset : width - 1);
+	bbw = width - bbx;
+	bbh = height;
+	bby = -height / 4;
+    }
+    printf("STARTCHAR U+%04X\n", encoding);
+    printf("ENCODING %d\n", encoding);
+    printf("SWIDTH %d 0\n", (bbw + bbx) * 1000 / height);
+    printf("DWIDTH %d 0\n", bbw + (bbx > 0 ? bbx : 0));
+    printf("BBX %d %d %d %d\n", bbw, bbh, bbx, bby);
+    printf("BITMAP\n");
+    n = (bbw + 7) / 8;
+    for (y = 0; y < bbh; ++y) {
+	for (x = 0; x < n; ++x) {
+	    v = Random() & Random() & 0xFF;	// about one of four pixels
+	    if (x == n - 1 && bbw % 8) {	// no pixels after bbw
+		v &= 0xFF00 >> (bbw % 8);
+	    }
+	    printf("%02X", v);
+	}
+	printf("\n");
+    }
+    printf("ENDCHAR\n");
+}
+
+///
+///	Print usage.
+///
+static void PrintUsage(void)
+{
+    printf("Usage: bdfgen [OPTIONs] > font.bdf\n"
+	"\t-n count\tNumber of characters (10000)\n"
+	"\t-f encoding\tFirst encoding (32)\n"
+	"\t-w width\tFont bounding box width (16)\n"
+	"\t-h height\tFont bounding box height (16)\n"
+	"\t-x offset\tLargest bbx x offset (0)\n"
+	"\t-P\tRandom proportional character sizes\n"
+	"\t-s seed\tRandom seed\n");
+}
+
+///
+///	Main entry point.
+///
+int main(int argc, char *const argv[])
+{
+    int count;
+    int first;
+    int width;
+    int height;
+    int offset;
+    int proportional;
+    int i;
+
+    count = 10000;
+    first = 32;
+    width = 16;
+    height = 16;
+    offset = 0;
+    proportional = 0;
+    for (;;) {
+	switch (getopt(argc, argv, "n:f:w:h:x:Ps:?")) {
+	    case 'n':
+		count = atoi(optarg);
+		continue;
+	    case 'f':
+		first = strtol(optarg, NULL, 0);
+		continue;
+	    case 'w':
+		width = atoi(optarg);
+		continue;
+	    case 'h':
+		height = atoi(optarg);
+		continue;
+	    case 'x':
+		offset = atoi(optarg);
+		continue;
+	    case 'P':
+		proportional = 1;
+		continue;
+	    case 's':
+		Seed = strtoull(optarg, NULL, 0) | 1;
+		continue;
+	    case -1:
+		break;
+	    default:
+		PrintUsage();
+		return 0;
+	}
+	break;
+    }
+    if (count < 0 || width <= 0 || height <= 0 || offset < 0) {
+	fprintf(stderr, "Invalid font size\n");
+	return -1;
+    }
+
+    printf("STARTFONT 2.1\n");
+    printf("FONT -bdfgen-synthetic-medium-r-normal--%d-%d-75-75-c-%d-iso10646-1\n",
+	height, height * 10, width * 10);
+    printf("SIZE %d 75 75\n", height);
+    printf("FONTBOUNDINGBOX %d %d %d %d\n", width + (proportional ? offset :
+	    0), height, proportional ? -offset : 0, -height / 4);
+    printf("STARTPROPERTIES 2\n");
+    printf("FONT_ASCENT %d\n", height - height / 4);
+    printf("FONT_DESCENT %d\n", height / 4);
+    printf("ENDPROPERTIES\n");
+    printf("CHARS %d\n", count);
+    for (i = 0; i < count; ++i) {
+	WriteCharacter(first + i, width, height, offset, proportional);
+    }
+    printf("ENDFONT\n");
+    return 0;
+}
+
+/// @}
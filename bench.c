@@ -0,0 +1,1087 @@
+///
+///	@file bench.c		@brief bdf2c benchmark
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup bench Benchmark
+///
+///	Times the phases of the conversion one after the other: parse, hex
+///	decode, rotate, outline, emit and the ppm preview, followed by complete
+///	conversions.  Each phase also runs a plain reference implementation,
+///	the benchmark fails if the results differ.
+///
+///	Random glyphs of all sizes and densities check the fast paths
+///	against the reference implementations beyond the fonts.  The
+///	glyphs/s of the phases can be written as baseline, a later run fails
+///	if a phase became slower than the baseline by more than a threshold.
+///
+///	The convertor is included as source, to reach its static functions.
+///
+/// @{
+
+#include <time.h>
+
+#define main Bdf2cMain			///< the convertor main isn't used
+#include "bdf2c.c"
+#undef main
+
+///
+///	Scanline of the font, as range in the mapped font file.
+///
+typedef struct _bench_line_ {
+    const char *Start;			///< first hex digit
+    size_t Length;			///< number of hex digits
+} BenchLine;
+
+///
+///	Character of the font.
+///
+typedef struct _bench_char_ {
+    int Encoding;			///< character encoding
+    BdfBbx Bbx;				///< character bounding box
+    int Line;				///< first scanline in line table
+    int Lines;				///< number of scanlines
+} BenchChar;
+
+///
+///	Font prepared for the phases.
+///
+typedef struct _bench_font_ {
+    BdfInput Input;			///< mapped font file
+    int Width;				///< bitmap width, with outline
+    int Height;				///< bitmap height, with outline
+    int Stride;				///< bytes per bitmap row
+    int Size;				///< bytes per bitmap
+    BenchChar *Chars;			///< characters
+    int CharCount;			///< number of characters
+    int CharMax;			///< allocated characters
+    BenchLine *Lines;			///< scanlines of all characters
+    int LineCount;			///< number of scanlines
+    int LineMax;			///< allocated scanlines
+    size_t HexBytes;			///< hex digits of all scanlines
+    unsigned char *Bitmaps;		///< bitmaps of all characters
+    unsigned char *Reference;		///< reference bitmaps
+} BenchFont;
+
+///
+///	Speed of phase, for the baseline.
+///
+typedef struct _bench_result_ {
+    const char *Font;			///< font file name
+    const char *Phase;			///< name of phase
+    double Rate;			///< glyphs per second
+} BenchResult;
+
+///
+///	Timer of the runs of one phase, the fastest run is reported.
+///
+typedef struct _bench_timer_ {
+    double Start;			///< start of current run
+    double Total;			///< seconds of all runs
+    double Best;			///< seconds of fastest run
+    int Runs;				///< finished runs
+} BenchTimer;
+
+#define BENCH_MAX_RUNS 10000		///< most runs of one phase
+#define BENCH_GATE_TRIES 5		///< benches of fonts slower than baseline
+
+static int Repeat = 1;			///< least runs of each phase
+static double MinTime = 0.2;		///< least seconds of each phase
+static int Radius = 1;			///< outline radius
+static int Failed;			///< number of failed checks
+static int Threshold = 10;		///< allowed slowdown in percent
+static const char *FontName;		///< font of reported phases
+static BenchResult *Results;		///< speed of reported phases
+static int ResultCount;			///< number of results
+static int ResultMax;			///< allocated results
+static uint64_t Seed = 88172645463325252ULL;	///< random generator state
+
+///
+///	Get time in seconds.
+///
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+///
+///	Start timing runs of a phase.
+///
+static void TimerInit(BenchTimer * timer)
+{
+    memset(timer, 0, sizeof(*timer));
+}
+
+///
+///	Check if the phase needs another run.  A phase runs at least Repeat
+///	times and MinTime seconds, so short phases are timed stable.
+///
+static int TimerMore(const BenchTimer * timer)
+{
+    return timer->Runs < Repeat || (timer->Total < MinTime
+	&& timer->Runs < BENCH_MAX_RUNS);
+}
+
+///
+///	Start timed run.
+///
+static void TimerStart(BenchTimer * timer)
+{
+    timer->Start = Now();
+}
+
+///
+///	Stop timed run.
+///
+static void TimerStop(BenchTimer * timer)
+{
+    double t;
+
+    t = Now() - timer->Start;
+    timer->Total += t;
+    if (!timer->Runs++ || t < timer->Best) {
+	timer->Best = t;
+    }
+}
+
+///
+///	Print result of phase.  The fastest run is used, the slower runs
+///	were disturbed by other processes, interrupts or cold caches.
+///
+///	@param phase	name of phase
+///	@param timer	timer of all runs
+///	@param chars	characters processed by one run
+///	@param bytes	bytes processed by one run
+///	@param reference	reference time in seconds, < 0 without reference
+///
+static void Report(const char *phase, const BenchTimer * timer, int chars,
+    size_t bytes, double reference)
+{
+    double t;
+    int i;
+
+    t = timer->Best;
+    if (t <= 0.0) {
+	t = 1e-9;
+    }
+    printf("%-10s %9.3f ms %12.0f glyphs/s %9.1f MB/s", phase, t * 1e3,
+	chars / t, bytes / t / 1e6);
+    for (i = 0; i < ResultCount; ++i) {	// benched again, keep fastest
+	if (Results[i].Font == FontName && !strcmp(Results[i].Phase, phase)) {
+	    break;
+	}
+    }
+    if (i == ResultCount) {
+	if (ResultCount == ResultMax) {
+	    Results = GrowArray(Results, &ResultMax, sizeof(*Results));
+	}
+	Results[ResultCount].Font = FontName;
+	Results[ResultCount].Phase = phase;
+	Results[ResultCount++].Rate = 0.0;
+    }
+    if (chars / t > Results[i].Rate) {
+	Results[i].Rate = chars / t;
+    }
+    if (reference > 0.0) {
+	printf("   reference %9.3f ms  x%.1f", reference * 1e3, reference / t);
+    }
+    printf("\n");
+}
+
+///
+///	Check result of phase against the reference.
+///
+///	@param phase	name of phase
+///	@param a	fast path result
+///	@param b	reference result
+///	@param n	size of results
+///
+static void Check(const char *phase, const void *a, const void *b, size_t n)
+{
+    const unsigned char *p;
+    const unsigned char *q;
+    size_t i;
+
+    if (memcmp(a, b, n)) {
+	p = a;
+	q = b;
+	for (i = 0; p[i] == q[i]; ++i) {
+	}
+	fprintf(stderr, "%s: differs from reference at byte %zu\n", phase, i);
+	++Failed;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Reference implementations
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Shift row one pixel at a time.
+///
+static void ReferenceShift(unsigned char *row, int shift, int stride)
+{
+    int x;
+    int from;
+
+    for (x = stride * 8 - 1; x >= 0; --x) {
+	from = x - shift;
+	if (from >= 0 && row[from / 8] & (0x80 >> from % 8)) {
+	    row[x / 8] |= 0x80 >> x % 8;
+	} else {
+	    row[x / 8] &= ~(0x80 >> x % 8);
+	}
+    }
+}
+
+///
+///	Outline character one pixel at a time.
+///
+static void ReferenceOutline(unsigned char *bitmap, int width, int height,
+    int radius, int diagonal)
+{
+    unsigned char *self;
+    unsigned char *grow;
+    unsigned char *next;
+    int stride;
+    int x;
+    int y;
+    int i;
+    int j;
+    int r;
+
+    stride = (width + 7) / 8;
+    self = calloc(width * height, 3);
+    grow = self + width * height;
+    next = grow + width * height;
+    for (y = 0; y < height; ++y) {
+	for (x = 0; x < width; ++x) {
+	    self[y * width + x] = grow[y * width + x] =
+		!!(bitmap[y * stride + x / 8] & (0x80 >> x % 8));
+	}
+    }
+    for (r = 0; r < radius; ++r) {
+	for (y = 0; y < height; ++y) {
+	    for (x = 0; x < width; ++x) {
+		next[y * width + x] = 0;
+		for (j = -1; j <= 1; ++j) {
+		    for (i = -1; i <= 1; ++i) {
+			if ((i && j && !diagonal) || x + i < 0 || x + i >= width
+			    || y + j < 0 || y + j >= height) {
+			    continue;
+			}
+			next[y * width + x] |= grow[(y + j) * width + x + i];
+		    }
+		}
+	    }
+	}
+	memcpy(grow, next, width * height);
+    }
+    memset(bitmap, 0, stride * height);
+    for (y = 0; y < height; ++y) {
+	for (x = 0; x < width; ++x) {
+	    if (grow[y * width + x] && !self[y * width + x]) {
+		bitmap[y * stride + x / 8] |= 0x80 >> x % 8;
+	    }
+	}
+    }
+    free(self);
+}
+
+///
+///	Dump character one pixel at a time.
+///
+static void ReferenceDump(Output * out, const unsigned char *bitmap,
+    int width, int height)
+{
+    int x;
+    int y;
+    int n;
+
+    n = (width + 7) / 8;
+    for (y = 0; y < height; ++y) {
+	OutputChar(out, '\t');
+	for (x = 0; x < n * 8; ++x) {
+	    OutputChar(out, bitmap[y * n + x / 8] & (0x80 >> x % 8) ? 'X' :
+		'_');
+	    if (x % 8 == 7) {
+		OutputChar(out, ',');
+	    }
+	}
+	OutputChar(out, '\n');
+    }
+}
+
+///
+///	Draw character into cavas one pixel at a time.
+///
+static void ReferenceBlit(ppm_cavas_t * dest, size_t dx, size_t dy,
+    const unsigned char *bitmap, int width, int height)
+{
+    int stride;
+    int x;
+    int y;
+
+    stride = (width + 7) / 8;
+    for (y = 0; y < height; ++y) {
+	for (x = 0; x < width; ++x) {
+	    ppm_cavas_pixel_index(dest, dx + x, dy + y,
+		bitmap[y * stride + x / 8] & (0x80 >> x % 8) ? 1 : 0);
+	}
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Random glyphs
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Random number (xorshift64).
+///
+static unsigned Random(void)
+{
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 7;
+    Seed ^= Seed << 17;
+    return Seed >> 32;
+}
+
+///
+///	Random number in range.
+///
+///	@param first	smallest value
+///	@param last	largest value
+///
+static int RandomRange(int first, int last)
+{
+    if (last <= first) {
+	return first;
+    }
+    return first + Random() % (last - first + 1);
+}
+
+///
+///	Random scanline as hex digits of random case.  Rarely a digit is
+///	invalid or missing, which both decoders must report alike.
+///
+///	@param[out] hex	hex digits, room for 2 * stride digits
+///	@param stride	bytes of the row
+///	@param density	set pixels in eighths
+///
+///	@returns number of hex digits.
+///
+static size_t RandomHex(char *hex, int stride, int density)
+{
+    int n;
+    int i;
+    int j;
+    int v;
+
+    n = 2 * stride;
+    for (i = 0; i < n; ++i) {
+	for (v = j = 0; j < 4; ++j) {
+	    v = v << 1 | ((int)(Random() % 8) < density);
+	}
+	hex[i] = (Random() & 1 ? "0123456789ABCDEF" : "0123456789abcdef")[v];
+    }
+    switch (Random() % 64) {
+	case 0:
+	    hex[Random() % n] = "gG x-"[Random() % 5];
+	    break;
+	case 1:
+	    --n;
+	    break;
+    }
+    return n;
+}
+
+///
+///	Check the fast paths against the reference implementations with
+///	random glyphs: hex decode, rotate, outline and emit.
+///
+///	@param count	number of glyphs
+///
+static void RandomGlyphs(int count)
+{
+    unsigned char fast[20 * 48];
+    unsigned char slow[20 * 48];
+    char hex[2 * 20];
+    Output out;
+    Output ref;
+    Arena scratch;
+    size_t len;
+    double start;
+    int failed;
+    int width;
+    int height;
+    int stride;
+    int size;
+    int density;
+    int shift;
+    int radius;
+    int diagonal;
+    int a;
+    int b;
+    int n;
+    int y;
+
+    ArenaInit(&scratch);
+    OutputOpen(&out, NULL);
+    OutputOpen(&ref, NULL);
+    failed = Failed;
+    start = Now();
+    for (n = 0; n < count; ++n) {
+	width = RandomRange(1, 160);
+	height = RandomRange(1, 48);
+	stride = (width + 7) / 8;
+	size = stride * height;
+	density = RandomRange(0, 8);
+	memset(fast, 0, size);
+	memset(slow, 0, size);
+	for (y = 0; y < height; ++y) {
+	    len = RandomHex(hex, stride, density);
+	    a = HexDecode(fast + y * stride, stride, hex, len);
+	    b = HexDecodeTable(slow + y * stride, stride, hex, len);
+	    if (a != b) {
+		fprintf(stderr, "random-hex: %d bytes, reference %d bytes\n",
+		    a, b);
+		++Failed;
+	    }
+	    if (a < 0) {		// invalid rows, written partly
+		memset(fast + y * stride, 0, stride);
+		memset(slow + y * stride, 0, stride);
+	    }
+	}
+	Check("random-hex", fast, slow, size);
+	for (y = 0; y < height; ++y) {	// fonts have empty padding bits
+	    fast[y * stride + stride - 1] &= 0xFF << (stride * 8 - width);
+	}
+
+	if (width > 1) {
+	    shift = RandomRange(1, width - 1);
+	    memcpy(slow, fast, size);
+	    RotateBitmap(fast, shift, width, height);
+	    for (y = 0; y < height; ++y) {
+		ReferenceShift(slow + y * stride, shift, stride);
+	    }
+	    Check("random-rotate", fast, slow, size);
+	}
+
+	radius = RandomRange(1, 3);
+	diagonal = Random() & 1;
+	memcpy(slow, fast, size);
+	OutlineCharacter(fast, width, height, radius, diagonal, &scratch);
+	ReferenceOutline(slow, width, height, radius, diagonal);
+	Check("random-outline", fast, slow, size);
+
+	OutputReset(&out);
+	OutputReset(&ref);
+	DumpCharacter(&out, fast, width, height);
+	ReferenceDump(&ref, fast, width, height);
+	if (out.Used != ref.Used) {
+	    ++Failed;
+	} else {
+	    Check("random-emit", out.Buffer, ref.Buffer, out.Used);
+	}
+	if (Failed != failed) {
+	    fprintf(stderr, "random glyph %d: %dx%d, density %d, radius %d%s\n",
+		n, width, height, density, radius, diagonal ? ", diagonal" : "");
+	    failed = Failed;
+	}
+    }
+    printf("random     %9.3f ms %12d glyphs checked\n", (Now() - start) * 1e3,
+	count);
+    OutputClose(&out);
+    OutputClose(&ref);
+    ArenaFree(&scratch);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Baseline
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Write the speed of all phases as baseline, one line for each
+///	phase: font file, phase and glyphs/s.
+///
+///	@param file	baseline file name
+///
+static void WriteBaseline(const char *file)
+{
+    FILE *f;
+    int i;
+
+    if (!(f = fopen(file, "w"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", file, strerror(errno));
+	exit(-1);
+    }
+    for (i = 0; i < ResultCount; ++i) {
+	fprintf(f, "%s %s %.0f\n", Results[i].Font, Results[i].Phase,
+	    Results[i].Rate);
+    }
+    if (fclose(f)) {
+	fprintf(stderr, "Can't write file '%s'\n", file);
+	exit(-1);
+    }
+}
+
+///
+///	Compare the speed of all phases with the baseline.  A phase slower
+///	than the baseline by more than Threshold percent fails, phases
+///	missing in the baseline are skipped.
+///
+///	@param file	baseline file name
+///	@param fail	true print and count the slow phases as failed checks
+///
+///	@returns number of slow phases.
+///
+static int CheckBaseline(const char *file, int fail)
+{
+    char font[1024];
+    char phase[64];
+    double rate;
+    FILE *f;
+    int slow;
+    int i;
+
+    if (!(f = fopen(file, "r"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", file, strerror(errno));
+	exit(-1);
+    }
+    fflush(stdout);			// messages after the phase table
+    slow = 0;
+    while (fscanf(f, "%1023s %63s %lf", font, phase, &rate) == 3) {
+	for (i = 0; i < ResultCount; ++i) {
+	    if (strcmp(Results[i].Font, font)
+		|| strcmp(Results[i].Phase, phase)) {
+		continue;
+	    }
+	    if (Results[i].Rate >= rate * (100 - Threshold) / 100) {
+		continue;
+	    }
+	    ++slow;
+	    if (fail) {
+		fprintf(stderr, "%s: %s %.0f glyphs/s, baseline %.0f, "
+		    "%.0f%% slower\n", font, phase, Results[i].Rate, rate,
+		    100.0 - Results[i].Rate * 100.0 / rate);
+		++Failed;
+	    }
+	}
+    }
+    fclose(f);
+    return slow;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Phases
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Parse font into character and scanline tables.
+///
+///	@param font	font to fill, the input must be opened
+///
+static void Parse(BenchFont * font)
+{
+    const char *line;
+    const char *end;
+    const char *s;
+    size_t len;
+    BenchChar *c;
+    int bitmap;
+
+    font->CharCount = 0;
+    font->LineCount = 0;
+    font->HexBytes = 0;
+    font->Input.Pos = font->Input.Buffer;
+    c = NULL;
+    bitmap = 0;
+    while ((line = BdfInputLine(&font->Input, &end))) {
+	if (!(s = NextToken(&line, end, &len))) {
+	    continue;
+	}
+	switch (Keyword(s, len)) {
+	    case KeywordFontBoundingBox:
+		font->Width = NextInt(&line, end) + 2 * Radius;
+		font->Height = NextInt(&line, end) + 2 * Radius;
+		break;
+	    case KeywordStartChar:
+		if (font->CharCount == font->CharMax) {
+		    font->Chars =
+			GrowArray(font->Chars, &font->CharMax,
+			sizeof(*font->Chars));
+		}
+		c = &font->Chars[font->CharCount++];
+		memset(c, 0, sizeof(*c));
+		break;
+	    case KeywordEncoding:
+		if (c) {
+		    c->Encoding = NextInt(&line, end);
+		}
+		break;
+	    case KeywordBbx:
+		if (c) {
+		    c->Bbx.Width = NextInt(&line, end);
+		    c->Bbx.Height = NextInt(&line, end);
+		    c->Bbx.X = NextInt(&line, end);
+		    c->Bbx.Y = NextInt(&line, end);
+		}
+		break;
+	    case KeywordBitmap:
+		if (c) {
+		    c->Line = font->LineCount;
+		    bitmap = 1;
+		}
+		break;
+	    case KeywordEndChar:
+		bitmap = 0;
+		c = NULL;
+		break;
+	    default:
+		if (bitmap) {
+		    if (font->LineCount == font->LineMax) {
+			font->Lines =
+			    GrowArray(font->Lines, &font->LineMax,
+			    sizeof(*font->Lines));
+		    }
+		    font->Lines[font->LineCount].Start = s;
+		    font->Lines[font->LineCount].Length = len;
+		    font->LineCount++;
+		    font->HexBytes += len;
+		    c->Lines++;
+		}
+		break;
+	}
+    }
+}
+
+///
+///	Decode scanlines of all characters.
+///
+///	@param font	parsed font
+///	@param bitmaps	bitmaps of all characters
+///	@param decode	hex decoder
+///
+static void Decode(const BenchFont * font, unsigned char *bitmaps,
+    HexDecoder decode)
+{
+    const BenchChar *c;
+    const BenchLine *l;
+    int i;
+    int y;
+
+    memset(bitmaps, 0, (size_t) font->Size * font->CharCount);
+    for (i = 0; i < font->CharCount; ++i) {
+	c = &font->Chars[i];
+	for (y = 0; y < c->Lines && y + Radius < font->Height; ++y) {
+	    l = &font->Lines[c->Line + y];
+	    if (decode(bitmaps + (size_t) i * font->Size + (y +
+			Radius) * font->Stride, font->Stride, l->Start,
+		    l->Length) < 0) {
+		fprintf(stderr, "Invalid hex digit in character %d\n",
+		    c->Encoding);
+		exit(-1);
+	    }
+	}
+    }
+}
+
+///
+///	Shift of character, like the convertor does.
+///
+static int CharShift(const BenchFont * font, const BenchChar * c)
+{
+    int shift;
+
+    shift = 0;
+    if (c->Bbx.X > 0 && c->Bbx.X < font->Width) {
+	shift = c->Bbx.X;
+    }
+    if (Radius && Radius < font->Width) {
+	shift += Radius;
+    }
+    return shift;
+}
+
+///
+///	Shift rows of all characters.
+///
+///	@param font	parsed font
+///	@param bitmaps	bitmaps of all characters
+///	@param reference	true use reference implementation
+///
+static void Rotate(const BenchFont * font, unsigned char *bitmaps,
+    int reference)
+{
+    unsigned char *row;
+    int shift;
+    int i;
+    int y;
+
+    for (i = 0; i < font->CharCount; ++i) {
+	if (!(shift = CharShift(font, &font->Chars[i]))) {
+	    continue;
+	}
+	row = bitmaps + (size_t) i * font->Size;
+	for (y = 0; y < font->Height; ++y, row += font->Stride) {
+	    if (reference) {
+		ReferenceShift(row, shift, font->Stride);
+	    } else {
+		ShiftRow(row, shift, font->Stride);
+	    }
+	}
+    }
+}
+
+///
+///	Benchmark one font.
+///
+///	@param name	font file name
+///
+static void Bench(const char *name)
+{
+    BenchFont font;
+    FILE *bdf;
+    FILE *null;
+    Output out;
+    Output ref;
+    BdfOptions options;
+    bdf2c_fontpic_t pic;
+    ppm_cavas_t *fast;
+    ppm_cavas_t *slow;
+    Arena scratch;
+    BenchTimer timer;
+    unsigned char *bitmap;
+    size_t bytes;
+    double t;
+    int i;
+    int bit;
+
+    if (!(bdf = fopen(name, "rb"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", name, strerror(errno));
+	exit(-1);
+    }
+    memset(&font, 0, sizeof(font));
+    FontName = name;
+    BdfInputOpen(&font.Input, bdf);
+    if (!font.Input.Mapped) {
+	fprintf(stderr, "Can't map file '%s'\n", name);
+	exit(-1);
+    }
+    printf("%s: %zu bytes, hex decoder %s, outline radius %d\n", name,
+	font.Input.Size, HexDecodeName(), Radius);
+
+    TimerInit(&timer);
+    while (TimerMore(&timer)) {
+	TimerStart(&timer);
+	Parse(&font);
+	TimerStop(&timer);
+    }
+    Report("parse", &timer, font.CharCount, font.Input.Size, -1.0);
+    if (font.Width <= 0 || font.Height <= 0) {
+	fprintf(stderr, "%s: no font bounding box\n", name);
+	exit(-1);
+    }
+    font.Stride = (font.Width + 7) / 8;
+    font.Size = font.Stride * font.Height;
+    bytes = (size_t) font.Size * font.CharCount;
+    font.Bitmaps = malloc(bytes + 1);
+    font.Reference = malloc(bytes + 1);
+    if (!font.Bitmaps || !font.Reference) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+
+    TimerInit(&timer);
+    while (TimerMore(&timer)) {
+	TimerStart(&timer);
+	Decode(&font, font.Reference, HexDecodeTable);
+	TimerStop(&timer);
+    }
+    t = timer.Best;
+    TimerInit(&timer);
+    while (TimerMore(&timer)) {
+	TimerStart(&timer);
+	Decode(&font, font.Bitmaps, HexDecode);
+	TimerStop(&timer);
+    }
+    Report("hexdecode", &timer, font.CharCount, font.HexBytes, t);
+    Check("hexdecode", font.Bitmaps, font.Reference, bytes);
+
+    t = Now();
+    memcpy(font.Reference, font.Bitmaps, bytes);
+    Rotate(&font, font.Reference, 1);
+    t = Now() - t;
+    TimerInit(&timer);
+    while (TimerMore(&timer)) {
+	if (timer.Runs) {		// each run from the decoded bitmaps
+	    Decode(&font, font.Bitmaps, HexDecode);
+	}
+	TimerStart(&timer);
+	Rotate(&font, font.Bitmaps, 0);
+	TimerStop(&timer);
+    }
+    Report("rotate", &timer, font.CharCount, bytes, t);
+    Check("rotate", font.Bitmaps, font.Reference, bytes);
+
+    if (Radius) {
+	t = Now();
+	for (i = 0; i < font.CharCount; ++i) {
+	    ReferenceOutline(font.Reference + (size_t) i * font.Size,
+		font.Width, font.Height, Radius, 0);
+	}
+	t = Now() - t;
+	ArenaInit(&scratch);
+	bitmap = malloc(font.Size);
+	TimerInit(&timer);
+	while (TimerMore(&timer)) {
+	    TimerStart(&timer);
+	    for (i = 0; i < font.CharCount; ++i) {
+		memcpy(bitmap, font.Bitmaps + (size_t) i * font.Size,
+		    font.Size);
+		OutlineCharacter(bitmap, font.Width, font.Height, Radius, 0,
+		    &scratch);
+	    }
+	    TimerStop(&timer);
+	}
+	Report("outline", &timer, font.CharCount, bytes, t);
+	for (i = 0; i < font.CharCount; ++i) {	// outlined for next phases
+	    OutlineCharacter(font.Bitmaps + (size_t) i * font.Size,
+		font.Width, font.Height, Radius, 0, &scratch);
+	}
+	Check("outline", font.Bitmaps, font.Reference, bytes);
+	free(bitmap);
+	ArenaFree(&scratch);
+    }
+
+    OutputOpen(&out, NULL);
+    OutputOpen(&ref, NULL);
+    t = Now();
+    for (i = 0; i < font.CharCount; ++i) {
+	ReferenceDump(&ref, font.Bitmaps + (size_t) i * font.Size,
+	    font.Width, font.Height);
+    }
+    t = Now() - t;
+    TimerInit(&timer);
+    while (TimerMore(&timer)) {
+	OutputReset(&out);
+	TimerStart(&timer);
+	for (i = 0; i < font.CharCount; ++i) {
+	    DumpCharacter(&out, font.Bitmaps + (size_t) i * font.Size,
+		font.Width, font.Height);
+	}
+	TimerStop(&timer);
+    }
+    Report("emit", &timer, font.CharCount, out.Used, t);
+    if (out.Used != ref.Used) {
+	fprintf(stderr, "emit: %zu bytes, reference %zu bytes\n", out.Used,
+	    ref.Used);
+	++Failed;
+    } else {
+	Check("emit", out.Buffer, ref.Buffer, out.Used);
+    }
+    OutputClose(&out);
+    OutputClose(&ref);
+
+    // draw all characters side by side into a mono and an indexed cavas
+    for (bit = PPM_CAVAS_MONO; bit <= PPM_CAVAS_INDEX; bit += 7) {
+	fast = ppm_cavas_create((size_t) font.Width * 64,
+	    (size_t) font.Height * ((font.CharCount + 63) / 64), bit);
+	slow = ppm_cavas_create((size_t) font.Width * 64,
+	    (size_t) font.Height * ((font.CharCount + 63) / 64), bit);
+	if (!fast || !slow) {
+	    fprintf(stderr, "Out of memory\n");
+	    exit(-1);
+	}
+	ppm_cavas_zero(fast);
+	ppm_cavas_zero(slow);
+	t = Now();
+	for (i = 0; i < font.CharCount; ++i) {
+	    ReferenceBlit(slow, i % 64 * font.Width, i / 64 * font.Height,
+		font.Bitmaps + (size_t) i * font.Size, font.Width,
+		font.Height);
+	}
+	t = Now() - t;
+	TimerInit(&timer);
+	while (TimerMore(&timer)) {
+	    TimerStart(&timer);
+	    for (i = 0; i < font.CharCount; ++i) {
+		ppm_cavas_blit_bitmap(fast, i % 64 * font.Width,
+		    i / 64 * font.Height,
+		    font.Bitmaps + (size_t) i * font.Size, font.Width,
+		    font.Height, 1, 0);
+	    }
+	    TimerStop(&timer);
+	}
+	Report(bit == PPM_CAVAS_MONO ? "blit-mono" : "blit-index", &timer,
+	    font.CharCount, bytes, t);
+	Check("blit", fast->buffer, slow->buffer, fast->buffer_size);
+	ppm_cavas_destroy(fast);
+	ppm_cavas_destroy(slow);
+    }
+
+    memset(&pic, 0, sizeof(pic));		// no stream, write the file
+    TimerInit(&timer);
+    while (TimerMore(&timer)) {
+	TimerStart(&timer);
+	if (bdf2c_fontpic_init(&pic, "bench.ppm", font.Chars[0].Encoding,
+		font.CharCount, font.Width, font.Height)) {
+	    exit(-1);
+	}
+	for (i = 0; i < font.CharCount; ++i) {
+	    bdf2c_fontpic_add(&pic, font.Bitmaps + (size_t) i * font.Size,
+		font.Width, font.Height, font.Chars[0].Encoding + i, 0);
+	}
+	bdf2c_fontpic_clear(&pic);
+	TimerStop(&timer);
+    }
+    Report("ppm", &timer, font.CharCount, bytes, -1.0);
+    unlink("bench.ppm");
+
+    // complete conversions, single threaded and one thread per cpu
+    if (!(null = fopen("/dev/null", "wb"))) {
+	fprintf(stderr, "Can't open file '/dev/null': %s\n", strerror(errno));
+	exit(-1);
+    }
+    memset(&options, 0, sizeof(options));
+    options.Name = "font";
+    options.PreviewLast = INT_MAX;
+    for (i = 0; i < 2; ++i) {
+	options.Jobs = i ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+	TimerInit(&timer);
+	while (TimerMore(&timer)) {
+	    rewind(bdf);
+	    TimerStart(&timer);
+	    ReadBdf(&options, bdf, null);
+	    TimerStop(&timer);
+	}
+	Report(i ? "convert-j0" : "convert", &timer, font.CharCount,
+	    font.Input.Size, -1.0);
+    }
+    fclose(null);
+
+    BdfInputClose(&font.Input);
+    fclose(bdf);
+    free(font.Chars);
+    free(font.Lines);
+    free(font.Bitmaps);
+    free(font.Reference);
+}
+
+/// @}
+
+///
+///	Print usage.
+///
+static void PrintBenchUsage(void)
+{
+    printf("Usage: bdf2c-bench [OPTIONs] font.bdf ...\n"
+	"\t-r n\tRun each phase at least 'n' times (1)\n"
+	"\t-t ms\tRun each phase at least 'ms' milliseconds (200)\n"
+	"\t-O n\tOutline radius, 0 no outline (1)\n"
+	"\t-R n\tCheck 'n' random glyphs against the references (0)\n"
+	"\t-s n\tSeed of the random glyphs\n"
+	"\t-W file\tWrite glyphs/s of all phases as baseline\n"
+	"\t-B file\tFail if a phase is slower than the baseline\n"
+	"\t-T n\tAllowed slowdown against the baseline in percent (10)\n");
+}
+
+///
+///	Main entry point.
+///
+int main(int argc, char *const argv[])
+{
+    const char *baseline;
+    const char *write;
+    int random;
+    int i;
+    int n;
+
+    baseline = NULL;
+    write = NULL;
+    random = 0;
+    for (;;) {
+	switch (getopt(argc, argv, "r:t:O:R:s:W:B:T:h?")) {
+	    case 'r':
+		Repeat = atoi(optarg);
+		continue;
+	    case 't':
+		MinTime = atoi(optarg) / 1e3;
+		continue;
+	    case 'O':
+		Radius = atoi(optarg);
+		continue;
+	    case 'R':
+		random = atoi(optarg);
+		continue;
+	    case 's':
+		Seed = strtoull(optarg, NULL, 0) | 1;
+		continue;
+	    case 'W':
+		write = optarg;
+		continue;
+	    case 'B':
+		baseline = optarg;
+		continue;
+	    case 'T':
+		Threshold = atoi(optarg);
+		continue;
+	    case -1:
+		break;
+	    default:
+		PrintBenchUsage();
+		return 0;
+	}
+	break;
+    }
+    if (Repeat < 1 || MinTime < 0.0 || Radius < 0 || Radius > 64 || random < 0
+	|| Threshold < 0 || Threshold > 100 || (optind == argc && !random)) {
+	PrintBenchUsage();
+	return -1;
+    }
+    if (random) {
+	RandomGlyphs(random);
+    }
+    for (i = optind; i < argc; ++i) {
+	Bench(argv[i]);
+    }
+    if (write) {
+	WriteBaseline(write);
+    }
+    if (baseline) {
+	// slow phases are benched again, a busy machine isn't a regression
+	for (n = 1; n < BENCH_GATE_TRIES && CheckBaseline(baseline, 0); ++n) {
+	    printf("slower than baseline, try %d\n", n + 1);
+	    for (i = optind; i < argc; ++i) {
+		Bench(argv[i]);
+	    }
+	}
+	CheckBaseline(baseline, 1);
+    }
+    if (Failed) {
+	fprintf(stderr, "%d checks failed\n", Failed);
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,375 @@
+///
+///	@file fuzz.c		@brief bdf2c fuzz target
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup fuzz Fuzz target
+///
+///	Feeds arbitrary bytes to the tokenizer, the character conversion and
+///	the emitters through Bdf2cParse() and Bdf2cEmit(), and to the hex
+///	decoder of this CPU, which is compared with the lookup table decoder.
+///	The first two bytes of an input select the options, the rest is the
+///	font.
+///
+///	LLVMFuzzerTestOneInput() is the libFuzzer entry point, built with
+///	clang -fsanitize=fuzzer.  With FUZZ_MAIN the target gets its own
+///	main, for AFL and for compilers without libFuzzer: it runs the
+///	files of the command line or stdin, and with -n random mutations of
+///	them.
+///
+///	The convertor is included as source, to reach its static functions.
+///
+/// @{
+
+#define main Bdf2cMain			///< the convertor main isn't used
+#include "bdf2c.c"
+#undef main
+
+    /// largest font bounding box, larger fonts are only too slow
+#define FUZZ_MAX_SIZE 64
+
+    /// last encoding in preview, the grid of far encodings is too large
+#define FUZZ_PREVIEW_LAST 0x3FF
+
+///
+///	Write function dropping the output, like the library does.
+///
+static int FuzzDiscard(void *user, const void *data, size_t n)
+{
+    (void)user;
+    (void)data;
+    (void)n;
+    return 0;
+}
+
+///
+///	Select conversion options from two option bytes.
+///
+///	@param[out] options	conversion options
+///	@param a		first option byte
+///	@param b		second option byte
+///
+static void FuzzOptions(BdfOptions * options, int a, int b)
+{
+    static const int bpp[4] = { 0, 2, 4, 8 };
+
+    Bdf2cOptionsInit(options);
+    options->Proportional = a & 1;
+    options->Outline = a >> 1 & 3;
+    options->OutlineDiagonal = a >> 3 & 1;
+    options->Dedup = a >> 4 & 1;
+    options->Compress = a >> 5 & 1;
+    options->Compact = a >> 6 & 1;
+    options->PageIndex = a >> 7 & 1;
+    options->Layout = (b & 3) % 3;
+    options->Bpp = bpp[b >> 2 & 3];
+    options->Rotate = (b >> 4 & 3) * 90;
+    options->Downscale = (b >> 6 & 1) + 1;
+    options->Metrics = b >> 7 & 1;
+    if (options->Layout == LAYOUT_PAGES) {	// rejected by main()
+	options->Bpp = 0;
+    }
+    options->BinaryFile = "fuzz.bin";	// data goes to the sink
+    options->PreviewLast = FUZZ_PREVIEW_LAST;
+}
+
+///
+///	Compare the hex decoder of this CPU with the lookup table decoder.
+///
+///	@param data	hex characters
+///	@param size	number of hex characters
+///
+static void FuzzHexDecode(const uint8_t * data, size_t size)
+{
+    unsigned char *fast;
+    unsigned char *slow;
+    size_t n;
+    int a;
+    int b;
+
+    n = (size + 1) / 2 + 1;
+    fast = malloc(n);
+    slow = malloc(n);
+    if (!fast || !slow) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    // also with output buffers shorter than the input
+    for (; n; n /= 2) {
+	memset(fast, 0, n);
+	memset(slow, 0, n);
+	a = HexDecode(fast, n, (const char *)data, size);
+	b = HexDecodeTable(slow, n, (const char *)data, size);
+	if (a != b || (a > 0 && memcmp(fast, slow, a))) {
+	    fprintf(stderr, "%s: %d bytes, reference %d bytes\n",
+		HexDecodeName(), a, b);
+	    abort();
+	}
+    }
+    free(fast);
+    free(slow);
+}
+
+///
+///	Check the font and character bounding boxes, fonts too large for
+///	the fuzzer are skipped.
+///
+///	@param data	bdf font
+///	@param size	size of bdf font
+///
+///	@returns true if the font can be converted in reasonable time.
+///
+static int FuzzSize(const uint8_t * data, size_t size)
+{
+    const char *s;
+    const char *e;
+    const char *end;
+    const char *t;
+    size_t len;
+
+    s = (const char *)data;
+    e = s + size;
+    for (; s < e; s = end + 1) {
+	if (!(end = memchr(s, '\n', e - s))) {
+	    end = e;
+	}
+	t = NextToken(&s, end, &len);
+	if (t && (TokenIs(t, len, "FONTBOUNDINGBOX") || TokenIs(t, len, "BBX"))
+	    && (NextInt(&s, end) > FUZZ_MAX_SIZE
+		|| NextInt(&s, end) > FUZZ_MAX_SIZE)) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+///
+///	libFuzzer entry point.
+///
+///	@param data	option bytes and bdf font
+///	@param size	size of input
+///
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+    BdfOptions options;
+    Bdf2cFont *font;
+    Bdf2cSink sink;
+    char error[256];
+
+    FuzzHexDecode(data, size);
+    if (size < 2) {
+	return 0;
+    }
+    FuzzOptions(&options, data[0], data[1]);
+    data += 2;
+    size -= 2;
+    if (!FuzzSize(data, size)) {
+	return 0;
+    }
+    sink.Write = FuzzDiscard;
+    sink.User = NULL;
+    if ((font = Bdf2cParse(&options, data, size, error, sizeof(error)))) {
+	Bdf2cEmit(font, &options, &sink, &sink, &sink, error, sizeof(error));
+	Bdf2cFontFree(font);
+    }
+    return 0;
+}
+
+/// @}
+
+#ifdef FUZZ_MAIN
+
+static uint64_t Seed = 88172645463325252ULL;	///< random generator state
+
+///
+///	Random number (xorshift64).
+///
+static unsigned Random(void)
+{
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 7;
+    Seed ^= Seed << 17;
+    return Seed >> 32;
+}
+
+///
+///	Mutate input, a few random byte changes, inserts, deletes and
+///	copies of digits and keywords.
+///
+///	@param[in,out] data	input, with room for max bytes
+///	@param size		size of input
+///	@param max		size of buffer
+///
+///	@returns size of mutated input.
+///
+static size_t Mutate(uint8_t * data, size_t size, size_t max)
+{
+    static const char *const tokens[] = {
+	"0", "-1", "9999999999", "FF", " ", "\n", "STARTCHAR x\n",
+	"ENCODING 65\n", "BBX 8 8 0 0\n", "BITMAP\n", "ENDCHAR\n",
+	"CHARS 1\n", "FONTBOUNDINGBOX 8 8 0 -2\n", "FONT_ASCENT 7\n",
+	"DWIDTH 8 0\n",
+    };
+    const char *t;
+    size_t pos;
+    size_t n;
+    int i;
+
+    for (i = Random() % 4 + 1; i; --i) {
+	pos = size ? Random() % size : 0;
+	switch (Random() % 5) {
+	    case 0:			// random byte
+		if (size) {
+		    data[pos] = Random();
+		}
+		break;
+	    case 1:			// flip bit
+		if (size) {
+		    data[pos] ^= 1 << Random() % 8;
+		}
+		break;
+	    case 2:			// delete bytes
+		n = Random() % 16;
+		if (n > size - pos) {
+		    n = size - pos;
+		}
+		memmove(data + pos, data + pos + n, size - pos - n);
+		size -= n;
+		break;
+	    default:			// insert token
+		t = tokens[Random() % (sizeof(tokens) / sizeof(*tokens))];
+		n = strlen(t);
+		if (size + n > max) {
+		    break;
+		}
+		memmove(data + pos + n, data + pos, size - pos);
+		memcpy(data + pos, t, n);
+		size += n;
+		break;
+	}
+    }
+    return size;
+}
+
+///
+///	Read file into malloc'ed buffer.
+///
+///	@param name	file name, NULL stdin
+///	@param[out] size	size of file
+///
+static uint8_t *ReadInput(const char *name, size_t * size)
+{
+    uint8_t *data;
+    size_t max;
+    size_t n;
+    FILE *f;
+
+    if (!name) {
+	f = stdin;
+    } else if (!(f = fopen(name, "rb"))) {
+	fprintf(stderr, "Can't open file '%s': %s\n", name, strerror(errno));
+	exit(-1);
+    }
+    data = NULL;
+    max = 0;
+    *size = 0;
+    do {
+	if (*size == max) {
+	    max = max ? max * 2 : 65536;
+	    if (!(data = realloc(data, max))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(-1);
+	    }
+	}
+	n = fread(data + *size, 1, max - *size, f);
+	*size += n;
+    } while (n);
+    if (f != stdin) {
+	fclose(f);
+    }
+    return data;
+}
+
+///
+///	Print usage.
+///
+static void PrintFuzzUsage(void)
+{
+    printf("Usage: bdf2c-fuzz [OPTIONs] [input ...]\n"
+	"\t-n n\tAlso run 'n' random mutations of each input (0)\n"
+	"\t-s n\tSeed of the mutations\n"
+	"Without input stdin is run, for AFL.\n");
+}
+
+///
+///	Main entry point.
+///
+int main(int argc, char *const argv[])
+{
+    uint8_t *data;
+    uint8_t *copy;
+    size_t size;
+    size_t n;
+    long runs;
+    long r;
+
+    runs = 0;
+    for (;;) {
+	switch (getopt(argc, argv, "n:s:h?")) {
+	    case 'n':
+		runs = atol(optarg);
+		continue;
+	    case 's':
+		Seed = strtoull(optarg, NULL, 0) | 1;
+		continue;
+	    case -1:
+		break;
+	    default:
+		PrintFuzzUsage();
+		return 0;
+	}
+	break;
+    }
+    do {
+	data = ReadInput(optind < argc ? argv[optind] : NULL, &size);
+	LLVMFuzzerTestOneInput(data, size);
+	if (runs) {
+	    if (!(copy = malloc(size + 4096))) {
+		fprintf(stderr, "Out of memory\n");
+		exit(-1);
+	    }
+	    n = 0;
+	    for (r = 0; r < runs; ++r) {
+		if (!(r % 16)) {	// mutate mutations, from seed again
+		    memcpy(copy, data, size);
+		    n = size;
+		}
+		n = Mutate(copy, n, size + 4096);
+		LLVMFuzzerTestOneInput(copy, n);
+	    }
+	    free(copy);
+	}
+	free(data);
+    } while (++optind < argc);
+    return 0;
+}
+
+#endif
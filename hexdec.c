@@ -0,0 +1,374 @@
+///
+///	@file hexdec.c		@brief BDF bitmap hex decoder
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup hexdec Hex decoder
+///
+///	Converts the hex scanlines of a BDF BITMAP section into bytes.
+///
+///	The portable decoder uses a 256 entry lookup table.  On x86 SSE2
+///	and AVX2 decoders convert 16 or 32 characters per step, on ARM a
+///	NEON decoder 16 characters.  The best decoder is chosen at runtime
+///	on first use, once for all threads.
+///
+///	All decoders have the same semantic:  at most @c size bytes are
+///	written, extra characters are ignored.  An odd last character is
+///	stored as its nibble value, like the old Hex2Int() loop did.  Any
+///	non hex character is an error.
+///
+/// @{
+
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_X86_SIMD			///< build SSE2/AVX2 decoders
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define USE_NEON			///< build NEON decoder
+#include <arm_neon.h>
+#endif
+
+#include "hexdec.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+const signed char HexDigitValue[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+///
+///	Decode hex characters with the lookup table.
+///
+///	@param dst	output buffer
+///	@param size	size of output buffer
+///	@param src	hex characters
+///	@param len	number of hex characters
+///
+///	@returns number of bytes written, -1 for non hex characters.
+///
+int HexDecodeTable(unsigned char *dst, size_t size, const char *src,
+    size_t len)
+{
+    const unsigned char *s;
+    unsigned char *d;
+    int hi;
+    int lo;
+
+    if (len > size * 2) {
+	len = size * 2;
+    }
+    s = (const unsigned char *)src;
+    d = dst;
+    for (; len >= 2; len -= 2) {
+	hi = HexDigitValue[s[0]];
+	lo = HexDigitValue[s[1]];
+	if ((hi | lo) < 0) {
+	    return -1;
+	}
+	*d++ = hi << 4 | lo;
+	s += 2;
+    }
+    if (len) {				// odd character count
+	if ((lo = HexDigitValue[*s]) < 0) {
+	    return -1;
+	}
+	*d++ = lo;
+    }
+    return d - dst;
+}
+
+#ifdef USE_X86_SIMD
+
+///
+///	Convert 16 hex characters to nibbles.
+///
+///	@param c	hex characters
+///	@param[out] v	nibble values
+///
+///	@returns true if all characters are valid.
+///
+__attribute__ ((target("sse2")))
+static inline int HexNibbles128(__m128i c, __m128i * v)
+{
+    __m128i d;
+    __m128i l;
+    __m128i vd;
+    __m128i vl;
+
+    // '0'-'9'
+    d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    vd = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    // 'a'-'f' and 'A'-'F'
+    l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)),
+	_mm_set1_epi8('a'));
+    vl = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+
+    *v = _mm_or_si128(_mm_and_si128(vd, d), _mm_and_si128(vl,
+	    _mm_add_epi8(l, _mm_set1_epi8(10))));
+    return _mm_movemask_epi8(_mm_or_si128(vd, vl)) == 0xFFFF;
+}
+
+///
+///	Decode hex characters with SSE2, 16 characters per step.
+///
+__attribute__ ((target("sse2")))
+static int HexDecodeSse2(unsigned char *dst, size_t size, const char *src,
+    size_t len)
+{
+    __m128i v;
+    size_t n;
+    int i;
+
+    if (len > size * 2) {
+	len = size * 2;
+    }
+    for (n = 0; len - n * 2 >= 16; n += 8) {
+	if (!HexNibbles128(_mm_loadu_si128((const __m128i *)(src + n * 2)),
+		&v)) {
+	    return -1;
+	}
+	// even nibble is the high part, odd nibble the low part
+	v = _mm_or_si128(_mm_slli_epi16(v, 4), _mm_srli_epi16(v, 8));
+	v = _mm_and_si128(v, _mm_set1_epi16(0x00FF));
+	_mm_storel_epi64((__m128i *) (dst + n), _mm_packus_epi16(v, v));
+    }
+    if ((i = HexDecodeTable(dst + n, size - n, src + n * 2, len - n * 2)) < 0) {
+	return -1;
+    }
+    return n + i;
+}
+
+///
+///	Decode hex characters with AVX2, 32 characters per step.
+///
+__attribute__ ((target("avx2")))
+static int HexDecodeAvx2(unsigned char *dst, size_t size, const char *src,
+    size_t len)
+{
+    __m256i c;
+    __m256i d;
+    __m256i l;
+    __m256i vd;
+    __m256i vl;
+    __m256i v;
+    size_t n;
+    int i;
+
+    if (len > size * 2) {
+	len = size * 2;
+    }
+    for (n = 0; len - n * 2 >= 32; n += 16) {
+	c = _mm256_loadu_si256((const __m256i *)(src + n * 2));
+	d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+	vd = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+	l = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)),
+	    _mm256_set1_epi8('a'));
+	vl = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+	if ((unsigned)_mm256_movemask_epi8(_mm256_or_si256(vd,
+		    vl)) != 0xFFFFFFFFU) {
+	    return -1;
+	}
+	v = _mm256_or_si256(_mm256_and_si256(vd, d), _mm256_and_si256(vl,
+		_mm256_add_epi8(l, _mm256_set1_epi8(10))));
+	v = _mm256_or_si256(_mm256_slli_epi16(v, 4), _mm256_srli_epi16(v, 8));
+	v = _mm256_and_si256(v, _mm256_set1_epi16(0x00FF));
+	// pack works per 128 bit lane, collect quad 0 and 2
+	v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+	_mm_storeu_si128((__m128i *) (dst + n), _mm256_castsi256_si128(v));
+    }
+    if ((i = HexDecodeTable(dst + n, size - n, src + n * 2, len - n * 2)) < 0) {
+	return -1;
+    }
+    return n + i;
+}
+
+#endif
+
+#ifdef USE_NEON
+
+///
+///	Convert 8 hex characters to nibbles.
+///
+///	@param c	hex characters
+///	@param[out] ok	all bits set for valid characters
+///
+///	@returns nibble values.
+///
+static inline uint8x8_t HexNibbles64(uint8x8_t c, uint8x8_t * ok)
+{
+    uint8x8_t d;
+    uint8x8_t l;
+    uint8x8_t vd;
+
+    d = vsub_u8(c, vdup_n_u8('0'));
+    vd = vcle_u8(d, vdup_n_u8(9));
+    l = vsub_u8(vorr_u8(c, vdup_n_u8(0x20)), vdup_n_u8('a'));
+    *ok = vorr_u8(vd, vcle_u8(l, vdup_n_u8(5)));
+    return vbsl_u8(vd, d, vadd_u8(l, vdup_n_u8(10)));
+}
+
+///
+///	Decode hex characters with NEON, 16 characters per step.
+///
+static int HexDecodeNeon(unsigned char *dst, size_t size, const char *src,
+    size_t len)
+{
+    uint8x8x2_t c;
+    uint8x8_t hi;
+    uint8x8_t lo;
+    uint8x8_t ok_hi;
+    uint8x8_t ok_lo;
+    size_t n;
+    int i;
+
+    if (len > size * 2) {
+	len = size * 2;
+    }
+    for (n = 0; len - n * 2 >= 16; n += 8) {
+	// de-interleave: val[0] high nibbles, val[1] low nibbles
+	c = vld2_u8((const uint8_t *)(src + n * 2));
+	hi = HexNibbles64(c.val[0], &ok_hi);
+	lo = HexNibbles64(c.val[1], &ok_lo);
+	if (vget_lane_u64(vreinterpret_u64_u8(vand_u8(ok_hi, ok_lo)),
+		0) != ~(uint64_t) 0) {
+	    return -1;
+	}
+	vst1_u8(dst + n, vorr_u8(vshl_n_u8(hi, 4), lo));
+    }
+    if ((i = HexDecodeTable(dst + n, size - n, src + n * 2, len - n * 2)) < 0) {
+	return -1;
+    }
+    return n + i;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+//	Dispatch
+//////////////////////////////////////////////////////////////////////////////
+
+static int HexDecodeResolve(unsigned char *, size_t, const char *, size_t);
+
+    /// selected decoder, resolved on first call, accessed atomically
+static HexDecoder HexDecodeBest = HexDecodeResolve;
+
+    /// name of selected decoder
+static const char *HexDecodeBestName;
+
+    /// hex characters of one step of selected decoder, accessed atomically
+static size_t HexDecodeBestBlock;
+
+    /// decoder is selected once, also with several threads
+static pthread_once_t HexDecodeOnce = PTHREAD_ONCE_INIT;
+
+///
+///	Select best hex decoder for this CPU.  HexDecode() reads the
+///	decoder without lock, so it is stored last and atomic.
+///
+static void HexDecodeSelect(void)
+{
+#ifdef USE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	HexDecodeBestName = "avx2";
+	__atomic_store_n(&HexDecodeBestBlock, 32, __ATOMIC_RELAXED);
+	__atomic_store_n(&HexDecodeBest, HexDecodeAvx2, __ATOMIC_RELEASE);
+	return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+	HexDecodeBestName = "sse2";
+	__atomic_store_n(&HexDecodeBestBlock, 16, __ATOMIC_RELAXED);
+	__atomic_store_n(&HexDecodeBest, HexDecodeSse2, __ATOMIC_RELEASE);
+	return;
+    }
+#endif
+#ifdef USE_NEON
+    HexDecodeBestName = "neon";
+    __atomic_store_n(&HexDecodeBestBlock, 16, __ATOMIC_RELAXED);
+    __atomic_store_n(&HexDecodeBest, HexDecodeNeon, __ATOMIC_RELEASE);
+    return;
+#endif
+    HexDecodeBestName = "table";
+    __atomic_store_n(&HexDecodeBest, HexDecodeTable, __ATOMIC_RELEASE);
+}
+
+///
+///	First call of HexDecode(), select decoder and decode.
+///
+static int HexDecodeResolve(unsigned char *dst, size_t size, const char *src,
+    size_t len)
+{
+    pthread_once(&HexDecodeOnce, HexDecodeSelect);
+    return __atomic_load_n(&HexDecodeBest, __ATOMIC_ACQUIRE) (dst, size, src,
+	len);
+}
+
+///
+///	Name of the hex decoder used for this CPU.
+///
+const char *HexDecodeName(void)
+{
+    pthread_once(&HexDecodeOnce, HexDecodeSelect);
+    return HexDecodeBestName;
+}
+
+///
+///	Decode hex characters.
+///
+///	@param dst	output buffer
+///	@param size	size of output buffer
+///	@param src	hex characters
+///	@param len	number of hex characters
+///
+///	@returns number of bytes written, -1 for non hex characters.
+///
+///	Rows shorter than one SIMD step are decoded with the table, the
+///	SIMD decoders would only add the dispatch to it.
+///
+int HexDecode(unsigned char *dst, size_t size, const char *src, size_t len)
+{
+    if (len < __atomic_load_n(&HexDecodeBestBlock, __ATOMIC_RELAXED)) {
+	return HexDecodeTable(dst, size, src, len);
+    }
+    return __atomic_load_n(&HexDecodeBest, __ATOMIC_ACQUIRE) (dst, size, src,
+	len);
+}
+
+/// @}
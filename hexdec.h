@@ -0,0 +1,43 @@
+///
+///	@file hexdec.h		@brief BDF bitmap hex decoder
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef _HEXDEC_H
+#define _HEXDEC_H
+
+#include <stddef.h>			// size_t
+
+    /// hex character to nibble value, -1 for non hex characters
+extern const signed char HexDigitValue[256];
+
+    /// hex decoder function
+typedef int (*HexDecoder) (unsigned char *, size_t, const char *, size_t);
+
+    /// decode hex string with lookup table only
+extern int HexDecodeTable(unsigned char *, size_t, const char *, size_t);
+
+    /// name of the hex decoder selected for this CPU
+extern const char *HexDecodeName(void);
+
+    /// decode hex string with the best decoder for this CPU
+extern int HexDecode(unsigned char *, size_t, const char *, size_t);
+
+#endif // _HEXDEC_H
@@ -0,0 +1,190 @@
+///
+///	@file libbdf2c.h	@brief BDF Font to C source convertor library
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup libbdf2c Library
+///
+///	The converter as library, for tools which convert fonts without
+///	files or processes.  A font is parsed from a memory buffer into a
+///	font object, which can be emitted any number of times with different
+///	output options into caller buffers or write functions:
+///
+///	@code
+///	BdfOptions options;
+///	Bdf2cFont *font;
+///	Bdf2cBuffer source = { 0 };
+///	Bdf2cSink sink = { Bdf2cBufferWrite, &source };
+///	char error[256];
+///
+///	Bdf2cOptionsInit(&options);
+///	if (!(font = Bdf2cParse(&options, data, size, error, sizeof(error)))
+///	    || Bdf2cEmit(font, &options, &sink, NULL, NULL, error,
+///		sizeof(error))) {
+///	    ...
+///	}
+///	Bdf2cFontFree(font);
+///	free(source.Data);
+///	@endcode
+///
+///	All functions are reentrant, each call works only on its arguments.
+///	A font object can be emitted by several threads at once.  Errors in
+///	the font are returned as message, only out of memory in the output
+///	buffers and arenas still exits.
+///
+/// @{
+
+#ifndef _LIBBDF2C_H
+#define _LIBBDF2C_H
+
+#include <stddef.h>			// size_t
+
+#ifdef BDF2C_LIBRARY
+    /// function exported by the shared library
+#define BDF2C_API __attribute__ ((visibility("default")))
+#else
+#define BDF2C_API
+#endif
+
+///
+///	Kerning pair of --kerning.
+///
+typedef struct _bdf_kerning_ {
+    unsigned First;			///< encoding of left character
+    unsigned Second;			///< encoding of right character
+    int Adjust;				///< advance change in pixels
+} BdfKerning;
+
+///
+///	Conversion options, one set for each converted font.
+///
+typedef struct _bdf_options_ {
+    const char *Name;			///< font variable name in C source
+    const char *Preview;		///< ppm preview file name or NULL
+    int PreviewFirst;			///< first encoding in preview
+    int PreviewLast;			///< last encoding in preview
+    int Outline;			///< outline radius, 0 no outline
+    int OutlineDiagonal;		///< true outline with 8-connectivity
+    int Compact;			///< true generate dense hex arrays
+    const char *BinaryFile;		///< raw bitmap file name or NULL
+    int BinaryEmbed;			///< true use #embed, false .incbin
+
+    int Jobs;				///< number of worker threads
+    int PageIndex;			///< true generate page index table
+    int Proportional;			///< true store characters at BBX size
+    int Dedup;				///< true store identical bitmaps once
+    int Compress;			///< true store row-xor rle bitmaps
+    const unsigned char *Subset;	///< bitset of encodings to convert or NULL
+    int SubsetSize;			///< number of encodings in Subset
+    int SubsetOwned;			///< true Subset was malloc'ed by bdf2c
+    const char *Cache;			///< binary cache file name or NULL
+    int Stats;				///< print statistics, STATS_TEXT or STATS_JSON
+    int Layout;				///< stored bitmap layout, LAYOUT_ROWS ...
+    int Rotate;				///< clockwise rotation 0, 90, 180 or 270
+    int Bpp;				///< bits per stored pixel, 0 or 1 mono
+    int Downscale;			///< box filter factor, 0 or 1 none
+    int Metrics;			///< true generate metrics table
+    const BdfKerning *Kerning;		///< kerning pairs sorted by encodings
+    int KerningSize;			///< number of kerning pairs
+    int Shard;				///< encodings per C source, 0 one file
+    const char *Atlas;			///< atlas texture file name or NULL
+    const char *AtlasJson;		///< atlas json file name or NULL
+    int AtlasSize;			///< largest atlas page size
+    const char *FontImage;		///< font image file name or NULL
+    int ImageLongSize;			///< bytes of unsigned long of image target
+    int ImageBigEndian;			///< true image target is big endian
+} BdfOptions;
+
+#define STATS_TEXT 1			///< --stats as table
+#define STATS_JSON 2			///< --stats=json as one json object
+
+#define LAYOUT_ROWS 0			///< rows, left pixel in bit 7
+#define LAYOUT_ROWS_LSB 1		///< rows, left pixel in bit 0
+#define LAYOUT_PAGES 2			///< columns of 8 pixels, top in bit 0
+
+///
+///	Write function of emitted output, returns 0 on success.
+///
+typedef int (*Bdf2cWrite) (void *user, const void *data, size_t n);
+
+///
+///	Output destination of Bdf2cEmit().
+///
+typedef struct _bdf2c_sink_ {
+    Bdf2cWrite Write;			///< write function
+    void *User;				///< user data of write function
+} Bdf2cSink;
+
+///
+///	Memory buffer for Bdf2cBufferWrite().
+///
+///	Without Fixed the buffer grows with realloc(), a zero initialized
+///	buffer starts empty and must be freed by the caller.  A Fixed
+///	caller buffer of Size bytes fails when it is full.
+///
+typedef struct _bdf2c_buffer_ {
+    char *Data;				///< buffer
+    size_t Size;			///< size of buffer
+    size_t Used;			///< bytes written to buffer
+    int Fixed;				///< true don't grow buffer
+} Bdf2cBuffer;
+
+///
+///	Output destinations of Bdf2cEmitSinks(), NULL members drop the
+///	output.  Without Atlas, AtlasJson or Image sink they are written to
+///	the files named by the options.
+///
+typedef struct _bdf2c_sinks_ {
+    const Bdf2cSink *Source;		///< C source
+    const Bdf2cSink *Binary;		///< raw bitmap of BinaryFile
+    const Bdf2cSink *Preview;		///< preview picture
+    const Bdf2cSink *Atlas;		///< atlas pages, one after another
+    const Bdf2cSink *AtlasJson;		///< atlas json description
+    const Bdf2cSink *Image;		///< font image of FontImage
+} Bdf2cSinks;
+
+    /// parsed font, the decoded characters and metrics
+typedef struct _bdf2c_font_ Bdf2cFont;
+
+    /// set default options
+extern BDF2C_API void Bdf2cOptionsInit(BdfOptions *);
+
+    /// write function appending to a Bdf2cBuffer
+extern BDF2C_API int Bdf2cBufferWrite(void *, const void *, size_t);
+
+    /// parse font from memory buffer
+extern BDF2C_API Bdf2cFont *Bdf2cParse(const BdfOptions *, const void *,
+    size_t, char *, size_t);
+
+    /// emit C source, raw bitmap and preview of parsed font
+extern BDF2C_API int Bdf2cEmit(const Bdf2cFont *, const BdfOptions *,
+    const Bdf2cSink *, const Bdf2cSink *, const Bdf2cSink *, char *, size_t);
+
+    /// emit C source, raw bitmap, preview, atlas and image of parsed font
+extern BDF2C_API int Bdf2cEmitSinks(const Bdf2cFont *, const BdfOptions *,
+    const Bdf2cSinks *, char *, size_t);
+
+    /// free parsed font
+extern BDF2C_API void Bdf2cFontFree(Bdf2cFont *);
+
+/// @}
+
+#endif // _LIBBDF2C_H
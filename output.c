@@ -0,0 +1,317 @@
+///
+///	@file output.c		@brief buffered output of generated sources
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup output Output
+///
+///	The generated C source is collected in a large buffer and written
+///	with a single fwrite() per block, large blocks bypass the stdio
+///	buffer.  Integers are formatted without printf, bitmap bytes are
+///	rendered from a precomputed table.
+///
+/// @{
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+
+#include "output.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// bit of byte as human readable character
+#define OUTPUT_BIT(i, m) (((i) & (m)) ? 'X' : '_')
+
+/// one byte as human readable token
+#define OUTPUT_TOKEN(i) { \
+    OUTPUT_BIT(i, 0x80), OUTPUT_BIT(i, 0x40), OUTPUT_BIT(i, 0x20), \
+    OUTPUT_BIT(i, 0x10), OUTPUT_BIT(i, 0x08), OUTPUT_BIT(i, 0x04), \
+    OUTPUT_BIT(i, 0x02), OUTPUT_BIT(i, 0x01), ',' }
+#define OUTPUT_TOKEN4(i) OUTPUT_TOKEN(i), OUTPUT_TOKEN(i + 1), \
+    OUTPUT_TOKEN(i + 2), OUTPUT_TOKEN(i + 3)
+#define OUTPUT_TOKEN16(i) OUTPUT_TOKEN4(i), OUTPUT_TOKEN4(i + 4), \
+    OUTPUT_TOKEN4(i + 8), OUTPUT_TOKEN4(i + 12)
+#define OUTPUT_TOKEN64(i) OUTPUT_TOKEN16(i), OUTPUT_TOKEN16(i + 16), \
+    OUTPUT_TOKEN16(i + 32), OUTPUT_TOKEN16(i + 48)
+
+const char OutputByteToken[256][9] = {
+    OUTPUT_TOKEN64(0), OUTPUT_TOKEN64(64),
+    OUTPUT_TOKEN64(128), OUTPUT_TOKEN64(192)
+};
+
+///
+///	Open output buffer for file stream.
+///
+///	@param out	output buffer
+///	@param file	file stream for output, NULL to collect all output in
+///			memory
+///
+void OutputOpen(Output * out, FILE * file)
+{
+    out->Size = file ? OUTPUT_BLOCK_SIZE : OUTPUT_BLOCK_SIZE / 16;
+    out->Used = 0;
+    out->File = file;
+    out->Writer = NULL;
+    out->User = NULL;
+    out->Failed = 0;
+    out->Written = 0;
+    out->Writes = 0;
+    if (!(out->Buffer = malloc(out->Size))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+}
+
+///
+///	Open output buffer for write function.
+///
+///	@param out	output buffer
+///	@param writer	write function, gets each block of output
+///	@param user	user data of write function
+///
+void OutputOpenWriter(Output * out, OutputWriter writer, void *user)
+{
+    OutputOpen(out, NULL);
+    out->Writer = writer;
+    out->User = user;
+}
+
+///
+///	Write buffered data to file stream or write function.
+///
+///	@param out	output buffer
+///
+void OutputFlush(Output * out)
+{
+    if (out->Writer) {
+	if (out->Used && !out->Failed) {
+	    out->Failed = out->Writer(out->User, out->Buffer, out->Used) != 0;
+	    out->Written += out->Used;
+	    out->Writes++;
+	}
+	out->Used = 0;
+	return;
+    }
+    if (!out->File) {			// memory output keeps its data
+	return;
+    }
+    if (out->Used && fwrite(out->Buffer, 1, out->Used, out->File)
+	!= out->Used) {
+	fprintf(stderr, "Can't write output: %s\n", strerror(errno));
+	exit(-1);
+    }
+    if (out->Used) {
+	out->Written += out->Used;
+	out->Writes++;
+    }
+    out->Used = 0;
+}
+
+///
+///	Flush and free output buffer.
+///
+///	@param out	output buffer
+///
+void OutputClose(Output * out)
+{
+    if (out->File) {
+	OutputFlush(out);
+	fflush(out->File);
+    } else if (out->Writer) {
+	OutputFlush(out);
+    }
+    free(out->Buffer);
+    out->Buffer = NULL;
+    out->Size = 0;
+}
+
+///
+///	Make room for n bytes, called by OutputReserve().
+///
+///	@param out	output buffer
+///	@param n	number of bytes needed
+///
+void OutputGrow(Output * out, size_t n)
+{
+    OutputFlush(out);
+    if (out->Used + n > out->Size) {
+	out->Size *= 2;
+	if (out->Size < out->Used + n) {
+	    out->Size = out->Used + n;
+	}
+	if (!(out->Buffer = realloc(out->Buffer, out->Size))) {
+	    fprintf(stderr, "Out of memory\n");
+	    exit(-1);
+	}
+    }
+}
+
+///
+///	Write unsigned integer in decimal.
+///
+///	@param out	output buffer
+///	@param u	integer to write
+///
+void OutputUnsigned(Output * out, unsigned u)
+{
+    char buf[16];
+    char *s;
+
+    s = buf + sizeof(buf);
+    do {
+	*--s = '0' + u % 10;
+	u /= 10;
+    } while (u);
+    OutputWrite(out, s, buf + sizeof(buf) - s);
+}
+
+///
+///	Write integer in decimal, right aligned like printf "%*d".
+///
+///	@param out	output buffer
+///	@param i	integer to write
+///	@param width	minimum field width
+///
+void OutputIntPadded(Output * out, int i, int width)
+{
+    char buf[16];
+    char *s;
+    unsigned u;
+
+    u = i < 0 ? -(unsigned)i : (unsigned)i;
+    s = buf + sizeof(buf);
+    do {
+	*--s = '0' + u % 10;
+	u /= 10;
+    } while (u);
+    if (i < 0) {
+	*--s = '-';
+    }
+    while (buf + sizeof(buf) - s < width) {
+	*--s = ' ';
+    }
+    OutputWrite(out, s, buf + sizeof(buf) - s);
+}
+
+///
+///	Write integer in decimal.
+///
+///	@param out	output buffer
+///	@param i	integer to write
+///
+void OutputInt(Output * out, int i)
+{
+    OutputIntPadded(out, i, 0);
+}
+
+///
+///	Write unsigned integer in lower case hex, like printf "%0*x".
+///
+///	@param out	output buffer
+///	@param u	integer to write
+///	@param digits	minimum number of digits
+///
+void OutputHex(Output * out, unsigned u, int digits)
+{
+    char buf[16];
+    char *s;
+
+    s = buf + sizeof(buf);
+    do {
+	*--s = "0123456789abcdef"[u & 15];
+	u >>= 4;
+    } while (u || buf + sizeof(buf) - s < digits);
+    OutputWrite(out, s, buf + sizeof(buf) - s);
+}
+
+///
+///	Write string as quoted JSON string.
+///
+///	Quote, backslash and control characters are escaped, all other
+///	bytes are written unchanged.
+///
+///	@param out	output buffer
+///	@param s	string to write
+///
+void OutputJsonString(Output * out, const char *s)
+{
+    const unsigned char *p;
+
+    OutputChar(out, '"');
+    for (p = (const unsigned char *)s; *p; ++p) {
+	switch (*p) {
+	    case '"':
+	    case '\\':
+		OutputChar(out, '\\');
+		OutputChar(out, *p);
+		break;
+	    case '\n':
+		OutputString(out, "\\n");
+		break;
+	    case '\t':
+		OutputString(out, "\\t");
+		break;
+	    default:
+		if (*p < 0x20) {
+		    OutputString(out, "\\u00");
+		    OutputHex(out, *p, 2);
+		} else {
+		    OutputChar(out, *p);
+		}
+		break;
+	}
+    }
+    OutputChar(out, '"');
+}
+
+///
+///	Formatted output, for the rarely written parts.
+///
+///	@param out	output buffer
+///	@param fmt	printf format
+///
+void OutputPrintf(Output * out, const char *fmt, ...)
+{
+    va_list ap;
+    size_t room;
+    int n;
+
+    room = out->Size - out->Used;
+    va_start(ap, fmt);
+    n = vsnprintf(out->Buffer + out->Used, room, fmt, ap);
+    va_end(ap);
+    if (n >= 0 && (size_t) n >= room) {
+	OutputReserve(out, n + 1);
+	va_start(ap, fmt);
+	n = vsnprintf(out->Buffer + out->Used, n + 1, fmt, ap);
+	va_end(ap);
+    }
+    if (n < 0) {
+	fprintf(stderr, "Can't format output\n");
+	exit(-1);
+    }
+    out->Used += n;
+}
+
+/// @}
@@ -0,0 +1,138 @@
+///
+///	@file output.h		@brief buffered output of generated sources
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef _OUTPUT_H
+#define _OUTPUT_H
+
+#include <stdio.h>
+#include <string.h>
+
+#define OUTPUT_BLOCK_SIZE (256 * 1024)	///< bytes written per block
+
+///
+///	Output buffer.
+///
+///	Data is collected in a large buffer and written in blocks to the
+///	file stream or the write function.  Without both the buffer grows
+///	and keeps all data.
+///
+///	The write function gets the user data, the bytes and their number
+///	and returns 0 on success.  After an error OutputError() is true and
+///	all further data is dropped.
+///
+typedef int (*OutputWriter) (void *, const void *, size_t);
+
+typedef struct _output_ {
+    char *Buffer;			///< output buffer
+    size_t Size;			///< size of output buffer
+    size_t Used;			///< bytes used in output buffer
+    FILE *File;				///< file stream for output or NULL
+    OutputWriter Writer;		///< write function or NULL
+    void *User;				///< user data of write function
+    int Failed;				///< true write function failed
+    size_t Written;			///< bytes written to file stream
+    unsigned Writes;			///< blocks written to file stream
+} Output;
+
+    /// check if write function failed
+#define OutputError(out) ((out)->Failed)
+
+    /// rendered bitmap byte for human readable fonts "XX__X___,"
+extern const char OutputByteToken[256][9];
+
+extern void OutputOpen(Output *, FILE *);
+extern void OutputOpenWriter(Output *, OutputWriter, void *);
+extern void OutputFlush(Output *);
+extern void OutputClose(Output *);
+extern void OutputGrow(Output *, size_t);
+
+extern void OutputUnsigned(Output *, unsigned);
+extern void OutputInt(Output *, int);
+extern void OutputIntPadded(Output *, int, int);
+extern void OutputHex(Output *, unsigned, int);
+extern void OutputJsonString(Output *, const char *);
+extern void OutputPrintf(Output *, const char *, ...)
+    __attribute__ ((format(printf, 2, 3)));
+
+///
+///	Reserve space in output buffer.
+///
+///	@param out	output buffer
+///	@param n	number of bytes needed
+///
+///	@returns pointer to free space of at least n bytes.
+///
+static inline char *OutputReserve(Output * out, size_t n)
+{
+    if (out->Used + n > out->Size) {
+	OutputGrow(out, n);
+    }
+    return out->Buffer + out->Used;
+}
+
+///
+///	Discard buffered data, for reuse of memory output.
+///
+///	@param out	output buffer
+///
+static inline void OutputReset(Output * out)
+{
+    out->Used = 0;
+}
+
+///
+///	Write bytes.
+///
+///	@param out	output buffer
+///	@param data	bytes to write
+///	@param n	number of bytes
+///
+static inline void OutputWrite(Output * out, const void *data, size_t n)
+{
+    memcpy(OutputReserve(out, n), data, n);
+    out->Used += n;
+}
+
+///
+///	Write string.
+///
+///	@param out	output buffer
+///	@param s	string to write
+///
+static inline void OutputString(Output * out, const char *s)
+{
+    OutputWrite(out, s, strlen(s));
+}
+
+///
+///	Write character.
+///
+///	@param out	output buffer
+///	@param c	character to write
+///
+static inline void OutputChar(Output * out, int c)
+{
+    *OutputReserve(out, 1) = c;
+    out->Used++;
+}
+
+#endif // _OUTPUT_H
@@ -8,6 +8,7 @@
  */
 
 #include <string.h>
+#include <strings.h> // strcasecmp
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -18,12 +19,23 @@
 
 #include "ppmhdr.h"
 
-// bit: ignored
+// bit: bits per pixel, PPM_CAVAS_MONO, PPM_CAVAS_INDEX or PPM_CAVAS_ARGB
 ppm_cavas_t *
 ppm_cavas_resize (ppm_cavas_t * pppm, size_t x, size_t y, size_t bit)
 {
-    size_t sz = x * y * 4;
+    size_t stride;
+    size_t sz;
     char flg_newmem = 1;
+
+    if (PPM_CAVAS_MONO == bit) {
+        stride = (x + 7) / 8;
+    } else if (PPM_CAVAS_INDEX == bit) {
+        stride = x;
+    } else {
+        bit = PPM_CAVAS_ARGB;
+        stride = x * 4;
+    }
+    sz = stride * y;
     if (NULL != pppm) {
         if (pppm->buffer_size >= sz) {
             flg_newmem = 0;
@@ -39,7 +51,8 @@ ppm_cavas_resize (ppm_cavas_t * pppm, size_t x, size_t y, size_t bit)
     }
     pppm->xmax = x;
     pppm->ymax = y;
-    pppm->bit  = bit = 8;
+    pppm->bit  = bit;
+    pppm->stride = stride;
     pppm->buffer_size = sz;
     return pppm;
 }
@@ -53,9 +66,7 @@ ppm_cavas_destroy(ppm_cavas_t * p)
 void
 ppm_cavas_zero (ppm_cavas_t * p)
 {
-    size_t sz;
-    sz = p->xmax * p->ymax * 4;
-    memset (p->buffer, 0, sz);
+    memset (p->buffer, 0, p->stride * p->ymax);
 }
 
 void
@@ -64,6 +75,7 @@ ppm_cavas_fill (ppm_cavas_t * pppm,  uint8_t color[4])
     uint8_t *pend;
     uint8_t *p;
     size_t sz;
+    assert (PPM_CAVAS_ARGB == pppm->bit);
     //uint32_t val = (((uint32_t)color[3]) << 24) | (((uint32_t)color[2]) << 16) | (((uint32_t)color[1]) << 8) | ((uint32_t)color[3]);
 
     sz = pppm->xmax * pppm->ymax * 4;
@@ -155,13 +167,434 @@ ppm_cavas_bitblit (ppm_cavas_t *dest, ppm_cavas_t *src, size_t dx, size_t dy, si
     return 0;
 }
 
+// set pixel of a mono or indexed cavas, without range check
+static inline void
+ppm_cavas_set (ppm_cavas_t * pppm, size_t x, size_t y, uint8_t val)
+{
+    uint8_t *p;
+    if (PPM_CAVAS_MONO == pppm->bit) {
+        p = pppm->buffer + y * pppm->stride + x / 8;
+        if (val) {
+            *p |= 0x80 >> (x % 8);
+        } else {
+            *p &= ~(0x80 >> (x % 8));
+        }
+        return;
+    }
+    pppm->buffer[y * pppm->stride + x] = val;
+}
+
+// val: the color index, or the bit for mono cavas
+int
+ppm_cavas_pixel_index (ppm_cavas_t * pppm, size_t x, size_t y, uint8_t val)
+{
+    assert (NULL != pppm);
+    assert (PPM_CAVAS_ARGB != pppm->bit);
+    if ((x >= pppm->xmax) || (y >= pppm->ymax)) {
+        fprintf (stderr, "Warning: out of range: max(%zu,%zu) <= in(%zu,%zu)\n", pppm->xmax, pppm->ymax, x, y);
+        return -1;
+    }
+    ppm_cavas_set (pppm, x, y, val);
+    return 0;
+}
+
+// fill the rectangle of a mono or indexed cavas, clipped
+void
+ppm_cavas_fill_rect (ppm_cavas_t * pppm, size_t x, size_t y, size_t wx, size_t hy, uint8_t val)
+{
+    size_t i;
+    size_t j;
+    assert (PPM_CAVAS_ARGB != pppm->bit);
+    if ((x >= pppm->xmax) || (y >= pppm->ymax)) {
+        return;
+    }
+    if (x + wx > pppm->xmax) {
+        wx = pppm->xmax - x;
+    }
+    if (y + hy > pppm->ymax) {
+        hy = pppm->ymax - y;
+    }
+    for (i = y; i < y + hy; i ++) {
+        if (PPM_CAVAS_INDEX == pppm->bit) {
+            memset (pppm->buffer + i * pppm->stride + x, val, wx);
+            continue;
+        }
+        for (j = x; j < x + wx; j ++) {
+            ppm_cavas_set (pppm, j, i, val);
+        }
+    }
+}
+
+// draw a 1 bit bitmap (MSB first, rows padded to bytes) into a mono or
+// indexed cavas, one row at a time, clipped
+void
+ppm_cavas_blit_bitmap (ppm_cavas_t * dest, size_t dx, size_t dy, const uint8_t *bitmap, size_t width, size_t height, uint8_t c_dot, uint8_t c_background)
+{
+    const uint8_t *src;
+    uint8_t *p;
+    size_t stride;
+    size_t wx;
+    size_t i;
+    size_t j;
+    unsigned bits;
+    unsigned mask;
+    unsigned shift;
+
+    assert (PPM_CAVAS_ARGB != dest->bit);
+    if ((dx >= dest->xmax) || (dy >= dest->ymax)) {
+        return;
+    }
+    stride = (width + 7) / 8;
+    wx = width;
+    if (dx + wx > dest->xmax) {
+        wx = dest->xmax - dx;
+    }
+    if (dy + height > dest->ymax) {
+        height = dest->ymax - dy;
+    }
+    for (i = 0; i < height; i ++) {
+        src = bitmap + i * stride;
+        p = dest->buffer + (dy + i) * dest->stride;
+        if (PPM_CAVAS_INDEX == dest->bit) {
+            p += dx;
+            for (j = 0; j < wx; j ++) {
+                p[j] = (src[j / 8] & (0x80 >> (j % 8))) ? c_dot : c_background;
+            }
+            continue;
+        }
+        // mono: merge the shifted source bytes into the destination row
+        p += dx / 8;
+        shift = dx % 8;
+        for (j = 0; j < wx; j += 8) {
+            bits = src[j / 8];
+            if (c_dot == c_background) {
+                bits = c_dot ? 0xFF : 0x00;
+            } else if (! c_dot) {
+                bits = ~bits & 0xFF;
+            }
+            // the mask of the pixels left in the row
+            mask = 0xFF00;
+            if (wx - j < 8) {
+                mask = (0xFF00 << (8 - (wx - j))) & 0xFF00;
+            }
+            mask >>= shift;
+            bits = ((bits << 8) >> shift) & mask;
+            p[0] = (p[0] & ~(mask >> 8)) | (bits >> 8);
+            if (mask & 0xFF) {
+                p[1] = (p[1] & ~mask) | (bits & 0xFF);
+            }
+            p ++;
+        }
+    }
+}
+
+// write the cavas as binary ppm (P6) to a stream, indexed and mono cavas through the palette
+int
+ppm_cavas_fwrite_ppm (ppm_cavas_t * pppm, FILE * fp, const uint8_t palette[][4])
+{
+    uint8_t *row;
+    uint8_t *p;
+    const uint8_t *c;
+    size_t x;
+    size_t y;
+    int ret = 0;
+
+    row = malloc (pppm->xmax * 3 + 1);
+    if (NULL == row) {
+        return -1;
+    }
+    fprintf (fp, "P6\n%zu %zu %d\n", pppm->xmax, pppm->ymax, 255);
+    for (y = 0; y < pppm->ymax; y ++) {
+        p = row;
+        for (x = 0; x < pppm->xmax; x ++) {
+            if (PPM_CAVAS_ARGB == pppm->bit) {
+                c = pppm->buffer + y * pppm->stride + x * 4;
+            } else if (PPM_CAVAS_INDEX == pppm->bit) {
+                c = palette[pppm->buffer[y * pppm->stride + x]];
+            } else {
+                c = palette[(pppm->buffer[y * pppm->stride + x / 8] >> (7 - x % 8)) & 1];
+            }
+            *p ++ = c[1];
+            *p ++ = c[2];
+            *p ++ = c[3];
+        }
+        if (fwrite (row, 3, pppm->xmax, fp) != pppm->xmax) {
+            ret = -1;
+            break;
+        }
+    }
+    free (row);
+    return ret;
+}
+
+// write the cavas as binary ppm (P6), indexed and mono cavas through the palette
+int
+ppm_cavas_write_ppm (ppm_cavas_t * pppm, const char * filename, const uint8_t palette[][4])
+{
+    FILE *fp;
+    int ret;
+
+    fp = fopen (filename, "wb");
+    if (NULL == fp) {
+        perror ("create file");
+        return -1;
+    }
+    ret = ppm_cavas_fwrite_ppm (pppm, fp, palette);
+    if (0 != fclose (fp)) {
+        ret = -1;
+    }
+    return ret;
+}
+
+// write a mono cavas as binary pbm (P4) to a stream, a set bit is black
+int
+ppm_cavas_fwrite_pbm (ppm_cavas_t * pppm, FILE * fp)
+{
+    assert (PPM_CAVAS_MONO == pppm->bit);
+    fprintf (fp, "P4\n%zu %zu\n", pppm->xmax, pppm->ymax);
+    // the rows have the same layout as in the file
+    if (fwrite (pppm->buffer, pppm->stride, pppm->ymax, fp) != pppm->ymax) {
+        return -1;
+    }
+    return 0;
+}
+
+// write a mono cavas as binary pbm (P4), a set bit is black
+int
+ppm_cavas_write_pbm (ppm_cavas_t * pppm, const char * filename)
+{
+    FILE *fp;
+    int ret;
+
+    fp = fopen (filename, "wb");
+    if (NULL == fp) {
+        perror ("create file");
+        return -1;
+    }
+    ret = ppm_cavas_fwrite_pbm (pppm, fp);
+    if (0 != fclose (fp)) {
+        ret = -1;
+    }
+    return ret;
+}
+
+// write an indexed cavas as binary pgm (P5), the values are the gray levels
+int
+ppm_cavas_fwrite_pgm (ppm_cavas_t * pppm, FILE * fp)
+{
+    assert (PPM_CAVAS_INDEX == pppm->bit);
+    fprintf (fp, "P5\n%zu %zu\n255\n", pppm->xmax, pppm->ymax);
+    if (fwrite (pppm->buffer, pppm->stride, pppm->ymax, fp) != pppm->ymax) {
+        return -1;
+    }
+    return 0;
+}
+
+// write an indexed cavas as binary pgm (P5)
+int
+ppm_cavas_write_pgm (ppm_cavas_t * pppm, const char * filename)
+{
+    FILE *fp;
+    int ret;
+
+    fp = fopen (filename, "wb");
+    if (NULL == fp) {
+        perror ("create file");
+        return -1;
+    }
+    ret = ppm_cavas_fwrite_pgm (pppm, fp);
+    if (0 != fclose (fp)) {
+        ret = -1;
+    }
+    return ret;
+}
+
+// the state of png writer
+typedef struct _png_writer_t {
+    FILE *fp;
+    uint32_t crc_table[256];
+    uint32_t crc; // crc of the current chunk
+    uint32_t adler_a;
+    uint32_t adler_b;
+    size_t raw_left; // bytes left in the zlib stream
+    size_t block_left; // bytes left in the current stored block
+} png_writer_t;
+
+static void
+png_put (png_writer_t *w, const uint8_t *data, size_t len)
+{
+    size_t i;
+    for (i = 0; i < len; i ++) {
+        w->crc = w->crc_table[(w->crc ^ data[i]) & 0xFF] ^ (w->crc >> 8);
+    }
+    fwrite (data, 1, len, w->fp);
+}
+
+static void
+png_put32 (png_writer_t *w, uint32_t val)
+{
+    uint8_t buf[4];
+    buf[0] = val >> 24;
+    buf[1] = val >> 16;
+    buf[2] = val >> 8;
+    buf[3] = val;
+    png_put (w, buf, 4);
+}
+
+static void
+png_chunk_begin (png_writer_t *w, const char *type, size_t len)
+{
+    png_put32 (w, len);
+    w->crc = 0xFFFFFFFF;
+    png_put (w, (const uint8_t *)type, 4);
+}
+
+static void
+png_chunk_end (png_writer_t *w)
+{
+    png_put32 (w, w->crc ^ 0xFFFFFFFF);
+}
+
+// put image data into stored (uncompressed) deflate blocks
+static void
+png_stored (png_writer_t *w, const uint8_t *data, size_t len)
+{
+    uint8_t hdr[5];
+    size_t n;
+    size_t i;
+
+    while (len > 0) {
+        if (0 == w->block_left) {
+            n = w->raw_left < 65535 ? w->raw_left : 65535;
+            hdr[0] = n == w->raw_left; // last block
+            hdr[1] = n;
+            hdr[2] = n >> 8;
+            hdr[3] = ~n;
+            hdr[4] = ~n >> 8;
+            png_put (w, hdr, 5);
+            w->block_left = n;
+        }
+        n = len < w->block_left ? len : w->block_left;
+        png_put (w, data, n);
+        for (i = 0; i < n; i ++) {
+            w->adler_a += data[i];
+            if (w->adler_a >= 65521) {
+                w->adler_a -= 65521;
+            }
+            w->adler_b += w->adler_a;
+            if (w->adler_b >= 65521) {
+                w->adler_b -= 65521;
+            }
+        }
+        w->block_left -= n;
+        w->raw_left -= n;
+        data += n;
+        len -= n;
+    }
+}
+
+// write a mono or indexed cavas as paletted png to a stream, the image data isn't compressed
+// without palette the values are the gray levels
+int
+ppm_cavas_fwrite_png (ppm_cavas_t * pppm, FILE * fp, const uint8_t palette[][4], size_t num_colors)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    static const uint8_t zlib_header[2] = {0x78, 0x01};
+    static const uint8_t filter_none[1] = {0};
+    png_writer_t w;
+    uint8_t buf[13];
+    size_t raw;
+    size_t blocks;
+    size_t i;
+    uint32_t c;
+    int k;
+    int ret = 0;
+
+    assert (PPM_CAVAS_ARGB != pppm->bit);
+    memset (&w, 0, sizeof(w));
+    for (i = 0; i < 256; i ++) {
+        c = i;
+        for (k = 0; k < 8; k ++) {
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        }
+        w.crc_table[i] = c;
+    }
+    w.fp = fp;
+    fwrite (signature, 1, sizeof(signature), w.fp);
+
+    png_chunk_begin (&w, "IHDR", 13);
+    png_put32 (&w, pppm->xmax);
+    png_put32 (&w, pppm->ymax);
+    buf[0] = pppm->bit; // bit depth
+    buf[1] = NULL == palette ? 0 : 3; // color type: gray or palette
+    buf[2] = 0; // deflate
+    buf[3] = 0; // adaptive filter
+    buf[4] = 0; // no interlace
+    png_put (&w, buf, 5);
+    png_chunk_end (&w);
+
+    if (NULL != palette) {
+        png_chunk_begin (&w, "PLTE", num_colors * 3);
+        for (i = 0; i < num_colors; i ++) {
+            png_put (&w, palette[i] + 1, 3);
+        }
+        png_chunk_end (&w);
+    }
+
+    // each row starts with its filter type
+    raw = (pppm->stride + 1) * pppm->ymax;
+    blocks = (raw + 65534) / 65535;
+    if (0 == blocks) {
+        blocks = 1;
+    }
+    png_chunk_begin (&w, "IDAT", 2 + blocks * 5 + raw + 4);
+    png_put (&w, zlib_header, 2);
+    w.adler_a = 1;
+    w.adler_b = 0;
+    w.raw_left = raw;
+    w.block_left = 0;
+    for (i = 0; i < pppm->ymax; i ++) {
+        png_stored (&w, filter_none, 1);
+        png_stored (&w, pppm->buffer + i * pppm->stride, pppm->stride);
+    }
+    png_put32 (&w, (w.adler_b << 16) | w.adler_a);
+    png_chunk_end (&w);
+
+    png_chunk_begin (&w, "IEND", 0);
+    png_chunk_end (&w);
+    if (ferror (w.fp)) {
+        ret = -1;
+    }
+    return ret;
+}
+
+// write a mono or indexed cavas as paletted png, the image data isn't compressed
+int
+ppm_cavas_write_png (ppm_cavas_t * pppm, const char * filename, const uint8_t palette[][4], size_t num_colors)
+{
+    FILE *fp;
+    int ret;
+
+    fp = fopen (filename, "wb");
+    if (NULL == fp) {
+        perror ("create file");
+        return -1;
+    }
+    ret = ppm_cavas_fwrite_png (pppm, fp, palette, num_colors);
+    if (0 != fclose (fp)) {
+        ret = -1;
+    }
+    return ret;
+}
+
+// the pixels are copied into the memory of the file, ppm_close() writes them out
 int
 ppm_bitblit_from (ppm_file_t *fp_dest, ppm_cavas_t *src, size_t dx, size_t dy, size_t sx, size_t sy, size_t wx, size_t hy)
 {
     size_t i;
     size_t j;
     uint8_t *p1;
-    off_t p2;
+    uint8_t *p2;
     if (dx >= fp_dest->xmax) {
         return -1;
     }
@@ -191,16 +624,18 @@ ppm_bitblit_from (ppm_file_t *fp_dest, ppm_cavas_t *src, size_t dx, size_t dy, s
     }
     for (i = 0; i < hy; i ++) {
         p1 = src->buffer;
-        p2 = fp_dest->off_data;
+        p2 = fp_dest->data;
         p1 += (PPM_CAVAS_BUFF_OFFSET(src, sx, sy + i) * 4);
         p2 += (PPM_CAVAS_BUFF_OFFSET(fp_dest, dx, dy + i) * 3);
-        fseek(fp_dest->fp, p2, SEEK_SET);
         for (j = 0; j < wx; j ++) {
-            fwrite (&(p1[1]), 3, 1, fp_dest->fp);
+            p2[0] = p1[1];
+            p2[1] = p1[2];
+            p2[2] = p1[3];
             p1 += 4;
-            //off += 3;
+            p2 += 3;
         }
     }
+    fp_dest->flg_dirty = 1;
     return 0;
 }
 
@@ -209,7 +644,7 @@ ppm_bitblit_to (ppm_cavas_t *dest, ppm_file_t *fp_src, size_t dx, size_t dy, siz
 {
     size_t i;
     size_t j;
-    off_t p1;
+    uint8_t *p1;
     uint8_t *p2;
     if (dx >= dest->xmax) {
         return -1;
@@ -239,16 +674,17 @@ ppm_bitblit_to (ppm_cavas_t *dest, ppm_file_t *fp_src, size_t dx, size_t dy, siz
         return 0;
     }
     for (i = 0; i < hy; i ++) {
-        p1 = fp_src->off_data;
+        p1 = fp_src->data;
         p2 = dest->buffer;
         p1 += (PPM_CAVAS_BUFF_OFFSET(fp_src, sx, sy + i) * 3);
         p2 += (PPM_CAVAS_BUFF_OFFSET(dest, dx, dy + i) * 4);
-        fseek(fp_src->fp, p1, SEEK_SET);
         for (j = 0; j < wx; j ++) {
-            fread (&(p2[1]), 3, 1, fp_src->fp);
             p2[0] = 0;
+            p2[1] = p1[0];
+            p2[2] = p1[1];
+            p2[3] = p1[2];
+            p1 += 3;
             p2 += 4;
-            //off += 3;
         }
     }
     return 0;
@@ -270,6 +706,16 @@ ppm_load (ppm_file_t *fp, const char * filename)
     fp->xmax = x;
     fp->ymax = y;
     fp->depth = d;
+    fp->off_data = ftell (fp->fp);
+    fp->flg_dirty = 0;
+    // read all pixels with one call
+    fp->data = calloc (x * y, 3);
+    if (NULL == fp->data) {
+        fclose (fp->fp);
+        fp->fp = NULL;
+        return -1;
+    }
+    fread (fp->data, 3, x * y, fp->fp);
     return 0;
 }
 
@@ -293,16 +739,36 @@ ppm_create (ppm_file_t *fp, const char * filename, size_t x, size_t y, size_t de
     fprintf(fp->fp, "P6\n");
     fprintf(fp->fp, "%lu %lu %lu\n", x, y, depth);
     fp->off_data = ftell (fp->fp);
-    ftruncate (fileno(fp->fp), fp->off_data + x * y * 3 );
+    // the picture is drawn in memory, and written sequentially on close
+    fp->data = calloc (x * y, 3);
+    if (NULL == fp->data) {
+        fclose (fp->fp);
+        fp->fp = NULL;
+        return -1;
+    }
+    fp->flg_dirty = 1;
     return 0;
 }
 
 int
 ppm_close (ppm_file_t *fp)
 {
-    fclose (fp->fp);
+    int ret = 0;
+    if (NULL == fp->fp) {
+        return -1;
+    }
+    if (fp->flg_dirty) {
+        fseek (fp->fp, fp->off_data, SEEK_SET);
+        if (fwrite (fp->data, 3, fp->xmax * fp->ymax, fp->fp) != fp->xmax * fp->ymax) {
+            ret = -1;
+        }
+    }
+    if (0 != fclose (fp->fp)) {
+        ret = -1;
+    }
+    free (fp->data);
     memset (fp, 0, sizeof(*fp));
-    return 0;
+    return ret;
 }
 
 void
@@ -340,68 +806,95 @@ DumpCharacter2Cavas(ppm_cavas_t * out, size_t offx, size_t offy, uint8_t *bitmap
 // the boarder of item
 #define PPM_FNT_BORDER 1
 
-ppm_file_t fd;
-ppm_cavas_t * chbuf = NULL;
-size_t current_num = 0;
-size_t pic_xnum = 0;
-size_t pic_ynum = 0;
-size_t char_wx = 0;
-size_t char_hy = 0;
+// the colors of the preview picture
+enum {
+    PIC_COLOR_EMPTY,
+    PIC_COLOR_BACKGROUND,
+    PIC_COLOR_DOT,
+    PIC_COLOR_LINE,
+    PIC_COLOR_SHIFT,
+    PIC_COLOR_NUM,
+};
+#define PIC_COLOR_NONE PIC_COLOR_SHIFT
 
+// 0-A, 1-R, 2-G, 3-B
+static const uint8_t pic_palette[PIC_COLOR_NUM][4] = {
+    {0,   0,   0,   0}, // empty
+    {0, 255, 255, 255}, // background
+    {0,   0,   0, 255}, // dot
+    {0, 190, 190, 190}, // line
+    {0, 255,   0,   0}, // shift, none
+};
+
+// pbm: the picture color to the bit, 1 is black
+static const uint8_t pic_mono_map[PIC_COLOR_NUM] = {0, 0, 1, 1, 1};
+static const uint8_t pic_index_map[PIC_COLOR_NUM] = {0, 1, 2, 3, 4};
+
+// the picture format by the extension of the file name
+static int
+pic_format (const char * filename)
+{
+    const char * ext;
+    ext = strrchr (filename, '.');
+    if (NULL != ext) {
+        if (0 == strcasecmp (ext, ".pbm")) {
+            return BDF2C_FONTPIC_PBM;
+        }
+        if (0 == strcasecmp (ext, ".png")) {
+            return BDF2C_FONTPIC_PNG;
+        }
+    }
+    return BDF2C_FONTPIC_PPM;
+}
+
+// first: the encoding of the first item, the grid starts at a row of it
+// num: the number of items from first
 int
-bdf2c_fontpic_init (const char * filename, size_t num, size_t wx, size_t hy)
+bdf2c_fontpic_init (bdf2c_fontpic_t *pic, const char * filename, size_t first, size_t num, size_t wx, size_t hy)
 {
     size_t width;
     size_t height;
     size_t nextnum;
     size_t bit;
 
-#if 1
-// debug
-if (num < 65536) {
-    num = 65536;
-}
-#endif
-
     bit = 0;
     for (nextnum = 1; nextnum < num; nextnum <<= 1) {
         bit ++;
     }
     bit = (bit + 1) / 2;
     width = 0x1 << bit;
+    // start the grid at the row of the first item
+    num += first % width;
+    first -= first % width;
     height = (num + width - 1) / width;
     assert (width * height >= num);
-    pic_xnum = width;
-    pic_ynum = height;
-    char_wx = wx;
-    char_hy = hy;
-
-    fprintf (stderr, "bit=%zu, num=%zu, w=%zu, h=%zu, wx=%zu, hy=%zu\n", bit, num, width, height, wx, hy);
-    fprintf (stderr, "ppm.xmax=%zu, ppm.ymax=%zu\n", (wx + 2 * PPM_FNT_BORDER) * width + PPM_OFF_X * 2, (hy + 2 * PPM_FNT_BORDER) * height + PPM_OFF_Y * 2);
+    pic->filename = filename;
+    pic->format = pic_format (filename);
+    pic->first_num = first;
+    pic->pic_xnum = width;
+    pic->pic_ynum = height;
+    pic->char_wx = wx;
+    pic->char_hy = hy;
 
-    if (0 != ppm_create (&fd, filename, (wx + 2 * PPM_FNT_BORDER) * width + PPM_OFF_X * 2, (hy + 2 * PPM_FNT_BORDER) * height + PPM_OFF_Y * 2, 255)) {
-        fprintf (stderr, "error in create ppm file out.ppm\n");
-        return -1;
+    // pbm only knows black and white, the others keep the colors in one byte
+    if (BDF2C_FONTPIC_PBM == pic->format) {
+        bit = PPM_CAVAS_MONO;
+        pic->color_map = pic_mono_map;
+    } else {
+        bit = PPM_CAVAS_INDEX;
+        pic->color_map = pic_index_map;
     }
-
-    // +2 lines around box
-    chbuf = ppm_cavas_create (wx+2*PPM_FNT_BORDER, hy+2*PPM_FNT_BORDER, 8);
-    if (NULL == chbuf) {
-        goto fntpic4ppm_error;
+    pic->sheet = ppm_cavas_create ((wx + 2 * PPM_FNT_BORDER) * width + PPM_OFF_X * 2, (hy + 2 * PPM_FNT_BORDER) * height + PPM_OFF_Y * 2, bit);
+    if (NULL == pic->sheet) {
+        fprintf (stderr, "error in create picture %s\n", filename);
+        return -1;
     }
-    current_num = 0;
+    ppm_cavas_zero (pic->sheet);
+    pic->current_num = 0;
     return 0;
-
-fntpic4ppm_error:
-    if (NULL != chbuf) {
-        ppm_cavas_destroy (chbuf);
-    }
-    chbuf = NULL;
-    ppm_close (&fd);
-    return -1;
 }
 
-static uint8_t bitmap_hznone[] = {
+static const uint8_t bitmap_hznone[] = {
     0xff, 0xff,
     0xc0, 0x03,
     0xa0, 0x05,
@@ -420,149 +913,143 @@ static uint8_t bitmap_hznone[] = {
     0xff, 0xff,
 };
 
-static uint8_t color_shift[4] = {0, 255, 0, 0};
-static uint8_t color_none[4] = {0, 255, 0, 0};
-static uint8_t color_line[4] = {0, 190, 190, 190};
-static uint8_t color_dot[4] = {0,   0,   0, 255};
-static uint8_t color_background[4] = {0, 255, 255, 255};;
+#define PIC_PIXEL(pic,x,y,color) ppm_cavas_pixel_index ((pic)->sheet, (x), (y), (pic)->color_map[color])
 
 int
-bdf2c_fontpic_draw_metric ()
+bdf2c_fontpic_draw_metric (bdf2c_fontpic_t *pic)
 {
     size_t i;
-    ppm_cavas_t * buf = NULL;
+    size_t gridx;
+    size_t gridy;
+    size_t offx;
+    size_t offy;
+    ppm_cavas_t * sheet = pic->sheet;
+
+    gridx = (pic->char_wx + 2*PPM_FNT_BORDER) * pic->pic_xnum;
+    gridy = (pic->char_hy + 2*PPM_FNT_BORDER) * pic->pic_ynum;
 
     // x axis
-    buf = ppm_cavas_create ((char_wx + 2*PPM_FNT_BORDER) * pic_xnum + PPM_OFF_X * 2, PPM_OFF_Y, 8);
-    if (NULL == buf) {
-        printf ("error in malloc memory\n");
-        return -1;
-    }
-    ppm_cavas_fill (buf, color_background);
+    offy = PPM_OFF_Y + gridy;
+    ppm_cavas_fill_rect (sheet, 0, offy, sheet->xmax, PPM_OFF_Y, pic->color_map[PIC_COLOR_BACKGROUND]);
     // draw line:
-    for (i = 0; i < (char_wx + 2*PPM_FNT_BORDER) * pic_xnum; i ++) {
-        ppm_cavas_pixel (buf, i + PPM_OFF_X, 0, color_dot);
+    for (i = 0; i < gridx; i ++) {
+        PIC_PIXEL (pic, i + PPM_OFF_X, offy, PIC_COLOR_DOT);
     }
     // draw dot
-    for (i = 0; i < (char_wx + 2*PPM_FNT_BORDER) * pic_xnum; i += (char_wx + 2*PPM_FNT_BORDER)) {
-        ppm_cavas_pixel (buf, char_wx / 2 + PPM_FNT_BORDER + i + PPM_OFF_X, 1, color_shift);
-        ppm_cavas_pixel (buf, char_wx / 2 + PPM_FNT_BORDER + i + PPM_OFF_X, 2, color_shift);
+    for (i = 0; i < gridx; i += (pic->char_wx + 2*PPM_FNT_BORDER)) {
+        PIC_PIXEL (pic, pic->char_wx / 2 + PPM_FNT_BORDER + i + PPM_OFF_X, offy + 1, PIC_COLOR_SHIFT);
+        PIC_PIXEL (pic, pic->char_wx / 2 + PPM_FNT_BORDER + i + PPM_OFF_X, offy + 2, PIC_COLOR_SHIFT);
     }
-    ppm_bitblit_from (&fd, buf, 0, PPM_OFF_Y + (char_hy + 2*PPM_FNT_BORDER) * pic_ynum, 0, 0, buf->xmax, buf->ymax);
 
-    ppm_cavas_fill (buf, color_background);
+    ppm_cavas_fill_rect (sheet, 0, 0, sheet->xmax, PPM_OFF_Y, pic->color_map[PIC_COLOR_BACKGROUND]);
     // draw line:
-    for (i = 0; i < (char_wx + 2*PPM_FNT_BORDER) * pic_xnum; i ++) {
-        ppm_cavas_pixel (buf, i + PPM_OFF_X, PPM_OFF_Y - 1, color_dot);
+    for (i = 0; i < gridx; i ++) {
+        PIC_PIXEL (pic, i + PPM_OFF_X, PPM_OFF_Y - 1, PIC_COLOR_DOT);
     }
     // draw dot
-    for (i = 0; i < (char_wx + 2*PPM_FNT_BORDER) * pic_xnum; i += (char_wx + 2*PPM_FNT_BORDER)) {
-        ppm_cavas_pixel (buf, char_wx / 2 + PPM_FNT_BORDER + i + PPM_OFF_X, PPM_OFF_Y - 2, color_shift);
-        ppm_cavas_pixel (buf, char_wx / 2 + PPM_FNT_BORDER + i + PPM_OFF_X, PPM_OFF_Y - 3, color_shift);
+    for (i = 0; i < gridx; i += (pic->char_wx + 2*PPM_FNT_BORDER)) {
+        PIC_PIXEL (pic, pic->char_wx / 2 + PPM_FNT_BORDER + i + PPM_OFF_X, PPM_OFF_Y - 2, PIC_COLOR_SHIFT);
+        PIC_PIXEL (pic, pic->char_wx / 2 + PPM_FNT_BORDER + i + PPM_OFF_X, PPM_OFF_Y - 3, PIC_COLOR_SHIFT);
     }
-    ppm_bitblit_from (&fd, buf, 0, 0, 0, 0, buf->xmax, buf->ymax);
 
     // y axis
-    buf = ppm_cavas_resize (buf, PPM_OFF_X, (char_hy + 2*PPM_FNT_BORDER) * pic_ynum + PPM_OFF_Y * 2, 8);
-    if (NULL == buf) {
-        printf ("error in malloc memory 2\n");
-        return -1;
-    }
+    offx = PPM_OFF_X + gridx;
+    ppm_cavas_fill_rect (sheet, offx, 0, PPM_OFF_X, sheet->ymax, pic->color_map[PIC_COLOR_BACKGROUND]);
     // draw line:
-    ppm_cavas_fill (buf, color_background);
-    for (i = 0; i < (char_hy + 2*PPM_FNT_BORDER) * pic_ynum; i ++) {
-        ppm_cavas_pixel (buf, 0, i + PPM_OFF_Y, color_dot);
+    for (i = 0; i < gridy; i ++) {
+        PIC_PIXEL (pic, offx, i + PPM_OFF_Y, PIC_COLOR_DOT);
     }
     // draw dot
-    for (i = 0; i < (char_hy + 2*PPM_FNT_BORDER) * pic_ynum; i += (char_hy + 2*PPM_FNT_BORDER)) {
-        ppm_cavas_pixel (buf, 1, char_hy / 2 + PPM_FNT_BORDER + i + PPM_OFF_Y, color_shift);
-        ppm_cavas_pixel (buf, 2, char_hy / 2 + PPM_FNT_BORDER + i + PPM_OFF_Y, color_shift);
+    for (i = 0; i < gridy; i += (pic->char_hy + 2*PPM_FNT_BORDER)) {
+        PIC_PIXEL (pic, offx + 1, pic->char_hy / 2 + PPM_FNT_BORDER + i + PPM_OFF_Y, PIC_COLOR_SHIFT);
+        PIC_PIXEL (pic, offx + 2, pic->char_hy / 2 + PPM_FNT_BORDER + i + PPM_OFF_Y, PIC_COLOR_SHIFT);
     }
-    ppm_bitblit_from (&fd, buf, PPM_OFF_X + (char_wx + 2*PPM_FNT_BORDER) * pic_xnum, 0, 0, 0, buf->xmax, buf->ymax);
 
+    ppm_cavas_fill_rect (sheet, 0, 0, PPM_OFF_X, sheet->ymax, pic->color_map[PIC_COLOR_BACKGROUND]);
     // draw line:
-    ppm_cavas_fill (buf, color_background);
-    for (i = 0; i < (char_hy + 2*PPM_FNT_BORDER) * pic_ynum; i ++) {
-        ppm_cavas_pixel (buf, PPM_OFF_X - 1, i + PPM_OFF_Y, color_dot);
+    for (i = 0; i < gridy; i ++) {
+        PIC_PIXEL (pic, PPM_OFF_X - 1, i + PPM_OFF_Y, PIC_COLOR_DOT);
     }
     // draw dot
-    for (i = 0; i < (char_hy + 2*PPM_FNT_BORDER) * pic_ynum; i += (char_hy + 2*PPM_FNT_BORDER)) {
-        ppm_cavas_pixel (buf, PPM_OFF_X - 2, char_hy / 2 + PPM_FNT_BORDER + i + PPM_OFF_Y, color_shift);
-        ppm_cavas_pixel (buf, PPM_OFF_X - 3, char_hy / 2 + PPM_FNT_BORDER + i + PPM_OFF_Y, color_shift);
+    for (i = 0; i < gridy; i += (pic->char_hy + 2*PPM_FNT_BORDER)) {
+        PIC_PIXEL (pic, PPM_OFF_X - 2, pic->char_hy / 2 + PPM_FNT_BORDER + i + PPM_OFF_Y, PIC_COLOR_SHIFT);
+        PIC_PIXEL (pic, PPM_OFF_X - 3, pic->char_hy / 2 + PPM_FNT_BORDER + i + PPM_OFF_Y, PIC_COLOR_SHIFT);
     }
-    ppm_bitblit_from (&fd, buf, 0, 0, 0, 0, buf->xmax, buf->ymax);
-
-    ppm_cavas_destroy (buf);
     return 0;
 }
 
-void
-bdf2c_fontpic_clear()
+// draw the metric and write the picture, in the format of the file name
+// to the stream fp or, without stream, to the file
+int
+bdf2c_fontpic_clear(bdf2c_fontpic_t *pic)
 {
-    if (chbuf) {
-        bdf2c_fontpic_draw_metric();
-        ppm_cavas_destroy (chbuf);
-        chbuf = NULL;
-        ppm_close (&fd);
+    int ret = 0;
+    if (pic->sheet) {
+        bdf2c_fontpic_draw_metric(pic);
+        switch (pic->format) {
+        case BDF2C_FONTPIC_PBM:
+            ret = pic->fp ? ppm_cavas_fwrite_pbm (pic->sheet, pic->fp) : ppm_cavas_write_pbm (pic->sheet, pic->filename);
+            break;
+        case BDF2C_FONTPIC_PNG:
+            ret = pic->fp ? ppm_cavas_fwrite_png (pic->sheet, pic->fp, pic_palette, PIC_COLOR_NUM) : ppm_cavas_write_png (pic->sheet, pic->filename, pic_palette, PIC_COLOR_NUM);
+            break;
+        default:
+            ret = pic->fp ? ppm_cavas_fwrite_ppm (pic->sheet, pic->fp, pic_palette) : ppm_cavas_write_ppm (pic->sheet, pic->filename, pic_palette);
+            break;
+        }
+        if (0 != ret) {
+            fprintf (stderr, "error in write picture %s\n", pic->filename);
+        }
+        ppm_cavas_destroy (pic->sheet);
+        pic->sheet = NULL;
     }
+    return ret;
 }
 
 // bitmap == NULL, place a holder sign
 // flag_shifted, 1=if there's a BBX value for x shift > 0 in BDF font file
 void
-bdf2c_fontpic_add (uint8_t *bitmap, size_t width, size_t height, int encoding, char flag_shifted)
+bdf2c_fontpic_add (bdf2c_fontpic_t *pic, uint8_t *bitmap, size_t width, size_t height, int encoding, char flag_shifted)
 {
     size_t x;
     size_t y;
-    current_num = encoding;
-    x = current_num % pic_xnum;
-    y = current_num / pic_xnum;
-    x *= (char_wx + 2 * PPM_FNT_BORDER);
-    y *= (char_hy + 2 * PPM_FNT_BORDER);
+    const uint8_t * map = pic->color_map;
+    pic->current_num = encoding - pic->first_num;
+    x = pic->current_num % pic->pic_xnum;
+    y = pic->current_num / pic->pic_xnum;
+    x *= (pic->char_wx + 2 * PPM_FNT_BORDER);
+    y *= (pic->char_hy + 2 * PPM_FNT_BORDER);
     x += PPM_OFF_X;
     y += PPM_OFF_Y;
 
-    ppm_cavas_fill (chbuf, color_background);
     if (NULL == bitmap) {
         assert (width >= 16);
         assert (height >= 16);
-        DumpCharacter2Cavas (chbuf, PPM_FNT_BORDER + (width - 16)/2, PPM_FNT_BORDER + (height - 16)/2, bitmap_hznone, 16, 16, color_none, color_background);
+        ppm_cavas_fill_rect (pic->sheet, x + PPM_FNT_BORDER, y + PPM_FNT_BORDER, width, height, map[PIC_COLOR_BACKGROUND]);
+        ppm_cavas_blit_bitmap (pic->sheet, x + PPM_FNT_BORDER + (width - 16)/2, y + PPM_FNT_BORDER + (height - 16)/2, bitmap_hznone, 16, 16, map[PIC_COLOR_NONE], map[PIC_COLOR_BACKGROUND]);
     } else {
-        DumpCharacter2Cavas (chbuf, PPM_FNT_BORDER, PPM_FNT_BORDER, bitmap, width, height, color_dot, color_background);
+        ppm_cavas_blit_bitmap (pic->sheet, x + PPM_FNT_BORDER, y + PPM_FNT_BORDER, bitmap, width, height, map[PIC_COLOR_DOT], map[PIC_COLOR_BACKGROUND]);
     }
 
 #define UNUSED_VARIABLE(a) ((void)(a))
 #if (PPM_FNT_BORDER > 0)
 {
-    uint8_t * color1;
-    size_t i;
-    size_t j;
+    uint8_t color1;
 
     // lines around box
-    color1 = color_line;
+    color1 = map[PIC_COLOR_LINE];
     if (flag_shifted) {
-        color1 = color_shift;
-    }
-
-    for (j = 0; j < width + 2*PPM_FNT_BORDER; j ++) {
-        for (i = 0; i < PPM_FNT_BORDER; i ++) {
-            ppm_cavas_pixel (chbuf, j, 0 + i, color1);
-            ppm_cavas_pixel (chbuf, j, height + 2*PPM_FNT_BORDER - 1 - i, color1);
-        }
-    }
-    for (i = 0; i < height + 2*PPM_FNT_BORDER; i ++) {
-        for (j = 0; j < PPM_FNT_BORDER; j ++) {
-            ppm_cavas_pixel (chbuf, 0 + j, i, color1);
-            ppm_cavas_pixel (chbuf, width + 2*PPM_FNT_BORDER - 1 - j, i, color1);
-        }
+        color1 = map[PIC_COLOR_SHIFT];
     }
+    ppm_cavas_fill_rect (pic->sheet, x, y, width + 2*PPM_FNT_BORDER, PPM_FNT_BORDER, color1);
+    ppm_cavas_fill_rect (pic->sheet, x, y + height + PPM_FNT_BORDER, width + 2*PPM_FNT_BORDER, PPM_FNT_BORDER, color1);
+    ppm_cavas_fill_rect (pic->sheet, x, y, PPM_FNT_BORDER, height + 2*PPM_FNT_BORDER, color1);
+    ppm_cavas_fill_rect (pic->sheet, x + width + PPM_FNT_BORDER, y, PPM_FNT_BORDER, height + 2*PPM_FNT_BORDER, color1);
 }
 #else
     UNUSED_VARIABLE(flag_shifted);
-    UNUSED_VARIABLE(color_line);
 #endif
-    ppm_bitblit_from (&fd, chbuf, x, y, 0, 0, width + 2*PPM_FNT_BORDER, height + 2*PPM_FNT_BORDER);
-    current_num ++;
+    pic->current_num ++;
 }
 
 #if DEBUG
@@ -644,21 +1131,36 @@ void
 test_ppm2(int shift)
 {
     int i;
+    bdf2c_fontpic_t pic;
     // test RotateBitmap
     char buf[sizeof(bitmaphz)];
     memmove (buf, bitmaphz, sizeof (bitmaphz));
     RotateBitmap(buf, shift, 16, 16);
 
-    bdf2c_fontpic_init ("test2.ppm", MAX_FONT_ITEMS, 16, 16);
+    bdf2c_fontpic_init (&pic, "test2.ppm", 0, MAX_FONT_ITEMS, 16, 16);
+    for (i = 0; i < MAX_FONT_ITEMS; i ++) {
+        bdf2c_fontpic_add (&pic, buf, 16, 16, i, 1);
+    }
+    bdf2c_fontpic_clear (&pic);
+
+    // the same as packed formats
+    bdf2c_fontpic_init (&pic, "test2.pbm", 0, MAX_FONT_ITEMS, 16, 16);
+    for (i = 0; i < MAX_FONT_ITEMS; i ++) {
+        bdf2c_fontpic_add (&pic, buf, 16, 16, i, 1);
+    }
+    bdf2c_fontpic_clear (&pic);
+    bdf2c_fontpic_init (&pic, "test2.png", 0, MAX_FONT_ITEMS, 16, 16);
     for (i = 0; i < MAX_FONT_ITEMS; i ++) {
-        bdf2c_fontpic_add (buf, 16, 16, i, 1);
+        bdf2c_fontpic_add (&pic, buf, 16, 16, i, 0);
     }
-    bdf2c_fontpic_clear ();
+    bdf2c_fontpic_clear (&pic);
 }
 
 void
 test_set_hz(ppm_cavas_t *cavas, size_t offx, size_t offy)
 {
+    uint8_t color_dot[4] = {0,   0,   0, 255};
+    uint8_t color_background[4] = {0, 255, 255, 255};
     DumpCharacter2Cavas (cavas, offx, offy, bitmaphz, 16, 16, color_dot, color_background);
 }
 
@@ -672,16 +1174,17 @@ test_ppm1()
     char val[4] = {0, 132, 149, 12};
     ppm_cavas_t * cavas;
     ppm_cavas_t * buffer;
-    ppm_file_t * pfile = &fd;
+    ppm_file_t file;
+    ppm_file_t * pfile = &file;
 
     if (0 != ppm_create (pfile, "test1.ppm", MAXX, MAXY, 255)) {
         printf ("error in create ppm file tmp.ppm\n");
         return;
     }
-    buffer = ppm_cavas_create (MAXX, MAXY/4, 8);
+    buffer = ppm_cavas_create (MAXX, MAXY/4, PPM_CAVAS_ARGB);
 
     // fill the small block
-    cavas = ppm_cavas_create (MAXX/4, MAXY/4, 8);
+    cavas = ppm_cavas_create (MAXX/4, MAXY/4, PPM_CAVAS_ARGB);
     val[0] = 0; val[1] = 0; val[2] = 255; val[3] = 0;
     ppm_cavas_fill (cavas, val);
 
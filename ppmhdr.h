@@ -18,12 +18,20 @@ typedef struct _ppm_file_t {
     size_t depth; // 255
     FILE *fp;
     off_t off_data; // start of data
+    uint8_t *data; // the RGB pixels, written to the file on close
+    char flg_dirty; // 1=data was changed
 } ppm_file_t;
 
+// the pixel formats of the cavas, bits per pixel
+#define PPM_CAVAS_MONO  1 // 1 bit, MSB first, rows padded to bytes
+#define PPM_CAVAS_INDEX 8 // 1 byte color index
+#define PPM_CAVAS_ARGB 32 // 4 bytes ARGB
+
 typedef struct _ppm_cavas_t {
     size_t xmax;
     size_t ymax;
-    size_t bit; // 8bit for ARGB
+    size_t bit; // PPM_CAVAS_MONO, PPM_CAVAS_INDEX or PPM_CAVAS_ARGB
+    size_t stride; // the bytes of one row
     size_t buffer_size; // the byte size of the following buffer
     uint8_t buffer[4];
 } ppm_cavas_t;
@@ -38,14 +46,47 @@ void ppm_cavas_fill (ppm_cavas_t * p,  uint8_t color[4]);
 int ppm_cavas_pixel (ppm_cavas_t * pppm, size_t x, size_t y, uint8_t color[4]);
 int ppm_cavas_bitblit (ppm_cavas_t *dest, ppm_cavas_t *src, size_t dx, size_t dy, size_t sx, size_t sy, size_t wx, size_t hy);
 
+// mono and indexed cavas
+int ppm_cavas_pixel_index (ppm_cavas_t * pppm, size_t x, size_t y, uint8_t val);
+void ppm_cavas_fill_rect (ppm_cavas_t * pppm, size_t x, size_t y, size_t wx, size_t hy, uint8_t val);
+void ppm_cavas_blit_bitmap (ppm_cavas_t * dest, size_t dx, size_t dy, const uint8_t *bitmap, size_t width, size_t height, uint8_t c_dot, uint8_t c_background);
+int ppm_cavas_write_ppm (ppm_cavas_t * pppm, const char * filename, const uint8_t palette[][4]);
+int ppm_cavas_write_pbm (ppm_cavas_t * pppm, const char * filename);
+int ppm_cavas_write_png (ppm_cavas_t * pppm, const char * filename, const uint8_t palette[][4], size_t num_colors);
+int ppm_cavas_fwrite_ppm (ppm_cavas_t * pppm, FILE * fp, const uint8_t palette[][4]);
+int ppm_cavas_fwrite_pbm (ppm_cavas_t * pppm, FILE * fp);
+int ppm_cavas_fwrite_png (ppm_cavas_t * pppm, FILE * fp, const uint8_t palette[][4], size_t num_colors);
+int ppm_cavas_write_pgm (ppm_cavas_t * pppm, const char * filename);
+int ppm_cavas_fwrite_pgm (ppm_cavas_t * pppm, FILE * fp);
+
 int ppm_load (ppm_file_t *fp, const char * filename);
 int ppm_create (ppm_file_t *fp, const char * filename, size_t x, size_t y, size_t depth);
 int ppm_close (ppm_file_t *fp);
 int ppm_bitblit_from (ppm_file_t *fp_dest, ppm_cavas_t *src, size_t dx, size_t dy, size_t sx, size_t sy, size_t wx, size_t hy);
 int ppm_bitblit_to (ppm_cavas_t *dest, ppm_file_t *fp_src, size_t dx, size_t dy, size_t sx, size_t sy, size_t wx, size_t hy);
 
-int bdf2c_fontpic_init (const char * filename, size_t num, size_t wx, size_t hy);
-void bdf2c_fontpic_clear();
-void bdf2c_fontpic_add (uint8_t *bitmap, size_t width, size_t height, int encoding, char flag_shifted);
+// the file formats of the preview picture
+#define BDF2C_FONTPIC_PPM 0
+#define BDF2C_FONTPIC_PBM 1
+#define BDF2C_FONTPIC_PNG 2
+
+// the preview picture of one font conversion
+typedef struct _bdf2c_fontpic_t {
+    const char * filename;
+    FILE * fp; // the stream of the picture, NULL writes the file
+    int format; // BDF2C_FONTPIC_PPM, BDF2C_FONTPIC_PBM or BDF2C_FONTPIC_PNG
+    ppm_cavas_t * sheet; // the whole picture
+    const uint8_t * color_map; // the picture colors to the sheet values
+    size_t current_num;
+    size_t first_num; // the encoding of the first grid item
+    size_t pic_xnum; // items per row
+    size_t pic_ynum; // items per column
+    size_t char_wx;
+    size_t char_hy;
+} bdf2c_fontpic_t;
+
+int bdf2c_fontpic_init (bdf2c_fontpic_t *pic, const char * filename, size_t first, size_t num, size_t wx, size_t hy);
+int bdf2c_fontpic_clear(bdf2c_fontpic_t *pic);
+void bdf2c_fontpic_add (bdf2c_fontpic_t *pic, uint8_t *bitmap, size_t width, size_t height, int encoding, char flag_shifted);
 
 #endif // _PPM_HDR_H
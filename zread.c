@@ -0,0 +1,420 @@
+///
+///	@file zread.c		@brief decompressing bdf input
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup zread Decompressing reader
+///
+///	Fonts compressed with gzip, xz or zstd are read without temporary
+///	file.  The format is detected by its magic bytes, also on pipes.  A
+///	thread decompresses the input into a pipe, the converter reads the
+///	other end like an uncompressed pipe, decompression and parsing run
+///	in parallel.
+///
+///	The formats are built with USE_ZLIB, USE_LZMA and USE_ZSTD, the
+///	Makefile sets them for the installed libraries.
+///
+/// @{
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef USE_LZMA
+#include <lzma.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "zread.h"
+
+//////////////////////////////////////////////////////////////////////////////
+
+#define ZREAD_BLOCK_SIZE (256 * 1024)	///< bytes of a read or write block
+
+///
+///	Magic bytes of the compressed formats.
+///
+static const struct {
+    int Format;				///< ZREAD_GZIP ...
+    int Length;				///< bytes of magic
+    const char *Magic;			///< first bytes of file
+    const char *Name;			///< format name for messages
+    int Supported;			///< true decompression built in
+} ZReadMagics[] = {
+#ifdef USE_ZLIB
+    {ZREAD_GZIP, 2, "\x1F\x8B", "gzip", 1},
+#else
+    {ZREAD_GZIP, 2, "\x1F\x8B", "gzip", 0},
+#endif
+#ifdef USE_LZMA
+    {ZREAD_XZ, 6, "\xFD" "7zXZ\0", "xz", 1},
+#else
+    {ZREAD_XZ, 6, "\xFD" "7zXZ\0", "xz", 0},
+#endif
+#ifdef USE_ZSTD
+    {ZREAD_ZSTD, 4, "\x28\xB5\x2F\xFD", "zstd", 1},
+#else
+    {ZREAD_ZSTD, 4, "\x28\xB5\x2F\xFD", "zstd", 0},
+#endif
+};
+
+///
+///	Read compressed input, the magic bytes first.
+///
+///	@param z	decompressing reader
+///	@param buf	buffer for input
+///	@param size	size of buffer
+///
+///	@returns number of bytes read, 0 at end of input.
+///
+static size_t ZReadInput(ZRead * z, unsigned char *buf, size_t size)
+{
+    size_t n;
+
+    if (z->MagicLength) {
+	n = z->MagicLength;
+	memcpy(buf, z->Magic, n);
+	z->MagicLength = 0;
+	return n;
+    }
+    return fread(buf, 1, size, z->In);
+}
+
+///
+///	Write decompressed data into pipe.
+///
+///	@param z	decompressing reader
+///	@param buf	decompressed data
+///	@param size	number of bytes
+///
+static void ZReadOutput(ZRead * z, const unsigned char *buf, size_t size)
+{
+    ssize_t n;
+
+    while (size) {
+	if ((n = write(z->Fd, buf, size)) < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    fprintf(stderr, "Can't write decompressed '%s': %s\n", z->Name,
+		strerror(errno));
+	    exit(-1);
+	}
+	buf += n;
+	size -= n;
+    }
+}
+
+#if defined(USE_ZLIB) || defined(USE_LZMA) || defined(USE_ZSTD)
+
+///
+///	Fail with broken compressed input.
+///
+///	@param z	decompressing reader
+///
+static void __attribute__ ((noreturn)) ZReadBroken(const ZRead * z)
+{
+    fprintf(stderr, "Broken compressed file '%s'\n", z->Name);
+    exit(-1);
+}
+
+#endif
+
+#ifdef USE_ZLIB
+
+///
+///	Decompress gzip input, also concatenated gzip members.
+///
+///	@param z	decompressing reader
+///	@param in	buffer for compressed input
+///	@param out	buffer for decompressed output
+///
+static void ZReadGzip(ZRead * z, unsigned char *in, unsigned char *out)
+{
+    z_stream zs;
+    size_t n;
+    int ret;
+
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) {	// gzip header
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    ret = Z_OK;
+    for (;;) {
+	if (!zs.avail_in) {
+	    if (!(n = ZReadInput(z, in, ZREAD_BLOCK_SIZE))) {
+		break;
+	    }
+	    zs.next_in = in;
+	    zs.avail_in = n;
+	}
+	zs.next_out = out;
+	zs.avail_out = ZREAD_BLOCK_SIZE;
+	ret = inflate(&zs, Z_NO_FLUSH);
+	if (ret != Z_OK && ret != Z_STREAM_END) {
+	    ZReadBroken(z);
+	}
+	ZReadOutput(z, out, ZREAD_BLOCK_SIZE - zs.avail_out);
+	if (ret == Z_STREAM_END) {	// next member
+	    inflateReset(&zs);
+	}
+    }
+    inflateEnd(&zs);
+    if (ret != Z_STREAM_END) {		// truncated
+	ZReadBroken(z);
+    }
+}
+
+#endif
+
+#ifdef USE_LZMA
+
+///
+///	Decompress xz input, also concatenated xz streams.
+///
+///	@param z	decompressing reader
+///	@param in	buffer for compressed input
+///	@param out	buffer for decompressed output
+///
+static void ZReadXz(ZRead * z, unsigned char *in, unsigned char *out)
+{
+    lzma_stream xs = LZMA_STREAM_INIT;
+    lzma_action action;
+    lzma_ret ret;
+    size_t n;
+
+    if (lzma_stream_decoder(&xs, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    action = LZMA_RUN;
+    do {
+	if (!xs.avail_in && action == LZMA_RUN) {
+	    if (!(n = ZReadInput(z, in, ZREAD_BLOCK_SIZE))) {
+		action = LZMA_FINISH;
+	    }
+	    xs.next_in = in;
+	    xs.avail_in = n;
+	}
+	xs.next_out = out;
+	xs.avail_out = ZREAD_BLOCK_SIZE;
+	ret = lzma_code(&xs, action);
+	if (ret != LZMA_OK && ret != LZMA_STREAM_END) {
+	    ZReadBroken(z);
+	}
+	ZReadOutput(z, out, ZREAD_BLOCK_SIZE - xs.avail_out);
+    } while (ret != LZMA_STREAM_END);
+    lzma_end(&xs);
+}
+
+#endif
+
+#ifdef USE_ZSTD
+
+///
+///	Decompress zstd input, also concatenated frames.
+///
+///	@param z	decompressing reader
+///	@param in	buffer for compressed input
+///	@param out	buffer for decompressed output
+///
+static void ZReadZstd(ZRead * z, unsigned char *in, unsigned char *out)
+{
+    ZSTD_DStream *zs;
+    ZSTD_inBuffer input;
+    ZSTD_outBuffer output;
+    size_t ret;
+
+    if (!(zs = ZSTD_createDStream())) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    ret = 0;
+    input.src = in;
+    input.size = 0;
+    input.pos = 0;
+    for (;;) {
+	if (input.pos == input.size) {
+	    if (!(input.size = ZReadInput(z, in, ZREAD_BLOCK_SIZE))) {
+		break;
+	    }
+	    input.pos = 0;
+	}
+	output.dst = out;
+	output.size = ZREAD_BLOCK_SIZE;
+	output.pos = 0;
+	ret = ZSTD_decompressStream(zs, &output, &input);
+	if (ZSTD_isError(ret)) {
+	    ZReadBroken(z);
+	}
+	ZReadOutput(z, out, output.pos);
+    }
+    ZSTD_freeDStream(zs);
+    if (ret) {				// truncated frame
+	ZReadBroken(z);
+    }
+}
+
+#endif
+
+///
+///	Decompression thread, writes the decompressed input into the pipe.
+///
+///	@param arg	decompressing reader
+///
+static void *ZReadThread(void *arg)
+{
+    ZRead *z;
+    unsigned char *in;
+    unsigned char *out;
+    size_t n;
+
+    z = arg;
+    if (!(in = malloc(ZREAD_BLOCK_SIZE))
+	|| !(out = malloc(ZREAD_BLOCK_SIZE))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    switch (z->Format) {
+#ifdef USE_ZLIB
+	case ZREAD_GZIP:
+	    ZReadGzip(z, in, out);
+	    break;
+#endif
+#ifdef USE_LZMA
+	case ZREAD_XZ:
+	    ZReadXz(z, in, out);
+	    break;
+#endif
+#ifdef USE_ZSTD
+	case ZREAD_ZSTD:
+	    ZReadZstd(z, in, out);
+	    break;
+#endif
+	default:			// bytes read for detection and rest
+	    while ((n = ZReadInput(z, in, ZREAD_BLOCK_SIZE))) {
+		ZReadOutput(z, in, n);
+	    }
+	    break;
+    }
+    close(z->Fd);			// end of file for reader
+    free(out);
+    free(in);
+    return NULL;
+}
+
+///
+///	Open input, decompressed if it is compressed.
+///
+///	Uncompressed input is returned unchanged, only its first byte is
+///	read and pushed back.  For compressed input the decompression thread
+///	is started and the read end of its pipe returned.
+///
+///	@param z	decompressing reader to initialize
+///	@param in	input stream
+///	@param name	input name for messages
+///
+///	@returns stream to read the font from, valid until ZReadClose().
+///
+FILE *ZReadOpen(ZRead * z, FILE * in, const char *name)
+{
+    int fds[2];
+    size_t i;
+    int c;
+
+    memset(z, 0, sizeof(*z));
+    z->In = in;
+    z->Name = name;
+    if ((c = getc(in)) == EOF) {
+	return in;
+    }
+    for (i = 0; i < sizeof(ZReadMagics) / sizeof(*ZReadMagics); ++i) {
+	if (c == (unsigned char)ZReadMagics[i].Magic[0]) {
+	    break;
+	}
+    }
+    if (i == sizeof(ZReadMagics) / sizeof(*ZReadMagics)) {	// plain bdf
+	ungetc(c, in);
+	return in;
+    }
+    z->Magic[0] = c;
+    z->MagicLength = 1;
+    while (z->MagicLength < ZReadMagics[i].Length
+	&& (c = getc(in)) != EOF) {
+	z->Magic[z->MagicLength++] = c;
+    }
+    if (z->MagicLength == ZReadMagics[i].Length
+	&& !memcmp(z->Magic, ZReadMagics[i].Magic, ZReadMagics[i].Length)) {
+	if (!ZReadMagics[i].Supported) {
+	    fprintf(stderr, "Can't read '%s', built without %s support\n",
+		name, ZReadMagics[i].Name);
+	    exit(-1);
+	}
+	z->Format = ZReadMagics[i].Format;
+    }
+
+    if (pipe(fds)) {
+	fprintf(stderr, "Can't create pipe: %s\n", strerror(errno));
+	exit(-1);
+    }
+    z->Fd = fds[1];
+    if (!(z->Out = fdopen(fds[0], "rb"))) {
+	fprintf(stderr, "Out of memory\n");
+	exit(-1);
+    }
+    if (pthread_create(&z->Thread, NULL, ZReadThread, z)) {
+	fprintf(stderr, "Can't create thread\n");
+	exit(-1);
+    }
+    return z->Out;
+}
+
+///
+///	Close decompression of input.  The rest of the decompressed input
+///	is skipped, the thread must reach the end of its input.  The input
+///	stream itself isn't closed.
+///
+///	@param z	decompressing reader of ZReadOpen()
+///
+void ZReadClose(ZRead * z)
+{
+    char buf[4096];
+
+    if (!z->Out) {
+	return;
+    }
+    while (fread(buf, 1, sizeof(buf), z->Out)) {
+    }
+    fclose(z->Out);
+    pthread_join(z->Thread, NULL);
+    z->Out = NULL;
+}
+
+/// @}
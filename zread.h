@@ -0,0 +1,54 @@
+///
+///	@file zread.h		@brief decompressing bdf input
+///
+///	Copyright (c) 2009, 2010 by Lutz Sammer.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef _ZREAD_H
+#define _ZREAD_H
+
+#include <stdio.h>			// FILE
+#include <pthread.h>			// pthread_t
+
+#define ZREAD_PLAIN 0			///< not compressed
+#define ZREAD_GZIP 1			///< gzip, .gz
+#define ZREAD_XZ 2			///< xz, .xz
+#define ZREAD_ZSTD 3			///< zstandard, .zst
+
+///
+///	Decompressing reader of one input.
+///
+typedef struct _zread_ {
+    FILE *In;				///< compressed input
+    FILE *Out;				///< decompressed stream or NULL
+    const char *Name;			///< input name for messages
+    int Format;				///< ZREAD_PLAIN, ZREAD_GZIP ...
+    int Fd;				///< write end of pipe
+    unsigned char Magic[6];		///< bytes read to detect format
+    int MagicLength;			///< number of magic bytes
+    pthread_t Thread;			///< decompression thread
+} ZRead;
+
+    /// open input, decompressed if compressed
+extern FILE *ZReadOpen(ZRead *, FILE *, const char *);
+
+    /// close decompression of input
+extern void ZReadClose(ZRead *);
+
+#endif // _ZREAD_H